@@ -33,11 +33,19 @@ float rightStickDeadZone;
 int fpsLock;
 bool fakeAccel_enabled;
 
+// Not shown in the UI, but kept when the config is saved.
+int readAheadWindow;
+int blockCacheSize;
+bool preloadAssets;
+
 void resetSettings() {
     leftStickDeadZone = 0.11f;
     rightStickDeadZone = 0.11f;
     fpsLock = 0;
     fakeAccel_enabled = false;
+    readAheadWindow = 64;
+    blockCacheSize = 8;
+    preloadAssets = true;
 }
 
 inline int8_t is_dir(char* p) {
@@ -61,6 +69,9 @@ void loadConfig(void) {
             else if (strcmp("rightStickDeadZone", buffer) == 0) rightStickDeadZone = ((float)value / 100.f);
             else if (strcmp("fpsLock", buffer) == 0) fpsLock = value;
             else if (strcmp("fakeAccel_enabled", buffer) == 0) fakeAccel_enabled = (bool)value;
+            else if (strcmp("readAheadWindow", buffer) == 0) readAheadWindow = value;
+            else if (strcmp("blockCacheSize", buffer) == 0) blockCacheSize = value;
+            else if (strcmp("preloadAssets", buffer) == 0) preloadAssets = (bool)value;
         }
         fclose(config);
     }
@@ -74,6 +85,9 @@ void saveConfig(void) {
         fprintf(config, "%s %d\n", "rightStickDeadZone", (int)(rightStickDeadZone * 100.f));
         fprintf(config, "%s %d\n", "fpsLock", (int)fpsLock);
         fprintf(config, "%s %d\n", "fakeAccel_enabled", (int)fakeAccel_enabled);
+        fprintf(config, "%s %d\n", "readAheadWindow", readAheadWindow);
+        fprintf(config, "%s %d\n", "blockCacheSize", blockCacheSize);
+        fprintf(config, "%s %d\n", "preloadAssets", (int)preloadAssets);
         fclose(config);
     }
 }
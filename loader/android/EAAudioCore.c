@@ -203,14 +203,14 @@ void _AudioTrack_release() {
 
 //int audio_port = 0;
 
-int EAAudioCore_AudioTrack_write(int id, va_list args) {
+jint EAAudioCore_AudioTrack_write(int id, jobject thiz, const jvalue* args) {
     //printf("AudioTrack_write\n");
     // args: short* audioData, int offsetInShorts, int sizeInShorts
     // ignore
 
-    /*jshort* buf = va_arg(args, jshort*);
-    int32_t offs = va_arg(args, int32_t);
-    int32_t len = va_arg(args, int32_t);
+    /*jshort* buf = args[0].l;
+    int32_t offs = args[1].i;
+    int32_t len = args[2].i;
 
     printf("AudioTrack_write %i / %i\n", offs, len);
 
@@ -218,7 +218,7 @@ int EAAudioCore_AudioTrack_write(int id, va_list args) {
     return 1024;
 }
 
-void EAAudioCore_AudioTrack_play(int id, va_list args) {
+void EAAudioCore_AudioTrack_play(int id, jobject thiz, const jvalue* args) {
     //audio_port = sceAudioOutOpenPort(SCE_AUDIO_OUT_PORT_TYPE_BGM, 512, 44100, SCE_AUDIO_OUT_MODE_STEREO);
     //printf("audio_port %x\n", audio_port);
 
@@ -226,16 +226,16 @@ void EAAudioCore_AudioTrack_play(int id, va_list args) {
     // ignore
 }
 
-void EAAudioCore_AudioTrack_stop(int id, va_list args) {
+void EAAudioCore_AudioTrack_stop(int id, jobject thiz, const jvalue* args) {
     printf("AudioTrack_stop\n");
     // ignore
 }
 
 
 void EAAudioCore__Startup() {
-    Java_com_ea_EAAudioCore_AndroidEAAudioCore_Init(&jni, (void*)0x42424242, (void*)0x69696969, 1024 * 1024, 2, 44100);
+    Java_com_ea_EAAudioCore_AndroidEAAudioCore_Init(jni_get_env(), (void*)0x42424242, (void*)0x69696969, 1024 * 1024, 2, 44100);
 }
 
 void EAAudioCore__Shutdown() {
-    Java_com_ea_EAAudioCore_AndroidEAAudioCore_Release(&jni);
+    Java_com_ea_EAAudioCore_AndroidEAAudioCore_Release(jni_get_env());
 }
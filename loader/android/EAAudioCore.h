@@ -15,8 +15,8 @@ typedef struct _AudioTrack * AudioTrack;
 void EAAudioCore__Startup();
 void EAAudioCore__Shutdown();
 
-int EAAudioCore_AudioTrack_write(int id, va_list args);
-void EAAudioCore_AudioTrack_play(int id, va_list args);
-void EAAudioCore_AudioTrack_stop(int id, va_list args);
+jint EAAudioCore_AudioTrack_write(int id, jobject thiz, const jvalue* args);
+void EAAudioCore_AudioTrack_play(int id, jobject thiz, const jvalue* args);
+void EAAudioCore_AudioTrack_stop(int id, jobject thiz, const jvalue* args);
 
 #endif // SOLOADER_EAAUDIOCORE_H
\ No newline at end of file
@@ -2,227 +2,312 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <fcntl.h>
-#include <sys/dirent.h>
-#include <dirent.h>
 #include <string.h>
 #include <pthread.h>
 #include <sys/unistd.h>
 #include "utils/utils.h"
+#include "io/asset_index.h"
+#include "io/io_trace.h"
+#include "reimpl/io.h"
 
 #include "java.io.InputStream.h"
 #include "android/jni.h"
 #include "jni_fake.h"
 
-FILE* f = NULL;
-int fd = -1;
-pthread_mutex_t mut;
+const char* assetsPathPrefix = DATA_PATH_INT;
 
-size_t listSize = 0;
-size_t listAllocedSize = 0;
-char** list = NULL;
-int calls_count = 0;
+// Every stream opened with open() or openFd() gets a slot in this table, and
+// the address of the slot is the jobject handed to the game. Slots are
+// released by close().
+typedef struct {
+    int used;
+    int fd;            // -1 until the file is first needed
+    char* path;
+    int64_t length;    // -1 until known
+    int64_t pos;       // position of the stream as seen by the game
+    int64_t fd_pos;    // current offset of `fd`
+    uint8_t* buf;      // read buffer, allocated on the first small read
+    int64_t buf_start; // stream position of buf[0]
+    int32_t buf_len;
+} InputStream;
+
+InputStream inputStreams[INPUT_STREAMS_MAX];
+pthread_mutex_t inputStreams_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+jboolean InputStream_isHandle(const void* p) {
+    const uint8_t* u = p;
+    const uint8_t* begin = (const uint8_t*)inputStreams;
+    const uint8_t* end = (const uint8_t*)(inputStreams + INPUT_STREAMS_MAX);
+    return (u >= begin && u < end) ? JNI_TRUE : JNI_FALSE;
+}
 
-const char* assetsPathPrefix = DATA_PATH_INT;
+static InputStream* stream_get(jobject thiz) {
+    if (!InputStream_isHandle(thiz)) {
+        debugPrintf("[java.io.InputStream] 0x%x is not a stream handle.\n", (int)thiz);
+        return NULL;
+    }
+
+    InputStream* s = (InputStream*)thiz;
+    if (!s->used) {
+        debugPrintf("[java.io.InputStream] Stream 0x%x is closed.\n", (int)thiz);
+        return NULL;
+    }
+    return s;
+}
+
+static InputStream* stream_new(const char* fileName) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s%s", assetsPathPrefix, fileName);
+
+    pthread_mutex_lock(&inputStreams_mutex);
+    InputStream* s = NULL;
+    for (int i = 0; i < INPUT_STREAMS_MAX; i++) {
+        if (!inputStreams[i].used) {
+            s = &inputStreams[i];
+            s->used = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&inputStreams_mutex);
+
+    if (!s) {
+        debugPrintf("[java.io.InputStream] Too many open streams, can't open \"%s\"!\n", path);
+        return NULL;
+    }
+
+    s->fd = -1;
+    s->path = strdup(path);
+    s->length = -1;
+    s->pos = 0;
+    s->fd_pos = 0;
+    s->buf = NULL;
+    s->buf_start = 0;
+    s->buf_len = 0;
+    return s;
+}
+
+static void stream_free(InputStream* s) {
+    if (s->fd > -1) close_soloader_from(s->fd, IO_TRACE_FROM_STREAM);
+    free(s->path);
+    free(s->buf);
+    s->fd = -1;
+    s->path = NULL;
+    s->buf = NULL;
+
+    pthread_mutex_lock(&inputStreams_mutex);
+    s->used = 0;
+    pthread_mutex_unlock(&inputStreams_mutex);
+}
+
+// Opens the file if it isn't yet and finds out its length. Returns 0 on
+// success.
+static int stream_open_fd(InputStream* s) {
+    if (s->fd > -1) return 0;
+
+    // Goes through the same asset pack, read-ahead and block cache as the
+    // game's own open() and read().
+    s->fd = open_soloader_from(s->path, O_RDONLY, IO_TRACE_FROM_STREAM);
+    if (s->fd < 0) {
+        debugPrintf("[java.io.InputStream] Can't open \"%s\".\n", s->path);
+        return -1;
+    }
+
+    // Done once per stream; from here on, getLength() and skip() don't need
+    // to touch the file at all.
+    int64_t len = lseek_soloader_from(s->fd, 0, SEEK_END, IO_TRACE_FROM_STREAM);
+    lseek_soloader_from(s->fd, 0, SEEK_SET, IO_TRACE_FROM_STREAM);
+    s->length = (len < 0) ? 0 : len;
+    s->fd_pos = 0;
+    return 0;
+}
+
+// Reads from the file at the stream position, bypassing the buffer.
+static int stream_read_fd(InputStream* s, uint8_t* dst, int len) {
+    if (s->fd_pos != s->pos) {
+        if (lseek_soloader_from(s->fd, s->pos, SEEK_SET, IO_TRACE_FROM_STREAM) < 0) return -1;
+        s->fd_pos = s->pos;
+    }
+
+    int n = read_soloader_from(s->fd, dst, len, IO_TRACE_FROM_STREAM);
+    if (n > 0) s->fd_pos += n;
+    return n;
+}
 
 // public int read(byte[] b, int off, int len)
 // https://docs.oracle.com/javase/7/docs/api/java/io/InputStream.html#read()
-jint InputStream_read(int id, va_list args) {
+jint InputStream_read(int id, jobject thiz, const jvalue* args) {
     debugPrintf("JNI: Method Call: InputStream_read() / id: %i\n", id);
     // Imporant note: there are also versions of read() with two and one arg;
     // here we assume that only the full version with 3 args is used, which is
     // dangerous.
 
-    char* b = va_arg(args, char*);
-    int off = va_arg(args, int);
-    int len = va_arg(args, int);
+    uint8_t* b = args[0].l;
+    int off = args[1].i;
+    int len = args[2].i;
 
-    if (!f) {
-        if (fd == -1) {
-            debugPrintf("[java.io.InputStream.read()] File descriptor is NULL.\n");
-            return -1;
-        }
+    InputStream* s = stream_get(thiz);
+    if (!s || stream_open_fd(s) != 0) {
+        return -1;
     }
 
     if (len <= 0) {
         return 0;
     }
 
-    size_t bytes_read;
-    if (!f) {
-        bytes_read = read(fd, b+off, len);
-    } else {
-        bytes_read = fread(b+off, 1, len, f);
+    if (s->pos >= s->length) {
+        return -1;
     }
 
-    if (bytes_read <= 0) {
-        return -1;
+    b += off;
+    int total = 0;
+
+    // Serve what we can from the buffer first.
+    if (s->buf_len && s->pos >= s->buf_start && s->pos < s->buf_start + s->buf_len) {
+        int avail = (int)(s->buf_start + s->buf_len - s->pos);
+        int n = (len < avail) ? len : avail;
+        memcpy(b, s->buf + (s->pos - s->buf_start), n);
+        s->pos += n;
+        total += n;
+        b += n;
+        len -= n;
+    }
+
+    if (len == 0) {
+        return total;
     }
 
-    return (int)bytes_read;
+    if (len < INPUT_STREAM_BUFFER_SIZE && !s->buf) {
+        s->buf = malloc(INPUT_STREAM_BUFFER_SIZE);
+    }
+
+    if (len >= INPUT_STREAM_BUFFER_SIZE || !s->buf) {
+        // Large reads go straight to the destination. So do small ones if
+        // there's no memory for the buffer; we'll try to get it next time.
+        int n = stream_read_fd(s, b, len);
+        if (n > 0) {
+            s->pos += n;
+            total += n;
+        }
+    } else {
+        // Small reads refill the buffer, so the next ones are memcpys.
+        s->buf_start = s->pos;
+        s->buf_len = 0;
+        int n = stream_read_fd(s, s->buf, INPUT_STREAM_BUFFER_SIZE);
+        if (n > 0) {
+            s->buf_len = n;
+            int c = (len < n) ? len : n;
+            memcpy(b, s->buf, c);
+            s->pos += c;
+            total += c;
+        }
+    }
+
+    return (total > 0) ? total : -1;
 }
 
 // public void close ()
 // https://developer.android.com/reference/android/content/res/AssetManager#close()
-void InputStream_close(int id, va_list args) {
+void InputStream_close(int id, jobject thiz, const jvalue* args) {
     debugPrintf("JNI: Method Call: InputStream_close() / id: %i\n", id);
-    //pthread_mutex_destroy(&mut);
-    if (f) {
-        fclose(f);
-        f = NULL;
-    }
-    if (fd > -1) {
-        close(fd);
-        fd = -1;
+
+    InputStream* s = stream_get(thiz);
+    if (s) {
+        stream_free(s);
     }
 }
 
 // public long skip(long n)
 // https://docs.oracle.com/javase/7/docs/api/java/io/InputStream.html#skip(long)
-jlong InputStream_skip(int id, va_list args) {
+jlong InputStream_skip(int id, jobject thiz, const jvalue* args) {
     debugPrintf("JNI: Method Call: InputStream_skip() / id: %i\n", id);
-    int64_t off = va_arg(args, int64_t);
+    int64_t n = args[0].j;
 
-    if (!f) {
-        debugPrintf("[java.io.InputStream.skip()] File descriptor is NULL.\n");
-        return -1;
+    InputStream* s = stream_get(thiz);
+    if (!s || stream_open_fd(s) != 0) {
+        return 0;
     }
 
-    if (fseek(f, off, SEEK_CUR) < 0 ) {
-        return -1;
-    }
+    // Only the position moves; the file is seeked on the next read.
+    int64_t left = s->length - s->pos;
+    if (n > left) n = left;
+    if (n <= 0) return 0;
 
-    // NOTE: According to Java docs, this function must return the actual
-    // number of bytes skipped. For efficiency, let's not count that.
-    return 1;
+    s->pos += n;
+    return n;
 }
 
 // public InputStream open (String fileName)
 // https://developer.android.com/reference/android/content/res/AssetManager#open(java.lang.String)
-jobject InputStream_open(int id, va_list args) {
-    // This method is supposed to initialize the asset to be opened, but
-    // since we don't need that, let's just return a dummy string that can
-    // be freed later.
-    debugPrintf("JNI: Method Call: InputStream_open(%) / id: %i\n", id);
-    //pthread_mutex_init(&mut, NULL);
-    return strdup("nop");
+jobject InputStream_open(int id, jobject thiz, const jvalue* args) {
+    const char* fileName = args[0].l;
+    debugPrintf("JNI: Method Call: InputStream_open(\"%s\") / id: %i\n", fileName, id);
+
+    // The file itself is opened on first use.
+    return (jobject)stream_new(fileName);
 }
 
 // public AssetFileDescriptor openFd (String fileName)
 // https://developer.android.com/reference/android/content/res/AssetManager#openFd(java.lang.String)
-jint InputStream_openFd(int id, va_list args) {
+jobject InputStream_openFd(int id, jobject thiz, const jvalue* args) {
     debugPrintf("JNI: Method Call: InputStream_openFd() / id: %i\n", id);
-    const char* fileName = va_arg(args, const char*);
+    const char* fileName = args[0].l;
 
-    char temp[1024];
-    sprintf(temp, "%s%s", assetsPathPrefix, fileName);
+    InputStream* s = stream_new(fileName);
+    if (!s) {
+        return NULL;
+    }
+
+    debugPrintf("[java.io.InputStream] InputStream_openFd(\"%s\")\n", s->path);
+
+    // Unlike open(), a missing file has to be reported right away (with
+    // FileNotFoundException on a real VM).
+    if (stream_open_fd(s) != 0) {
+        stream_free(s);
+        return NULL;
+    }
 
-    debugPrintf("[java.io.InputStream] InputStream_openFd(\"%s\")\n", temp);
-    fd = open(temp, O_RDONLY);
-    return fd;
+    return (jobject)s;
 }
 
 
 
 // public String[] list (String path)
 // https://developer.android.com/reference/android/content/res/AssetManager#list(java.lang.String)
-jobject InputStream_list(int id, va_list args) {
-    const char* path_tmp = va_arg(args, const char*);
+jobject InputStream_list(int id, jobject thiz, const jvalue* args) {
+    const char* path_tmp = args[0].l;
 
     debugPrintf("JNI: Method Call: InputStream_list() / id: %i / path: \"%s\" (0x%x)\n", id, path_tmp, path_tmp);
 
-    char* path = malloc(512 * sizeof(char)); // freed in _internal()
-    snprintf(path, 512, "%s%s", assetsPathPrefix, path_tmp);
-
-    //pthread_mutex_lock(&mut);
-
-    char** paths_stack = malloc(sizeof(char*) * 1024);
-
-    int i = 0;
-    paths_stack[i++] = path;
-
-    int first_run = 1;
-
-    while (i > 0) {
-        path = paths_stack[--i];
-
-        DIR *dir;
-        struct dirent *entry;
-
-        calls_count++;
-
-        if (!(dir = opendir(path))) {
-            free(path);
-            continue;
-        }
-
-        while ((entry = readdir(dir)) != NULL) {
-            char* p = malloc(1000 * sizeof(char));
-
-            if (first_run) {
-                snprintf(p, 999, "%s%s", path, entry->d_name);
-            } else {
-                snprintf(p, 999, "%s/%s", path, entry->d_name);
-            }
-
-            if (!is_dir(p)) {
-                if (listSize == 0) {
-                    list = malloc(sizeof(char*) * 1734);
-                    listAllocedSize = 1733;
-                } else {
-                    if (listSize >= listAllocedSize) {
-                        list = realloc(list, (sizeof(char*) * (listSize+100)));
-                        listAllocedSize = listSize + 99;
-                    }
-                }
-                list[listSize] = strdup(p);
-                listSize++;
-                free(p); // crash here
-            } else {
-                if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
-                    continue;
-                paths_stack[i++] = p;
-            }
-        }
-        closedir(dir);
-        free(path);
-
-        if (first_run) {
-            first_run = 0;
-        }
+    // Like before, lists every file under the directory, recursively, with
+    // full paths. A directory name without the trailing slash is accepted.
+    char prefix[512];
+    size_t len = snprintf(prefix, sizeof(prefix) - 1, "%s%s", assetsPathPrefix, path_tmp ? path_tmp : "");
+    if (len >= sizeof(prefix) - 1) len = strlen(prefix);
+    if (len > 0 && prefix[len - 1] != '/') {
+        prefix[len++] = '/';
+        prefix[len] = '\0';
     }
 
-    char** list_ret = malloc(sizeof(char*) * listSize);
-
-    for (int u = 0; u < listSize; ++u) {
-        list_ret[u] = strdup(list[u]);
-        free(list[u]);
-    }
+    size_t count;
+    char** paths = asset_index_find(prefix, &count);
 
-    debugPrintf("OL1\n");
-    saveDynamicallyAllocatedArrayPointer(list_ret, (jsize)listSize);
-    debugPrintf("OL2\n");
-    free(list);
-    debugPrintf("OL3\n");
-    listSize = 0;
-    debugPrintf("OL4\n");
+    char** list_ret = malloc(sizeof(char*) * (count ? count : 1));
+    if (count) memcpy(list_ret, paths, sizeof(char*) * count);
 
-    //pthread_mutex_unlock(&mut);
-    debugPrintf("OL5\n");
+    saveDynamicallyAllocatedArrayPointer(list_ret, (jsize)count);
     return (jobject)list_ret;
 }
 
 // public long getLength ()
 // https://developer.android.com/reference/android/content/res/AssetFileDescriptor#getLength()
-jlong InputStream_getLength(int id, va_list args) {
-    debugPrintf("JNI: Method Call: InputStream_getLength() / id: %i / fd: %i\n", id, fd);
+jlong InputStream_getLength(int id, jobject thiz, const jvalue* args) {
+    debugPrintf("JNI: Method Call: InputStream_getLength() / id: %i\n", id);
 
-    if (fd == -1) {
-        debugPrintf("[java.io.InputStream.getLength()] Error: fd is invalid\n");
+    InputStream* s = stream_get(thiz);
+    if (!s || stream_open_fd(s) != 0) {
+        debugPrintf("[java.io.InputStream.getLength()] Error: invalid stream\n");
         return -1;
     }
 
-    size_t sz = lseek(fd, 0L, SEEK_END);
-    lseek(fd, 0L, SEEK_SET);
-
-    return (jlong)sz;
+    return (jlong)s->length;
 }
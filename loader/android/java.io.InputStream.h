@@ -3,30 +3,39 @@
 #include <stdio.h>
 #include "android/jni.h"
 
+// Streams that can be open at the same time.
+#define INPUT_STREAMS_MAX 64
+
+// Reads smaller than this go through a per-stream buffer of this size.
+#define INPUT_STREAM_BUFFER_SIZE (16 * 1024)
+
+// Whether `p` is a stream handle returned by open() or openFd().
+jboolean InputStream_isHandle(const void* p);
+
 // public int read(byte[] b, int off, int len)
 // https://docs.oracle.com/javase/7/docs/api/java/io/InputStream.html#read()
-jint InputStream_read(int id, va_list args);
+jint InputStream_read(int id, jobject thiz, const jvalue* args);
 
 // public long skip(long n)
 // https://docs.oracle.com/javase/7/docs/api/java/io/InputStream.html#skip(long)
-jlong InputStream_skip(int id, va_list args);
+jlong InputStream_skip(int id, jobject thiz, const jvalue* args);
 
 // public void close ()
 // https://developer.android.com/reference/android/content/res/AssetManager#close()
-void InputStream_close(int id, va_list args);
+void InputStream_close(int id, jobject thiz, const jvalue* args);
 
 // public InputStream open (String fileName)
 // https://developer.android.com/reference/android/content/res/AssetManager#open(java.lang.String)
-jobject InputStream_open(int id, va_list args);
+jobject InputStream_open(int id, jobject thiz, const jvalue* args);
 
 // public AssetFileDescriptor openFd (String fileName)
 // https://developer.android.com/reference/android/content/res/AssetManager#openFd(java.lang.String)
-jint InputStream_openFd(int id, va_list args);
+jobject InputStream_openFd(int id, jobject thiz, const jvalue* args);
 
 // public String[] list (String path)
 // https://developer.android.com/reference/android/content/res/AssetManager#list(java.lang.String)
-jobject InputStream_list(int id, va_list args);
+jobject InputStream_list(int id, jobject thiz, const jvalue* args);
 
 // public long getLength ()
 // https://developer.android.com/reference/android/content/res/AssetFileDescriptor#getLength()
-jlong InputStream_getLength(int id, va_list args);
+jlong InputStream_getLength(int id, jobject thiz, const jvalue* args);
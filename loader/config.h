@@ -14,7 +14,8 @@
 
 /*
  * Following config definitions are set from CMake:
- * DEBUG, DEBUG_GL, GRAPHICS_API, DATA_PATH, DATA_PATH_INT, SO_PATH
+ * DEBUG, DEBUG_GL, JNI_PROFILER, JNI_TRACE, IO_TRACE, GRAPHICS_API,
+ * DATA_PATH, DATA_PATH_INT, SO_PATH
  */
 
 #define GRAPHICS_API_VITAGL 0
@@ -930,7 +930,7 @@ so_default_dynlib default_dynlib[] = {
         { "exit", (uintptr_t)&exit },
         { "exp", (uintptr_t)&exp },
         { "expf", (uintptr_t)&expf },
-        { "fclose", (uintptr_t)&fclose },
+        { "fclose", (uintptr_t)&fclose_soloader },
         { "fcntl", (uintptr_t)&fcntl_soloader },
         { "fflush", (uintptr_t)&fflush },
         { "fgetc", (uintptr_t)&fgetc },
@@ -949,7 +949,7 @@ so_default_dynlib default_dynlib[] = {
         { "fstat", (uintptr_t)&fstat_soloader },
         { "fsync", (uintptr_t)&fsync_soloader},
         { "ftell", (uintptr_t)&ftell },
-        { "ftruncate", (uintptr_t)&ftruncate},
+        { "ftruncate", (uintptr_t)&ftruncate_soloader },
         { "fwide", (uintptr_t)&fwide},
         { "fwrite", (uintptr_t)&fwrite },
         { "getaddrinfo", (uintptr_t)&getaddrinfo },
@@ -1359,7 +1359,7 @@ so_default_dynlib default_dynlib[] = {
         { "memcpy", (uintptr_t)&memcpy },
         { "memmove", (uintptr_t)&memmove },
         { "memset", (uintptr_t)&memset },
-        { "mkdir", (uintptr_t)&mkdir },
+        { "mkdir", (uintptr_t)&mkdir_soloader },
         { "mktime", (uintptr_t)&mktime},
         { "mmap", (uintptr_t)&mmap },
         { "modf", (uintptr_t)&modf },
@@ -1412,9 +1412,9 @@ so_default_dynlib default_dynlib[] = {
         { "realloc", (uintptr_t)&realloc },
         { "recv", (uintptr_t)&recv},
         { "recvfrom", (uintptr_t)&recvfrom},
-        { "remove", (uintptr_t)&remove},
-        { "rename", (uintptr_t)&rename},
-        { "rmdir", (uintptr_t)&rmdir},
+        { "remove", (uintptr_t)&remove_soloader },
+        { "rename", (uintptr_t)&rename_soloader },
+        { "rmdir", (uintptr_t)&rmdir_soloader },
         { "sbrk", (uintptr_t)&sbrk},
         { "sched_yield", (uintptr_t)&sched_yield},
         { "sem_destroy", (uintptr_t) &sem_destroy_soloader},
@@ -1459,7 +1459,7 @@ so_default_dynlib default_dynlib[] = {
         { "tanf", (uintptr_t)&tanf },
         { "time", (uintptr_t)&time },
         { "ungetc", (uintptr_t)&ungetc },
-        { "unlink", (uintptr_t)&unlink},
+        { "unlink", (uintptr_t)&unlink_soloader },
         { "usleep", (uintptr_t)&usleep },
         { "utime", (uintptr_t)&utime },
         { "vsnprintf", (uintptr_t)&vsnprintf },
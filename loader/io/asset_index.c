@@ -0,0 +1,422 @@
+/*
+ * io/asset_index.c
+ *
+ * Sorted index of every file under DATA_PATH_INT, kept on disk between runs
+ * so that AssetManager.list() never has to walk the assets tree.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "asset_index.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <psp2/kernel/processmgr.h>
+
+#include "asset_pack.h"
+#include "utils/utils.h"
+
+// Loaded index. `data` is the file image, the rest points into it, except
+// for `paths`, which has the files resolved to pointers for find().
+static struct {
+    uint8_t* data;
+    size_t size;
+    const AssetIndexHeader* header;
+    const AssetIndexDir* dirs;
+    const char* strings;
+    char** paths;
+} assetIndex;
+
+static pthread_once_t assetIndex_once = PTHREAD_ONCE_INIT;
+
+typedef struct {
+    char** items;
+    int64_t* mtimes;
+    uint32_t count;
+    uint32_t alloced;
+    int failed; // out of memory, the list is incomplete
+} PathList;
+
+// Takes ownership of `path`, which may be NULL if allocating it failed.
+static void path_list_add(PathList* l, char* path, int64_t mtime) {
+    if (path && l->count == l->alloced) {
+        uint32_t alloced = l->alloced ? l->alloced * 2 : 256;
+        char** items = realloc(l->items, alloced * sizeof(char*));
+        if (items) l->items = items;
+        int64_t* mtimes = items ? realloc(l->mtimes, alloced * sizeof(int64_t)) : NULL;
+        if (mtimes) l->mtimes = mtimes;
+
+        if (mtimes) {
+            l->alloced = alloced;
+        } else {
+            free(path);
+            path = NULL;
+        }
+    }
+    if (!path) {
+        l->failed = 1;
+        return;
+    }
+    l->items[l->count] = path;
+    l->mtimes[l->count] = mtime;
+    l->count++;
+}
+
+static void path_list_free(PathList* l) {
+    for (uint32_t i = 0; i < l->count; i++) free(l->items[i]);
+    free(l->items);
+    free(l->mtimes);
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Assets root without the trailing slash, so that every path in the index
+// is "<dir>/<name>".
+static char* root_path() {
+    char* root = strdup(DATA_PATH_INT);
+    if (!root) return NULL;
+    size_t len = strlen(root);
+    if (len > 1 && root[len - 1] == '/') root[len - 1] = '\0';
+    return root;
+}
+
+// Validates the image and sets up the pointers into it. Takes ownership of
+// `data` on success.
+static int parse(uint8_t* data, size_t size) {
+    const AssetIndexHeader* h = (const AssetIndexHeader*)data;
+    if (size < sizeof(*h) || h->magic != ASSET_INDEX_MAGIC || h->version != ASSET_INDEX_VERSION
+        || h->dirs_count == 0) {
+        return 0;
+    }
+
+    size_t expected = sizeof(*h) + (size_t)h->dirs_count * sizeof(AssetIndexDir)
+                      + (size_t)h->files_count * sizeof(uint32_t) + h->strings_size;
+    if (size != expected || h->strings_size == 0) return 0;
+
+    const AssetIndexDir* dirs = (const AssetIndexDir*)(data + sizeof(*h));
+    const uint32_t* files = (const uint32_t*)(dirs + h->dirs_count);
+    const char* strings = (const char*)(files + h->files_count);
+
+    if (strings[h->strings_size - 1] != '\0') return 0;
+    for (uint32_t i = 0; i < h->dirs_count; i++) {
+        if (dirs[i].path >= h->strings_size) return 0;
+    }
+    for (uint32_t i = 0; i < h->files_count; i++) {
+        if (files[i] >= h->strings_size) return 0;
+    }
+
+    assetIndex.paths = malloc((h->files_count ? h->files_count : 1) * sizeof(char*));
+    if (!assetIndex.paths) return 0;
+    for (uint32_t i = 0; i < h->files_count; i++) {
+        assetIndex.paths[i] = (char*)strings + files[i];
+    }
+
+    assetIndex.data = data;
+    assetIndex.size = size;
+    assetIndex.header = h;
+    assetIndex.dirs = dirs;
+    assetIndex.strings = strings;
+    return 1;
+}
+
+// The index is stale if it was built for another root or if any directory
+// changed since.
+static int is_fresh() {
+    char* root = root_path();
+    int fresh = root && strcmp(assetIndex.strings + assetIndex.dirs[0].path, root) == 0;
+    free(root);
+
+    for (uint32_t i = 0; fresh && i < assetIndex.header->dirs_count; i++) {
+        struct stat st;
+        const char* path = assetIndex.strings + assetIndex.dirs[i].path;
+        int64_t mtime = (stat(path, &st) == 0) ? (int64_t)st.st_mtime : -1;
+        if (mtime != assetIndex.dirs[i].mtime) {
+            debugPrintf("[AssetIndex] %s changed.\n", path);
+            fresh = 0;
+        }
+    }
+
+    return fresh;
+}
+
+static int load() {
+    FILE* f = fopen(ASSET_INDEX_PATH, "rb");
+    if (!f) return 0;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t* data = NULL;
+    if (size > 0) {
+        data = malloc(size);
+        if (data && fread(data, 1, size, f) != (size_t)size) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(f);
+
+    if (!data || !parse(data, size)) {
+        free(data);
+        return 0;
+    }
+    return 1;
+}
+
+static void unload() {
+    free(assetIndex.paths);
+    free(assetIndex.data);
+    memset(&assetIndex, 0, sizeof(assetIndex));
+}
+
+static void walk(PathList* dirs, PathList* files) {
+    char** stack = malloc(sizeof(char*) * 1024);
+    uint32_t stack_alloced = 1024;
+    uint32_t depth = 0;
+
+    if (!stack || !(stack[depth++] = root_path())) {
+        dirs->failed = 1;
+        free(stack);
+        return;
+    }
+
+    while (depth > 0 && !dirs->failed && !files->failed) {
+        char* path = stack[--depth];
+
+        struct stat st;
+        DIR* dir;
+        if (stat(path, &st) != 0 || !(dir = opendir(path))) {
+            free(path);
+            continue;
+        }
+        path_list_add(dirs, path, (int64_t)st.st_mtime);
+        if (dirs->failed) {
+            closedir(dir);
+            break;
+        }
+
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+
+            size_t len = strlen(path) + 1 + strlen(entry->d_name) + 1;
+            char* p = malloc(len);
+            if (!p) {
+                files->failed = 1;
+                break;
+            }
+            snprintf(p, len, "%s/%s", path, entry->d_name);
+
+            if (stat(p, &st) != 0) {
+                free(p);
+            } else if (S_ISDIR(st.st_mode)) {
+                if (depth == stack_alloced) {
+                    char** grown = realloc(stack, sizeof(char*) * stack_alloced * 2);
+                    if (!grown) {
+                        free(p);
+                        dirs->failed = 1;
+                        break;
+                    }
+                    stack = grown;
+                    stack_alloced *= 2;
+                }
+                stack[depth++] = p;
+            } else {
+                path_list_add(files, p, 0);
+            }
+        }
+        closedir(dir);
+    }
+
+    // Left over if we ran out of memory.
+    while (depth > 0) free(stack[--depth]);
+    free(stack);
+}
+
+static void save(const uint8_t* data, size_t size) {
+    const char* tmp = ASSET_INDEX_PATH ".tmp";
+
+    FILE* f = fopen(tmp, "wb");
+    if (!f) {
+        debugPrintf("[AssetIndex] Can't open %s for writing.\n", tmp);
+        return;
+    }
+    size_t written = fwrite(data, 1, size, f);
+    fclose(f);
+
+    if (written != size) {
+        remove(tmp);
+        return;
+    }
+
+    remove(ASSET_INDEX_PATH);
+    rename(tmp, ASSET_INDEX_PATH);
+}
+
+// Adds the files from the asset pack, which may not exist as loose files.
+// The pack is watched like a directory, with -1 standing for "no pack".
+static void add_pack(PathList* dirs, PathList* files) {
+    struct stat st;
+    path_list_add(dirs, strdup(ASSET_PACK_PATH), (stat(ASSET_PACK_PATH, &st) == 0) ? (int64_t)st.st_mtime : -1);
+
+    char* root = root_path();
+    if (!root) {
+        files->failed = 1;
+        return;
+    }
+    uint32_t count = asset_pack_count();
+    for (uint32_t i = 0; i < count; i++) {
+        const char* name = asset_pack_name(i);
+        size_t len = strlen(root) + 1 + strlen(name) + 1;
+        char* p = malloc(len);
+        if (p) snprintf(p, len, "%s/%s", root, name);
+        path_list_add(files, p, 0);
+    }
+    free(root);
+}
+
+static void build() {
+    PathList dirs = { 0 }, files = { 0 };
+    walk(&dirs, &files);
+
+    if (dirs.count == 0) {
+        debugPrintf("[AssetIndex] Can't open %s.\n", DATA_PATH_INT);
+        path_list_free(&dirs);
+        path_list_free(&files);
+        return;
+    }
+
+    add_pack(&dirs, &files);
+
+    if (dirs.failed || files.failed) {
+        debugPrintf("[AssetIndex] Out of memory, going without the index.\n");
+        path_list_free(&dirs);
+        path_list_free(&files);
+        return;
+    }
+
+    qsort(files.items, files.count, sizeof(char*), compare_paths);
+
+    // Packed files that also exist loose are listed once.
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < files.count; i++) {
+        if (unique > 0 && strcmp(files.items[unique - 1], files.items[i]) == 0) {
+            free(files.items[i]);
+        } else {
+            files.items[unique++] = files.items[i];
+        }
+    }
+    files.count = unique;
+
+    uint32_t strings_size = 0;
+    for (uint32_t i = 0; i < dirs.count; i++) strings_size += strlen(dirs.items[i]) + 1;
+    for (uint32_t i = 0; i < files.count; i++) strings_size += strlen(files.items[i]) + 1;
+
+    size_t size = sizeof(AssetIndexHeader) + dirs.count * sizeof(AssetIndexDir)
+                  + files.count * sizeof(uint32_t) + strings_size;
+    uint8_t* data = calloc(1, size);
+    if (!data) {
+        debugPrintf("[AssetIndex] Out of memory, going without the index.\n");
+        path_list_free(&dirs);
+        path_list_free(&files);
+        return;
+    }
+
+    AssetIndexHeader* h = (AssetIndexHeader*)data;
+    h->magic = ASSET_INDEX_MAGIC;
+    h->version = ASSET_INDEX_VERSION;
+    h->dirs_count = dirs.count;
+    h->files_count = files.count;
+    h->strings_size = strings_size;
+
+    AssetIndexDir* d = (AssetIndexDir*)(data + sizeof(*h));
+    uint32_t* f = (uint32_t*)(d + dirs.count);
+    char* strings = (char*)(f + files.count);
+    uint32_t off = 0;
+
+    for (uint32_t i = 0; i < dirs.count; i++) {
+        d[i].path = off;
+        d[i].mtime = dirs.mtimes[i];
+        off += sprintf(strings + off, "%s", dirs.items[i]) + 1;
+    }
+    for (uint32_t i = 0; i < files.count; i++) {
+        f[i] = off;
+        off += sprintf(strings + off, "%s", files.items[i]) + 1;
+    }
+
+    path_list_free(&dirs);
+    path_list_free(&files);
+
+    save(data, size);
+    if (!parse(data, size)) free(data);
+}
+
+static void asset_index_init() {
+    uint32_t start = sceKernelGetProcessTimeLow();
+
+    if (load()) {
+        if (is_fresh()) {
+            debugPrintf("[AssetIndex] Loaded %u files in %u us.\n",
+                        assetIndex.header->files_count, sceKernelGetProcessTimeLow() - start);
+            return;
+        }
+        unload();
+    }
+
+    build();
+
+    if (assetIndex.header) {
+        debugPrintf("[AssetIndex] Indexed %u files in %u directories in %u us.\n",
+                    assetIndex.header->files_count, assetIndex.header->dirs_count,
+                    sceKernelGetProcessTimeLow() - start);
+    }
+}
+
+char** asset_index_find(const char* prefix, size_t* count) {
+    pthread_once(&assetIndex_once, asset_index_init);
+
+    *count = 0;
+    if (!assetIndex.header) return NULL;
+
+    size_t len = strlen(prefix);
+    size_t n = assetIndex.header->files_count;
+    char** paths = assetIndex.paths;
+
+    // First path >= prefix.
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(paths[mid], prefix) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+
+    // First path past the ones starting with prefix.
+    size_t end = lo;
+    hi = n;
+    while (end < hi) {
+        size_t mid = end + (hi - end) / 2;
+        if (strncmp(paths[mid], prefix, len) <= 0) end = mid + 1;
+        else hi = mid;
+    }
+
+    *count = end - lo;
+    return paths + lo;
+}
+
+int asset_index_owns(const void* p) {
+    if (!assetIndex.header) return 0;
+
+    const char* c = p;
+    return c >= assetIndex.strings && c < assetIndex.strings + assetIndex.header->strings_size;
+}
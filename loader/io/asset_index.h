@@ -0,0 +1,64 @@
+/*
+ * io/asset_index.h
+ *
+ * Sorted index of every file under DATA_PATH_INT, kept on disk between runs
+ * so that AssetManager.list() never has to walk the assets tree.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_ASSET_INDEX_H
+#define SOLOADER_ASSET_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ASSET_INDEX_PATH DATA_PATH "assets_index.bin"
+
+#define ASSET_INDEX_MAGIC 0x58444941 // "AIDX"
+#define ASSET_INDEX_VERSION 1
+
+/*
+ * File layout, native byte order:
+ *
+ *   AssetIndexHeader
+ *   AssetIndexDir   dirs[dirs_count]    dirs[0] is the assets root
+ *   uint32_t        files[files_count]  offsets into strings, sorted by path
+ *   char            strings[strings_size]
+ *
+ * All paths are full paths, the way the game expects them from list(). Files
+ * from the asset pack are included. The index is rebuilt when the mtime of a
+ * directory changes, which happens whenever an entry is added to, removed
+ * from or renamed in it, or when the asset pack is replaced. The pack is
+ * kept in dirs as well, with an mtime of -1 when there is none.
+ */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dirs_count;
+    uint32_t files_count;
+    uint32_t strings_size;
+} AssetIndexHeader;
+
+typedef struct {
+    uint32_t path; // offset into strings
+    uint32_t reserved;
+    int64_t mtime;
+} AssetIndexDir;
+
+/*
+ * Returns the files whose full path starts with `prefix`, as a range of the
+ * sorted index: `*count` entries starting at the returned pointer. Loads or
+ * builds the index on the first call. The strings are owned by the index
+ * and must not be freed.
+ */
+char** asset_index_find(const char* prefix, size_t* count);
+
+// Whether `p` points into the index's strings.
+int asset_index_owns(const void* p);
+
+#endif // SOLOADER_ASSET_INDEX_H
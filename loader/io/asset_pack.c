@@ -0,0 +1,467 @@
+/*
+ * io/asset_pack.c
+ *
+ * Optional single-file asset pack, built with tools/asset_packer.py. Files
+ * found in the pack are served through virtual fds instead of being looked
+ * up on the memory card one by one; everything else falls back to loose
+ * files.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "asset_pack.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <psp2/io/fcntl.h>
+
+#include "lz4.h"
+#include "utils/utils.h"
+
+typedef struct {
+    int used;
+    uint32_t entry;
+    int64_t pos;
+    uint32_t* blocks; // block table of compressed entries
+} AssetPackFd;
+
+typedef struct {
+    uint32_t entry;
+    uint32_t block;
+    int32_t len;      // -1 if the slot is empty
+    uint32_t last_used;
+    uint8_t* data;
+} AssetPackCachedBlock;
+
+static SceUID assetPack_fd = -1;
+static uint64_t assetPack_size = 0;
+static uint8_t* assetPack_index = NULL;
+static const AssetPackHeader* assetPack_header = NULL;
+static const AssetPackEntry* assetPack_entries = NULL;
+static const char* assetPack_names = NULL;
+
+static AssetPackFd assetPack_fds[ASSET_PACK_FDS_MAX];
+static pthread_mutex_t assetPack_fds_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t assetPack_once = PTHREAD_ONCE_INIT;
+
+// Only held to look blocks up and to put them in: reading and decompressing
+// a block is done outside of it, so a miss doesn't hold up readers of other
+// blocks.
+static AssetPackCachedBlock assetPack_cache[ASSET_PACK_CACHE_BLOCKS];
+static uint32_t assetPack_cache_clock = 0;
+static pthread_mutex_t assetPack_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Whether `size` bytes at `offset` are inside the pack file.
+static int in_pack(uint64_t offset, uint64_t size) {
+    return size <= assetPack_size && offset <= assetPack_size - size;
+}
+
+static int load(SceUID fd) {
+    AssetPackHeader h;
+    if (sceIoPread(fd, &h, sizeof(h), 0) != sizeof(h)) return 0;
+
+    if (h.magic != ASSET_PACK_MAGIC || h.version != ASSET_PACK_VERSION) {
+        debugPrintf("[AssetPack] %s: bad header.\n", ASSET_PACK_PATH);
+        return 0;
+    }
+
+    SceOff pack_size = sceIoLseek(fd, 0, SCE_SEEK_END);
+    if (pack_size < 0) return 0;
+    assetPack_size = (uint64_t)pack_size;
+
+    uint64_t index_size64 = sizeof(h) + (uint64_t)h.entries_count * sizeof(AssetPackEntry) + h.names_size;
+    uint32_t index_size = (uint32_t)index_size64;
+    if (h.names_size == 0 || index_size64 > h.data_offset || !in_pack(0, h.data_offset)) {
+        debugPrintf("[AssetPack] %s: bad index.\n", ASSET_PACK_PATH);
+        return 0;
+    }
+
+    uint8_t* index = malloc(index_size);
+    if (!index) {
+        debugPrintf("[AssetPack] Out of memory for the index of %s.\n", ASSET_PACK_PATH);
+        return 0;
+    }
+    if (sceIoPread(fd, index, index_size, 0) != (int)index_size) {
+        free(index);
+        return 0;
+    }
+
+    const AssetPackHeader* header = (const AssetPackHeader*)index;
+    const AssetPackEntry* entries = (const AssetPackEntry*)(index + sizeof(h));
+    const char* names = (const char*)(entries + h.entries_count);
+
+    // Entries must lie inside the file, so that no read can go past its
+    // end; for compressed ones, that's checked for the block table here and
+    // for the blocks once the table is read.
+    int ok = names[h.names_size - 1] == '\0';
+    for (uint32_t i = 0; ok && i < h.entries_count; i++) {
+        const AssetPackEntry* e = &entries[i];
+        ok = e->name < h.names_size && e->offset >= h.data_offset;
+        if (e->flags & ASSET_PACK_ENTRY_LZ4) {
+            ok = ok && h.block_size > 0 && h.block_size <= (1 << 20);
+            uint64_t count = ok ? (e->size + h.block_size - 1) / h.block_size : 0;
+            ok = ok && in_pack(e->offset, (count + 1) * sizeof(uint32_t));
+        } else {
+            ok = ok && in_pack(e->offset, e->size);
+        }
+    }
+    if (!ok) {
+        debugPrintf("[AssetPack] %s: bad index.\n", ASSET_PACK_PATH);
+        free(index);
+        return 0;
+    }
+
+    assetPack_index = index;
+    assetPack_header = header;
+    assetPack_entries = entries;
+    assetPack_names = names;
+    return 1;
+}
+
+static void init_once() {
+    SceUID fd = sceIoOpen(ASSET_PACK_PATH, SCE_O_RDONLY, 0);
+    if (fd < 0) return;
+
+    if (!load(fd)) {
+        sceIoClose(fd);
+        return;
+    }
+
+    for (int i = 0; i < ASSET_PACK_CACHE_BLOCKS; i++) {
+        assetPack_cache[i].len = -1;
+    }
+
+    assetPack_fd = fd;
+    debugPrintf("[AssetPack] Using %s, %u files.\n", ASSET_PACK_PATH, assetPack_header->entries_count);
+}
+
+void asset_pack_init() {
+    pthread_once(&assetPack_once, init_once);
+}
+
+// Strips DATA_PATH_INT off `path`, or returns NULL if it's not an asset.
+static const char* relative_path(const char* path) {
+    static const char prefix[] = DATA_PATH_INT;
+    if (!path || strncmp(path, prefix, sizeof(prefix) - 1) != 0) return NULL;
+
+    path += sizeof(prefix) - 1;
+    while (*path == '/') path++;
+    return path;
+}
+
+// Index of the first entry whose name is >= `name`.
+static uint32_t lower_bound(const char* name) {
+    uint32_t lo = 0, hi = assetPack_header->entries_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (strcmp(assetPack_names + assetPack_entries[mid].name, name) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int find(const char* path, uint32_t* entry) {
+    asset_pack_init();
+    if (assetPack_fd < 0) return 0;
+
+    const char* rel = relative_path(path);
+    if (!rel) return 0;
+
+    uint32_t i = lower_bound(rel);
+    if (i < assetPack_header->entries_count && strcmp(assetPack_names + assetPack_entries[i].name, rel) == 0) {
+        *entry = i;
+        return 1;
+    }
+    return 0;
+}
+
+static AssetPackFd* fd_get(int fd) {
+    int slot = fd - ASSET_PACK_FD_BASE;
+    if (slot < 0 || slot >= ASSET_PACK_FDS_MAX || !assetPack_fds[slot].used) {
+        errno = EBADF;
+        return NULL;
+    }
+    return &assetPack_fds[slot];
+}
+
+// Reads the block table of a compressed entry, and checks that the blocks
+// are in order and inside the pack file.
+static uint32_t* load_blocks(const AssetPackEntry* e) {
+    uint32_t block_size = assetPack_header->block_size;
+    uint32_t count = (uint32_t)((e->size + block_size - 1) / block_size);
+    int size = (int)((count + 1) * sizeof(uint32_t));
+
+    uint32_t* blocks = malloc(size);
+    if (!blocks) return NULL;
+    if (sceIoPread(assetPack_fd, blocks, size, (SceOff)e->offset) != size) {
+        free(blocks);
+        return NULL;
+    }
+
+    int ok = blocks[0] >= (uint32_t)size && in_pack(e->offset, blocks[count]);
+    for (uint32_t i = 0; ok && i < count; i++) {
+        ok = blocks[i + 1] >= blocks[i] && blocks[i + 1] - blocks[i] <= block_size;
+    }
+    if (!ok) {
+        free(blocks);
+        return NULL;
+    }
+    return blocks;
+}
+
+int asset_pack_open(const char* path) {
+    uint32_t entry;
+    if (!find(path, &entry)) return -1;
+
+    uint32_t* blocks = NULL;
+    if (assetPack_entries[entry].flags & ASSET_PACK_ENTRY_LZ4) {
+        blocks = load_blocks(&assetPack_entries[entry]);
+        if (!blocks) {
+            debugPrintf("[AssetPack] Can't read the block table of %s.\n", path);
+            return -1;
+        }
+    }
+
+    pthread_mutex_lock(&assetPack_fds_mutex);
+    int slot = -1;
+    for (int i = 0; i < ASSET_PACK_FDS_MAX; i++) {
+        if (!assetPack_fds[i].used) {
+            assetPack_fds[i].used = 1;
+            assetPack_fds[i].entry = entry;
+            assetPack_fds[i].pos = 0;
+            assetPack_fds[i].blocks = blocks;
+            slot = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&assetPack_fds_mutex);
+
+    if (slot < 0) {
+        // Not fatal, the caller can still open the loose file if it's there.
+        debugPrintf("[AssetPack] Out of virtual fds, can't open %s.\n", path);
+        free(blocks);
+        return -1;
+    }
+    return ASSET_PACK_FD_BASE + slot;
+}
+
+int asset_pack_is_fd(int fd) {
+    return fd >= ASSET_PACK_FD_BASE && fd < ASSET_PACK_FD_BASE + ASSET_PACK_FDS_MAX;
+}
+
+// Copies what `dst` can take of the cached block `block` of the fd's entry,
+// from `in` on. Returns the number of bytes copied, or -1 if the block isn't
+// cached. Must be called with assetPack_cache_mutex held.
+static int cache_copy(AssetPackFd* f, uint32_t block, int in, uint8_t* dst, int len) {
+    for (int i = 0; i < ASSET_PACK_CACHE_BLOCKS; i++) {
+        AssetPackCachedBlock* c = &assetPack_cache[i];
+        if (c->len >= 0 && c->entry == f->entry && c->block == block) {
+            c->last_used = ++assetPack_cache_clock;
+            int n = c->len - in;
+            if (n > len) n = len;
+            if (n < 0) n = 0;
+            memcpy(dst, c->data + in, n);
+            return n;
+        }
+    }
+    return -1;
+}
+
+// Puts `data` in place of the least recently used block, unless another
+// thread put the same block in meanwhile. Takes ownership of `data`. Must
+// be called with assetPack_cache_mutex held.
+static void cache_put(AssetPackFd* f, uint32_t block, uint8_t* data, int len) {
+    AssetPackCachedBlock* victim = &assetPack_cache[0];
+    for (int i = 0; i < ASSET_PACK_CACHE_BLOCKS; i++) {
+        AssetPackCachedBlock* c = &assetPack_cache[i];
+        if (c->len >= 0 && c->entry == f->entry && c->block == block) {
+            free(data);
+            return;
+        }
+        if (c->len < 0 || c->last_used < victim->last_used) victim = c;
+    }
+
+    free(victim->data);
+    victim->data = data;
+    victim->entry = f->entry;
+    victim->block = block;
+    victim->len = len;
+    victim->last_used = ++assetPack_cache_clock;
+}
+
+// Reads and decompresses block `block` of the fd's entry into a new buffer.
+// Returns NULL on error. Called without any lock held.
+static uint8_t* load_block(AssetPackFd* f, uint32_t block, int* raw_len) {
+    const AssetPackEntry* e = &assetPack_entries[f->entry];
+    uint32_t block_size = assetPack_header->block_size;
+    uint64_t start = (uint64_t)block * block_size;
+    uint32_t packed_len = f->blocks[block + 1] - f->blocks[block];
+    SceOff offset = (SceOff)(e->offset + f->blocks[block]);
+
+    *raw_len = (int)((e->size - start < block_size) ? e->size - start : block_size);
+
+    uint8_t* data = malloc(block_size);
+    if (!data) return NULL;
+
+    if (packed_len == (uint32_t)*raw_len) {
+        if (sceIoPread(assetPack_fd, data, *raw_len, offset) == *raw_len) return data;
+    } else {
+        uint8_t* packed = malloc(packed_len);
+        int ok = packed
+                 && sceIoPread(assetPack_fd, packed, (int)packed_len, offset) == (int)packed_len
+                 && lz4_decompress(packed, (int)packed_len, data, *raw_len) == *raw_len;
+        free(packed);
+        if (ok) return data;
+    }
+
+    free(data);
+    return NULL;
+}
+
+static int read_lz4(AssetPackFd* f, uint8_t* dst, int len) {
+    uint32_t block_size = assetPack_header->block_size;
+    int total = 0;
+
+    while (len > 0) {
+        uint32_t block = (uint32_t)(f->pos / block_size);
+        int in = (int)(f->pos % block_size);
+
+        pthread_mutex_lock(&assetPack_cache_mutex);
+        int n = cache_copy(f, block, in, dst, len);
+        pthread_mutex_unlock(&assetPack_cache_mutex);
+
+        if (n < 0) {
+            int raw_len;
+            uint8_t* data = load_block(f, block, &raw_len);
+            if (!data) {
+                debugPrintf("[AssetPack] Bad block in %s.\n", assetPack_names + assetPack_entries[f->entry].name);
+                break;
+            }
+
+            n = raw_len - in;
+            if (n > len) n = len;
+            if (n < 0) n = 0;
+            memcpy(dst, data + in, n);
+
+            pthread_mutex_lock(&assetPack_cache_mutex);
+            cache_put(f, block, data, raw_len);
+            pthread_mutex_unlock(&assetPack_cache_mutex);
+        }
+
+        if (n <= 0) break;
+        dst += n;
+        len -= n;
+        total += n;
+        f->pos += n;
+    }
+
+    if (total == 0 && len > 0) {
+        errno = EIO;
+        return -1;
+    }
+    return total;
+}
+
+int asset_pack_read(int fd, void* buf, int len) {
+    AssetPackFd* f = fd_get(fd);
+    if (!f) return -1;
+
+    const AssetPackEntry* e = &assetPack_entries[f->entry];
+    if (len <= 0 || f->pos >= (int64_t)e->size) return 0;
+
+    int64_t left = (int64_t)e->size - f->pos;
+    if (len > left) len = (int)left;
+
+    if (f->blocks) return read_lz4(f, buf, len);
+
+    int n = sceIoPread(assetPack_fd, buf, len, (SceOff)(e->offset + f->pos));
+    if (n < 0) {
+        errno = EIO;
+        return -1;
+    }
+    f->pos += n;
+    return n;
+}
+
+int64_t asset_pack_lseek(int fd, int64_t offset, int whence) {
+    AssetPackFd* f = fd_get(fd);
+    if (!f) return -1;
+
+    int64_t pos;
+    switch (whence) {
+        case SEEK_SET: pos = offset; break;
+        case SEEK_CUR: pos = f->pos + offset; break;
+        case SEEK_END: pos = (int64_t)assetPack_entries[f->entry].size + offset; break;
+        default: pos = -1; break;
+    }
+
+    if (pos < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    f->pos = pos;
+    return pos;
+}
+
+int64_t asset_pack_fsize(int fd) {
+    AssetPackFd* f = fd_get(fd);
+    return f ? (int64_t)assetPack_entries[f->entry].size : -1;
+}
+
+int asset_pack_entry(int fd) {
+    AssetPackFd* f = fd_get(fd);
+    return f ? (int)f->entry : -1;
+}
+
+int asset_pack_close(int fd) {
+    AssetPackFd* f = fd_get(fd);
+    if (!f) return -1;
+
+    free(f->blocks);
+    f->blocks = NULL;
+
+    pthread_mutex_lock(&assetPack_fds_mutex);
+    f->used = 0;
+    pthread_mutex_unlock(&assetPack_fds_mutex);
+    return 0;
+}
+
+int asset_pack_stat(const char* path, int64_t* size) {
+    uint32_t entry;
+    if (find(path, &entry)) {
+        *size = (int64_t)assetPack_entries[entry].size;
+        return 1;
+    }
+    if (assetPack_fd < 0) return 0;
+
+    const char* rel = relative_path(path);
+    if (!rel) return 0;
+
+    char dir[1024];
+    size_t len = snprintf(dir, sizeof(dir), "%s/", rel);
+    if (len >= sizeof(dir) || len == 1) return 0;
+    if (len > 1 && dir[len - 2] == '/') dir[--len] = '\0';
+
+    uint32_t i = lower_bound(dir);
+    if (i < assetPack_header->entries_count
+        && strncmp(assetPack_names + assetPack_entries[i].name, dir, len) == 0) {
+        *size = 0;
+        return 2;
+    }
+    return 0;
+}
+
+uint32_t asset_pack_count() {
+    asset_pack_init();
+    return (assetPack_fd < 0) ? 0 : assetPack_header->entries_count;
+}
+
+const char* asset_pack_name(uint32_t i) {
+    return assetPack_names + assetPack_entries[i].name;
+}
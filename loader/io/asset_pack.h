@@ -0,0 +1,100 @@
+/*
+ * io/asset_pack.h
+ *
+ * Optional single-file asset pack, built with tools/asset_packer.py. Files
+ * found in the pack are served through virtual fds instead of being looked
+ * up on the memory card one by one; everything else falls back to loose
+ * files.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_ASSET_PACK_H
+#define SOLOADER_ASSET_PACK_H
+
+#include <stdint.h>
+
+#define ASSET_PACK_PATH DATA_PATH "assets.pak"
+
+#define ASSET_PACK_MAGIC 0x4B415041 // "APAK"
+#define ASSET_PACK_VERSION 2
+
+/*
+ * File layout, little endian:
+ *
+ *   AssetPackHeader
+ *   AssetPackEntry  entries[entries_count]  sorted by name
+ *   char            names[names_size]
+ *   padding up to data_offset
+ *   file data, each file starting at a multiple of `align`
+ *
+ * Names are relative to DATA_PATH_INT, e.g. "published/data/foo.bin".
+ * Everything up to data_offset is loaded with one read.
+ *
+ * Entries flagged ASSET_PACK_ENTRY_LZ4 are split into blocks of block_size
+ * bytes (the last one may be shorter), each compressed separately so that
+ * any offset can be read by decompressing one block. Their data starts with
+ * uint32_t blocks[count + 1], offsets of the blocks relative to the entry's
+ * offset; a block as long as its uncompressed size is stored as is. `size`
+ * is always the uncompressed size.
+ */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entries_count;
+    uint32_t names_size;
+    uint32_t data_offset;
+    uint32_t align;
+    uint32_t block_size;
+    uint32_t reserved;
+} AssetPackHeader;
+
+#define ASSET_PACK_ENTRY_LZ4 1
+
+typedef struct {
+    uint32_t name; // offset into names
+    uint32_t flags;
+    uint64_t offset;
+    uint64_t size;
+} AssetPackEntry;
+
+// Virtual fds start here, well above anything newlib hands out.
+#define ASSET_PACK_FD_BASE 0x10000
+#define ASSET_PACK_FDS_MAX 256
+
+// Decompressed blocks kept around, shared by all virtual fds.
+#define ASSET_PACK_CACHE_BLOCKS 8
+
+// Opens the pack if there is one. Safe to call more than once.
+void asset_pack_init();
+
+// Opens `path` (a full path under DATA_PATH_INT) from the pack. Returns a
+// virtual fd, or -1 if the file isn't packed or there's no pack.
+int asset_pack_open(const char* path);
+
+int asset_pack_is_fd(int fd);
+int asset_pack_read(int fd, void* buf, int len);
+int64_t asset_pack_lseek(int fd, int64_t offset, int whence);
+int64_t asset_pack_fsize(int fd);
+int asset_pack_close(int fd);
+
+// Index of the packed file `fd` reads, the same for every fd of that file,
+// or -1 if `fd` isn't a virtual one.
+int asset_pack_entry(int fd);
+
+// Number of packed files, and their names relative to DATA_PATH_INT.
+uint32_t asset_pack_count();
+const char* asset_pack_name(uint32_t i);
+
+/*
+ * Looks `path` up without opening it. Returns 1 for a packed file (with its
+ * size in `*size`), 2 for a directory that only exists as a prefix of packed
+ * files, 0 otherwise.
+ */
+int asset_pack_stat(const char* path, int64_t* size);
+
+#endif // SOLOADER_ASSET_PACK_H
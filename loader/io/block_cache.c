@@ -0,0 +1,518 @@
+/*
+ * io/block_cache.c
+ *
+ * LRU cache of file blocks, keyed by file identity and block number. Levels
+ * reload the same files on every checkpoint, death and menu visit; with the
+ * cache, only the first load of a block has to come from the memory card.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "block_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "io/io_pool.h"
+#include "io/meta_cache.h"
+#include "utils/settings.h"
+#include "utils/utils.h"
+
+typedef struct BlockCacheEntry {
+    uint32_t file;  // 0 if the entry holds nothing
+    uint32_t block;
+    int len;        // short for the last block of a file
+    uint8_t* data;
+    struct BlockCacheEntry* prev; // LRU list, most recently used first
+    struct BlockCacheEntry* next;
+    struct BlockCacheEntry* hash_next;
+} BlockCacheEntry;
+
+// A file's identity is a number that changes whenever its contents might
+// have: blocks are keyed by it, so stale blocks are never found again and
+// just age out.
+typedef struct {
+    char* path;     // NULL if the slot was never used
+    uint32_t hash;
+    uint32_t id;    // 0 if invalidated
+    int64_t size;
+    int64_t mtime;
+} BlockCacheFile;
+
+typedef struct {
+    int used;
+    uint32_t file;
+    int64_t size;
+    int64_t pos;
+
+    // Guards the kernel offset of the fd, which read-ahead's worker and the
+    // game's thread may both move.
+    pthread_mutex_t io_mutex;
+    int64_t fd_pos;
+} BlockCacheFd;
+
+static BlockCacheEntry* blockCache = NULL;
+static BlockCacheEntry** blockCache_buckets = NULL;
+static uint32_t blockCache_capacity = 0;
+static uint32_t blockCache_bucket_mask = 0;
+static uint32_t blockCache_unused = 0; // entries never handed out yet
+static BlockCacheEntry* blockCache_lru_head = NULL;
+static BlockCacheEntry* blockCache_lru_tail = NULL;
+
+static BlockCacheFile blockCache_files[BLOCK_CACHE_FILES];
+static uint32_t blockCache_files_used = 0;
+static uint32_t blockCache_next_id = 1;
+
+static BlockCacheFd blockCache_fds[BLOCK_CACHE_FDS_MAX];
+static BlockCacheStats blockCache_stats;
+
+// Guards everything above except the io parts of the fds.
+static pthread_mutex_t blockCache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t blockCache_once = PTHREAD_ONCE_INIT;
+
+static void init_once() {
+    int mb = blockCacheSize;
+    if (mb <= 0) return;
+
+    uint32_t capacity = (uint32_t)mb * (1024 * 1024 / BLOCK_CACHE_BLOCK_SIZE);
+    uint32_t buckets = 1;
+    while (buckets < capacity) buckets <<= 1;
+
+    blockCache = calloc(capacity, sizeof(BlockCacheEntry));
+    blockCache_buckets = calloc(buckets, sizeof(BlockCacheEntry*));
+    if (!blockCache || !blockCache_buckets) {
+        debugPrintf("[BlockCache] Can't allocate %u entries, disabled.\n", capacity);
+        free(blockCache);
+        free(blockCache_buckets);
+        blockCache = NULL;
+        return;
+    }
+
+    // Block buffers are allocated as they're first needed, so a cache that
+    // never fills up doesn't take all of its memory.
+    blockCache_capacity = capacity;
+    blockCache_unused = capacity;
+    blockCache_bucket_mask = buckets - 1;
+    blockCache_stats.capacity = capacity;
+    debugPrintf("[BlockCache] %i MiB, %u blocks.\n", mb, capacity);
+}
+
+static uint32_t hash_path(const char* path) {
+    uint32_t h = 2166136261u;
+    while (*path) {
+        h ^= (uint8_t)*path++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t bucket_of(uint32_t file, uint32_t block) {
+    return (file * 2654435761u ^ block * 40503u) & blockCache_bucket_mask;
+}
+
+// The functions below must be called with blockCache_mutex held.
+
+static BlockCacheEntry* lookup_locked(uint32_t file, uint32_t block) {
+    BlockCacheEntry* e = blockCache_buckets[bucket_of(file, block)];
+    while (e && (e->file != file || e->block != block)) e = e->hash_next;
+    return e;
+}
+
+static void lru_unlink_locked(BlockCacheEntry* e) {
+    if (e->prev) e->prev->next = e->next;
+    else blockCache_lru_head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else blockCache_lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void lru_push_locked(BlockCacheEntry* e) {
+    e->prev = NULL;
+    e->next = blockCache_lru_head;
+    if (blockCache_lru_head) blockCache_lru_head->prev = e;
+    blockCache_lru_head = e;
+    if (!blockCache_lru_tail) blockCache_lru_tail = e;
+}
+
+static void unhash_locked(BlockCacheEntry* e) {
+    BlockCacheEntry** p = &blockCache_buckets[bucket_of(e->file, e->block)];
+    while (*p != e) p = &(*p)->hash_next;
+    *p = e->hash_next;
+    e->hash_next = NULL;
+}
+
+static void count_lookup_locked(int hit) {
+    if (hit) blockCache_stats.hits++;
+    else blockCache_stats.misses++;
+
+    uint32_t total = blockCache_stats.hits + blockCache_stats.misses;
+    if (total % BLOCK_CACHE_REPORT_EVERY == 0) {
+        debugPrintf("[BlockCache] %u hits, %u misses (%u%% hit), %u evictions, %u/%u blocks.\n",
+                    blockCache_stats.hits, blockCache_stats.misses,
+                    (uint32_t)((uint64_t)blockCache_stats.hits * 100 / total),
+                    blockCache_stats.evictions, blockCache_stats.blocks, blockCache_stats.capacity);
+    }
+}
+
+static void insert_locked(uint32_t file, uint32_t block, const uint8_t* data, int len) {
+    if (lookup_locked(file, block)) return; // another thread was faster
+
+    BlockCacheEntry* e;
+    if (blockCache_unused > 0) {
+        e = &blockCache[blockCache_capacity - blockCache_unused];
+        e->data = malloc(BLOCK_CACHE_BLOCK_SIZE);
+        if (!e->data) return;
+        blockCache_unused--;
+        blockCache_stats.blocks++;
+    } else {
+        e = blockCache_lru_tail;
+        lru_unlink_locked(e);
+        if (e->file) {
+            unhash_locked(e);
+            blockCache_stats.evictions++;
+        }
+    }
+
+    e->file = file;
+    e->block = block;
+    e->len = len;
+    memcpy(e->data, data, len);
+
+    BlockCacheEntry** bucket = &blockCache_buckets[bucket_of(file, block)];
+    e->hash_next = *bucket;
+    *bucket = e;
+    lru_push_locked(e);
+}
+
+static void files_flush_locked() {
+    for (int i = 0; i < BLOCK_CACHE_FILES; i++) {
+        free(blockCache_files[i].path);
+    }
+    memset(blockCache_files, 0, sizeof(blockCache_files));
+    blockCache_files_used = 0;
+}
+
+static BlockCacheFile* file_lookup_locked(const char* path, uint32_t hash, int create) {
+    if (create && blockCache_files_used >= BLOCK_CACHE_FILES / 4 * 3) {
+        files_flush_locked();
+    }
+
+    uint32_t i = hash & (BLOCK_CACHE_FILES - 1);
+    while (blockCache_files[i].path) {
+        if (blockCache_files[i].hash == hash && strcmp(blockCache_files[i].path, path) == 0) {
+            return &blockCache_files[i];
+        }
+        i = (i + 1) & (BLOCK_CACHE_FILES - 1);
+    }
+
+    if (!create) return NULL;
+
+    blockCache_files[i].path = strdup(path);
+    blockCache_files[i].hash = hash;
+    blockCache_files[i].id = 0;
+    blockCache_files_used++;
+    return &blockCache_files[i];
+}
+
+static BlockCacheFd* get(int fd) {
+    if (fd < 0 || fd >= BLOCK_CACHE_FDS_MAX || !blockCache_fds[fd].used) return NULL;
+    return &blockCache_fds[fd];
+}
+
+void block_cache_open(int fd, const char* path) {
+    if (fd < 0 || fd >= BLOCK_CACHE_FDS_MAX) return;
+
+    pthread_once(&blockCache_once, init_once);
+    if (!blockCache) return;
+
+    // Usually answered from the metadata cache, without touching the card.
+    struct stat st;
+    if (meta_cache_stat(path, &st) != 0 && fstat(fd, &st) != 0) return;
+    if (!S_ISREG(st.st_mode)) return;
+
+    pthread_mutex_lock(&blockCache_mutex);
+    BlockCacheFile* file = file_lookup_locked(path, hash_path(path), 1);
+    if (!file->id || file->size != st.st_size || file->mtime != st.st_mtime) {
+        file->id = blockCache_next_id++;
+        file->size = st.st_size;
+        file->mtime = st.st_mtime;
+    }
+
+    BlockCacheFd* f = &blockCache_fds[fd];
+    if (!f->used) {
+        f->used = 1;
+        f->file = file->id;
+        f->size = file->size;
+        f->pos = 0;
+        f->fd_pos = 0;
+        pthread_mutex_init(&f->io_mutex, NULL);
+    }
+    pthread_mutex_unlock(&blockCache_mutex);
+}
+
+int block_cache_is_tracked(int fd) {
+    return fd >= 0 && fd < BLOCK_CACHE_FDS_MAX && blockCache_fds[fd].used;
+}
+
+// Reads `len` bytes at `off` from the card, fewer only at the end of the file.
+static int read_card(BlockCacheFd* f, int fd, uint8_t* buf, int len, int64_t off) {
+    int total = 0;
+
+    pthread_mutex_lock(&f->io_mutex);
+    if (f->fd_pos != off) {
+        if (lseek(fd, (off_t)off, SEEK_SET) < 0) {
+            f->fd_pos = -1;
+            pthread_mutex_unlock(&f->io_mutex);
+            return -1;
+        }
+        f->fd_pos = off;
+    }
+
+    while (total < len) {
+        int n = read(fd, buf + total, len - total);
+        if (n < 0) {
+            f->fd_pos = -1;
+            if (total == 0) total = -1;
+            break;
+        }
+        if (n == 0) break;
+        f->fd_pos += n;
+        total += n;
+    }
+    pthread_mutex_unlock(&f->io_mutex);
+
+    return total;
+}
+
+int block_cache_pread(int fd, void* buf, int len, int64_t off) {
+    uint8_t* dst = buf;
+    int total = 0;
+
+    pthread_mutex_lock(&blockCache_mutex);
+    BlockCacheFd* f = get(fd);
+    if (!f) {
+        pthread_mutex_unlock(&blockCache_mutex);
+        errno = EBADF;
+        return -1;
+    }
+    uint32_t file = f->file;
+    int64_t size = f->size;
+    pthread_mutex_unlock(&blockCache_mutex);
+
+    if (off < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (off >= size || len <= 0) return 0;
+    if (len > size - off) len = (int)(size - off);
+
+    while (len > 0) {
+        uint32_t block = (uint32_t)(off / BLOCK_CACHE_BLOCK_SIZE);
+        int in = (int)(off % BLOCK_CACHE_BLOCK_SIZE);
+
+        pthread_mutex_lock(&blockCache_mutex);
+        BlockCacheEntry* e = lookup_locked(file, block);
+        if (e) {
+            int n = e->len - in;
+            if (n > len) n = len;
+            if (n > 0) memcpy(dst, e->data + in, n);
+
+            lru_unlink_locked(e);
+            lru_push_locked(e);
+            count_lookup_locked(1);
+            blockCache_stats.bytes_hit += (n > 0) ? n : 0;
+            pthread_mutex_unlock(&blockCache_mutex);
+
+            if (n <= 0) break;
+            dst += n;
+            off += n;
+            total += n;
+            len -= n;
+            continue;
+        }
+
+        // Read the missing blocks in one go, up to the next cached one.
+        uint32_t last = (uint32_t)((off + len - 1) / BLOCK_CACHE_BLOCK_SIZE);
+        uint32_t run = 1;
+        while (run < BLOCK_CACHE_MAX_RUN && block + run <= last && !lookup_locked(file, block + run)) {
+            run++;
+        }
+        for (uint32_t i = 0; i < run; i++) count_lookup_locked(0);
+        pthread_mutex_unlock(&blockCache_mutex);
+
+        int64_t start = (int64_t)block * BLOCK_CACHE_BLOCK_SIZE;
+        int want = (int)run * BLOCK_CACHE_BLOCK_SIZE;
+        if (want > size - start) want = (int)(size - start);
+
+        uint8_t* scratch = malloc(want);
+        int n = scratch ? read_card(f, fd, scratch, want, start) : -1;
+        if (n <= 0) {
+            free(scratch);
+            if (n < 0 && total == 0) total = -1;
+            break;
+        }
+
+        pthread_mutex_lock(&blockCache_mutex);
+        blockCache_stats.bytes_read += n;
+        for (uint32_t i = 0; i < run && (int)(i * BLOCK_CACHE_BLOCK_SIZE) < n; i++) {
+            int block_len = n - (int)(i * BLOCK_CACHE_BLOCK_SIZE);
+            if (block_len > BLOCK_CACHE_BLOCK_SIZE) block_len = BLOCK_CACHE_BLOCK_SIZE;
+            insert_locked(file, block + i, scratch + i * BLOCK_CACHE_BLOCK_SIZE, block_len);
+        }
+        pthread_mutex_unlock(&blockCache_mutex);
+
+        int c = n - in;
+        if (c > len) c = len;
+        if (c > 0) memcpy(dst, scratch + in, c);
+        free(scratch);
+
+        if (c <= 0) break;
+        dst += c;
+        off += c;
+        total += c;
+        len -= c;
+        if (n < want) break; // the file is shorter than it was
+    }
+
+    return total;
+}
+
+int block_cache_read(int fd, void* buf, int len) {
+    pthread_mutex_lock(&blockCache_mutex);
+    BlockCacheFd* f = get(fd);
+    int64_t pos = f ? f->pos : 0;
+    pthread_mutex_unlock(&blockCache_mutex);
+
+    if (!f) {
+        errno = EBADF;
+        return -1;
+    }
+
+    int n = block_cache_pread(fd, buf, len, pos);
+    if (n > 0) {
+        pthread_mutex_lock(&blockCache_mutex);
+        f->pos = pos + n;
+        pthread_mutex_unlock(&blockCache_mutex);
+    }
+    return n;
+}
+
+int64_t block_cache_lseek(int fd, int64_t offset, int whence) {
+    pthread_mutex_lock(&blockCache_mutex);
+    BlockCacheFd* f = get(fd);
+    if (!f) {
+        pthread_mutex_unlock(&blockCache_mutex);
+        errno = EBADF;
+        return -1;
+    }
+
+    int64_t pos;
+    if (whence == SEEK_SET) pos = offset;
+    else if (whence == SEEK_CUR) pos = f->pos + offset;
+    else if (whence == SEEK_END) pos = f->size + offset;
+    else pos = -1;
+
+    if (pos < 0) {
+        pthread_mutex_unlock(&blockCache_mutex);
+        errno = EINVAL;
+        return -1;
+    }
+
+    f->pos = pos;
+    pthread_mutex_unlock(&blockCache_mutex);
+    return pos;
+}
+
+void block_cache_close(int fd) {
+    pthread_mutex_lock(&blockCache_mutex);
+    BlockCacheFd* f = get(fd);
+    if (f) {
+        f->used = 0;
+        pthread_mutex_destroy(&f->io_mutex);
+    }
+    pthread_mutex_unlock(&blockCache_mutex);
+}
+
+typedef struct {
+    char* path;
+    int64_t off;
+    int64_t len;
+} BlockCachePrefetch;
+
+int64_t block_cache_warm(const char* path, int64_t off, int64_t len) {
+    pthread_once(&blockCache_once, init_once);
+    if (!blockCache || off < 0) return -1;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    block_cache_open(fd, path);
+
+    int64_t done = -1;
+    int chunk = BLOCK_CACHE_MAX_RUN * BLOCK_CACHE_BLOCK_SIZE;
+    uint8_t* buf = block_cache_is_tracked(fd) ? malloc(chunk) : NULL;
+    if (buf) {
+        done = 0;
+        while (len < 0 || done < len) {
+            int want = (len < 0 || len - done > chunk) ? chunk : (int)(len - done);
+            int n = block_cache_pread(fd, buf, want, off + done);
+            if (n <= 0) break;
+            done += n;
+        }
+        free(buf);
+    }
+
+    block_cache_close(fd);
+    close(fd);
+    return done;
+}
+
+static void prefetch_job(void* arg) {
+    BlockCachePrefetch* p = arg;
+    block_cache_warm(p->path, p->off, p->len);
+    free(p->path);
+    free(p);
+}
+
+int block_cache_prefetch(const char* path, int64_t off, int64_t len) {
+    pthread_once(&blockCache_once, init_once);
+    if (!blockCache || off < 0) return -1;
+
+    BlockCachePrefetch* p = malloc(sizeof(BlockCachePrefetch));
+    if (!p) return -1;
+    p->path = strdup(path);
+    p->off = off;
+    p->len = len;
+
+    if (!p->path || io_pool_submit(IO_CLASS_PREFETCH, prefetch_job, p) != 0) {
+        free(p->path);
+        free(p);
+        return -1;
+    }
+    return 0;
+}
+
+void block_cache_invalidate(const char* path) {
+    if (!path || !blockCache) return;
+
+    pthread_mutex_lock(&blockCache_mutex);
+    BlockCacheFile* file = file_lookup_locked(path, hash_path(path), 0);
+    if (file && file->id) {
+        file->id = 0;
+        blockCache_stats.invalidations++;
+    }
+    pthread_mutex_unlock(&blockCache_mutex);
+}
+
+void block_cache_get_stats(BlockCacheStats* stats) {
+    pthread_mutex_lock(&blockCache_mutex);
+    *stats = blockCache_stats;
+    pthread_mutex_unlock(&blockCache_mutex);
+}
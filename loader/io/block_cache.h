@@ -0,0 +1,82 @@
+/*
+ * io/block_cache.h
+ *
+ * LRU cache of file blocks, keyed by file identity and block number. Levels
+ * reload the same files on every checkpoint, death and menu visit; with the
+ * cache, only the first load of a block has to come from the memory card.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_BLOCK_CACHE_H
+#define SOLOADER_BLOCK_CACHE_H
+
+#include <stdint.h>
+
+#define BLOCK_CACHE_BLOCK_SIZE (32 * 1024)
+
+// Cache size used when config.txt doesn't set blockCacheSize (in MiB).
+#define BLOCK_CACHE_SIZE_DEFAULT_MB 8
+
+// Fds above this aren't tracked and are read directly.
+#define BLOCK_CACHE_FDS_MAX 64
+
+// Paths whose identity is remembered; the table is flushed when 3/4 full.
+#define BLOCK_CACHE_FILES 1024
+
+// Consecutive missing blocks are read from the card in one request, up to
+// this many.
+#define BLOCK_CACHE_MAX_RUN 16
+
+// In DEBUG builds, the stats are logged every this many block lookups.
+#define BLOCK_CACHE_REPORT_EVERY 4096
+
+typedef struct {
+    uint32_t hits;        // block lookups served from memory
+    uint32_t misses;      // block lookups that went to the card
+    uint32_t evictions;
+    uint32_t invalidations;
+    uint32_t blocks;      // blocks in the cache now
+    uint32_t capacity;    // blocks it can hold
+    uint64_t bytes_hit;
+    uint64_t bytes_read;  // bytes read from the card
+} BlockCacheStats;
+
+/*
+ * Starts tracking `fd`, a file opened read-only from `path`. From then on,
+ * the fd's position is kept here: it must be read, seeked and closed only
+ * through the functions below.
+ */
+void block_cache_open(int fd, const char* path);
+
+int block_cache_is_tracked(int fd);
+int block_cache_read(int fd, void* buf, int len);
+int64_t block_cache_lseek(int fd, int64_t offset, int whence);
+
+// Reads at `off` without moving the fd's position.
+int block_cache_pread(int fd, void* buf, int len, int64_t off);
+
+// Stops tracking `fd`. Doesn't close the fd itself.
+void block_cache_close(int fd);
+
+/*
+ * Has `len` bytes of `path` from `off` read into the cache in the background,
+ * as an IO_CLASS_PREFETCH job; `len` < 0 means up to the end of the file.
+ * Returns 0 if the job was queued.
+ */
+int block_cache_prefetch(const char* path, int64_t off, int64_t len);
+
+// The same, right away on the calling thread. Returns the bytes now in the
+// cache, or -1 if the file can't be read or there's no cache.
+int64_t block_cache_warm(const char* path, int64_t off, int64_t len);
+
+// Forgets the cached contents of `path`, which is about to be written,
+// removed or replaced. Fds opened afterwards read it afresh.
+void block_cache_invalidate(const char* path);
+
+void block_cache_get_stats(BlockCacheStats* stats);
+
+#endif // SOLOADER_BLOCK_CACHE_H
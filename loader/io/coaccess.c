@@ -0,0 +1,345 @@
+/*
+ * io/coaccess.c
+ *
+ * Learned prefetching for level loads. Which files follow which within a
+ * short window after being opened is counted across sessions and kept on
+ * disk; when a file opens again, the files that reliably followed it are
+ * prefetched into the block cache before the game asks for them.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "coaccess.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <psp2/kernel/processmgr.h>
+
+#include "io/block_cache.h"
+#include "io/io_pool.h"
+#include "utils/utils.h"
+
+typedef struct {
+    uint16_t to;     // slot of the successor
+    uint32_t count;
+    uint32_t last;   // serial of the last open of ours it was counted for
+} CoaccessSuccessor;
+
+typedef struct {
+    char* path;      // NULL if the slot is free
+    uint32_t hash;
+    uint32_t opens;
+    uint32_t prefetched_at; // when it was last prefetched, 0 if never
+    int successors_count;
+    CoaccessSuccessor successors[COACCESS_EDGES_PER_NODE];
+} CoaccessNodeSlot;
+
+typedef struct {
+    int used;
+    uint16_t node;
+    uint32_t serial;
+    uint32_t time_us;
+} CoaccessRecent;
+
+static CoaccessNodeSlot coaccess_nodes[COACCESS_NODES];
+static uint32_t coaccess_nodesUsed = 0;
+
+static CoaccessRecent coaccess_recent[COACCESS_RECENT];
+static int coaccess_recentNext = 0;
+static uint32_t coaccess_serial = 0;
+
+static int coaccess_updates = 0;
+static int coaccess_saving = 0;
+
+static pthread_mutex_t coaccess_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t coaccess_once = PTHREAD_ONCE_INIT;
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+} CoaccessImage;
+
+static uint32_t hash_path(const char* path) {
+    uint32_t h = 2166136261u;
+    for (const char* c = path; *c; c++) h = (h ^ (uint8_t)*c) * 16777619u;
+    return h;
+}
+
+// Must be called with coaccess_mutex held. Returns the slot, or -1.
+static int node_get_locked(const char* path, int create) {
+    uint32_t h = hash_path(path);
+    for (uint32_t i = h % COACCESS_NODES;; i = (i + 1) % COACCESS_NODES) {
+        CoaccessNodeSlot* n = &coaccess_nodes[i];
+        if (!n->path) {
+            if (!create || coaccess_nodesUsed >= COACCESS_NODES * 3 / 4) return -1;
+            n->path = strdup(path);
+            if (!n->path) return -1;
+            n->hash = h;
+            coaccess_nodesUsed++;
+            return (int)i;
+        }
+        if (n->hash == h && strcmp(n->path, path) == 0) return (int)i;
+    }
+}
+
+/*
+ * Must be called with coaccess_mutex held. When all the successors are
+ * taken, the least frequent one makes room only once it's down to a count
+ * of 1; until then, it's decremented and NULL is returned, so one-off
+ * successors don't push out regular ones.
+ */
+static CoaccessSuccessor* successor_get_locked(CoaccessNodeSlot* n, int to) {
+    CoaccessSuccessor* least = NULL;
+    for (int i = 0; i < n->successors_count; i++) {
+        CoaccessSuccessor* s = &n->successors[i];
+        if (s->to == to) return s;
+        if (!least || s->count < least->count) least = s;
+    }
+
+    CoaccessSuccessor* s;
+    if (n->successors_count < COACCESS_EDGES_PER_NODE) {
+        s = &n->successors[n->successors_count++];
+    } else if (least->count <= 1) {
+        s = least;
+    } else {
+        least->count--;
+        return NULL;
+    }
+
+    s->to = (uint16_t)to;
+    s->count = 0;
+    s->last = 0;
+    return s;
+}
+
+// Must be called with coaccess_mutex held.
+static void age_locked(CoaccessNodeSlot* n) {
+    n->opens /= 2;
+    int kept = 0;
+    for (int i = 0; i < n->successors_count; i++) {
+        CoaccessSuccessor s = n->successors[i];
+        s.count /= 2;
+        if (s.count > 0) n->successors[kept++] = s;
+    }
+    n->successors_count = kept;
+}
+
+static int load_image(const uint8_t* data, size_t size) {
+    if (size < sizeof(CoaccessHeader)) return 0;
+    const CoaccessHeader* h = (const CoaccessHeader*)data;
+    if (h->magic != COACCESS_MAGIC || h->version != COACCESS_VERSION) return 0;
+
+    size_t expected = sizeof(CoaccessHeader) + (size_t)h->nodes_count * sizeof(CoaccessNode)
+                      + (size_t)h->edges_count * sizeof(CoaccessEdge) + h->strings_size;
+    if (expected != size || h->nodes_count > COACCESS_NODES || h->strings_size == 0) return 0;
+
+    const CoaccessNode* nodes = (const CoaccessNode*)(h + 1);
+    const CoaccessEdge* edges = (const CoaccessEdge*)(nodes + h->nodes_count);
+    const char* strings = (const char*)(edges + h->edges_count);
+    if (strings[h->strings_size - 1] != '\0') return 0;
+
+    int* slots = malloc(sizeof(int) * (h->nodes_count ? h->nodes_count : 1));
+    if (!slots) return 0;
+
+    for (uint32_t i = 0; i < h->nodes_count; i++) {
+        slots[i] = -1;
+        if (nodes[i].path >= h->strings_size) continue;
+        slots[i] = node_get_locked(strings + nodes[i].path, 1);
+        if (slots[i] >= 0) coaccess_nodes[slots[i]].opens = nodes[i].opens;
+    }
+
+    for (uint32_t i = 0; i < h->edges_count; i++) {
+        const CoaccessEdge* e = &edges[i];
+        if (e->from >= h->nodes_count || e->to >= h->nodes_count) continue;
+        if (slots[e->from] < 0 || slots[e->to] < 0) continue;
+
+        CoaccessSuccessor* s = successor_get_locked(&coaccess_nodes[slots[e->from]], slots[e->to]);
+        if (s) s->count = e->count;
+    }
+
+    free(slots);
+    return 1;
+}
+
+static void load() {
+    FILE* f = fopen(COACCESS_PATH, "rb");
+    if (!f) return;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t* data = (size > 0) ? malloc(size) : NULL;
+    int ok = data && fread(data, 1, size, f) == (size_t)size;
+    fclose(f);
+
+    pthread_mutex_lock(&coaccess_mutex);
+    if (ok && load_image(data, size)) {
+        debugPrintf("[Coaccess] Loaded %u files.\n", coaccess_nodesUsed);
+    } else {
+        debugPrintf("[Coaccess] Can't load %s, starting afresh.\n", COACCESS_PATH);
+    }
+    pthread_mutex_unlock(&coaccess_mutex);
+
+    free(data);
+}
+
+// Must be called with coaccess_mutex held. Returns NULL if out of memory.
+static CoaccessImage* serialize_locked() {
+    uint32_t nodes_count = 0, edges_count = 0, strings_size = 0;
+    uint16_t index[COACCESS_NODES];
+
+    for (int i = 0; i < COACCESS_NODES; i++) {
+        CoaccessNodeSlot* n = &coaccess_nodes[i];
+        if (!n->path) continue;
+        index[i] = (uint16_t)nodes_count++;
+        edges_count += n->successors_count;
+        strings_size += strlen(n->path) + 1;
+    }
+
+    size_t size = sizeof(CoaccessHeader) + nodes_count * sizeof(CoaccessNode)
+                  + edges_count * sizeof(CoaccessEdge) + strings_size;
+    CoaccessImage* img = malloc(sizeof(CoaccessImage));
+    uint8_t* data = malloc(size);
+    if (!img || !data) {
+        free(img);
+        free(data);
+        return NULL;
+    }
+
+    CoaccessHeader* h = (CoaccessHeader*)data;
+    h->magic = COACCESS_MAGIC;
+    h->version = COACCESS_VERSION;
+    h->nodes_count = nodes_count;
+    h->edges_count = edges_count;
+    h->strings_size = strings_size;
+
+    CoaccessNode* nodes = (CoaccessNode*)(h + 1);
+    CoaccessEdge* edges = (CoaccessEdge*)(nodes + nodes_count);
+    char* strings = (char*)(edges + edges_count);
+    uint32_t str = 0;
+
+    for (int i = 0; i < COACCESS_NODES; i++) {
+        CoaccessNodeSlot* n = &coaccess_nodes[i];
+        if (!n->path) continue;
+
+        nodes->path = str;
+        nodes->opens = n->opens;
+        nodes++;
+
+        size_t len = strlen(n->path) + 1;
+        memcpy(strings + str, n->path, len);
+        str += len;
+
+        for (int j = 0; j < n->successors_count; j++) {
+            edges->from = index[i];
+            edges->to = index[n->successors[j].to];
+            edges->count = n->successors[j].count;
+            edges++;
+        }
+    }
+
+    img->data = data;
+    img->size = size;
+    return img;
+}
+
+static void save_job(void* arg) {
+    CoaccessImage* img = arg;
+    const char* tmp = COACCESS_PATH ".tmp";
+
+    FILE* f = fopen(tmp, "wb");
+    if (!f) {
+        debugPrintf("[Coaccess] Can't open %s for writing.\n", tmp);
+    } else {
+        size_t written = fwrite(img->data, 1, img->size, f);
+        fclose(f);
+
+        if (written == img->size) {
+            remove(COACCESS_PATH);
+            rename(tmp, COACCESS_PATH);
+        } else {
+            remove(tmp);
+        }
+    }
+
+    free(img->data);
+    free(img);
+
+    pthread_mutex_lock(&coaccess_mutex);
+    coaccess_saving = 0;
+    pthread_mutex_unlock(&coaccess_mutex);
+}
+
+void coaccess_note_open(const char* path) {
+    pthread_once(&coaccess_once, load);
+    uint32_t now = sceKernelGetProcessTimeLow();
+
+    const char* prefetch[COACCESS_EDGES_PER_NODE];
+    int prefetch_count = 0;
+    CoaccessImage* img = NULL;
+
+    pthread_mutex_lock(&coaccess_mutex);
+    int slot = node_get_locked(path, 1);
+    if (slot < 0) {
+        pthread_mutex_unlock(&coaccess_mutex);
+        return;
+    }
+    CoaccessNodeSlot* n = &coaccess_nodes[slot];
+
+    // This open follows the recent opens of other files; each of them
+    // counts it once, however many times it's opened.
+    for (int i = 0; i < COACCESS_RECENT; i++) {
+        CoaccessRecent* r = &coaccess_recent[i];
+        if (!r->used || r->node == slot || now - r->time_us > COACCESS_WINDOW_MS * 1000) continue;
+
+        CoaccessSuccessor* s = successor_get_locked(&coaccess_nodes[r->node], slot);
+        if (s && s->last != r->serial) {
+            s->last = r->serial;
+            s->count++;
+            coaccess_updates++;
+        }
+    }
+
+    // What followed this file before, if it did reliably enough.
+    for (int i = 0; i < n->successors_count; i++) {
+        CoaccessSuccessor* s = &n->successors[i];
+        if (s->count < COACCESS_MIN_COUNT || s->count * 100 < n->opens * COACCESS_MIN_PERCENT) continue;
+
+        CoaccessNodeSlot* to = &coaccess_nodes[s->to];
+        if (to->prefetched_at && now - to->prefetched_at < COACCESS_WINDOW_MS * 1000) continue;
+        to->prefetched_at = now ? now : 1;
+        prefetch[prefetch_count++] = to->path;
+    }
+
+    if (++n->opens >= COACCESS_OPENS_MAX) age_locked(n);
+    coaccess_updates++;
+
+    CoaccessRecent* r = &coaccess_recent[coaccess_recentNext];
+    coaccess_recentNext = (coaccess_recentNext + 1) % COACCESS_RECENT;
+    r->used = 1;
+    r->node = (uint16_t)slot;
+    r->serial = ++coaccess_serial;
+    r->time_us = now;
+
+    if (coaccess_updates >= COACCESS_SAVE_EVERY && !coaccess_saving) {
+        img = serialize_locked();
+        if (img) {
+            coaccess_saving = 1;
+            coaccess_updates = 0;
+        }
+    }
+    pthread_mutex_unlock(&coaccess_mutex);
+
+    // Paths of nodes are never freed, they can be used unlocked.
+    for (int i = 0; i < prefetch_count; i++) {
+        block_cache_prefetch(prefetch[i], 0, COACCESS_PREFETCH_BYTES);
+    }
+
+    if (img && io_pool_submit(IO_CLASS_SAVE, save_job, img) != 0) save_job(img);
+}
@@ -0,0 +1,87 @@
+/*
+ * io/coaccess.h
+ *
+ * Learned prefetching for level loads. Which files follow which within a
+ * short window after being opened is counted across sessions and kept on
+ * disk; when a file opens again, the files that reliably followed it are
+ * prefetched into the block cache before the game asks for them.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_COACCESS_H
+#define SOLOADER_COACCESS_H
+
+#include <stdint.h>
+
+#define COACCESS_PATH DATA_PATH "coaccess.bin"
+
+#define COACCESS_MAGIC 0x47414F43 // "COAG"
+#define COACCESS_VERSION 1
+
+/*
+ * File layout, native byte order:
+ *
+ *   CoaccessHeader
+ *   CoaccessNode  nodes[nodes_count]
+ *   CoaccessEdge  edges[edges_count]
+ *   char          strings[strings_size]  NUL-terminated paths
+ */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nodes_count;
+    uint32_t edges_count;
+    uint32_t strings_size;
+} CoaccessHeader;
+
+typedef struct {
+    uint32_t path;  // offset into strings
+    uint32_t opens;
+} CoaccessNode;
+
+typedef struct {
+    uint16_t from;  // indices into nodes
+    uint16_t to;
+    uint32_t count; // opens of `from` that `to` followed
+} CoaccessEdge;
+
+// Hash table slots for files; no new files are learned once it's 3/4 full.
+#define COACCESS_NODES 2048
+
+// Successors kept per file; a new one replaces the least frequent.
+#define COACCESS_EDGES_PER_NODE 16
+
+// Opens within this long after a file's open count as following it.
+#define COACCESS_WINDOW_MS 2000
+
+// Recent opens kept to attribute new ones to.
+#define COACCESS_RECENT 32
+
+// A successor is prefetched once it followed at least this many opens, and
+// at least this share of them.
+#define COACCESS_MIN_COUNT 2
+#define COACCESS_MIN_PERCENT 60
+
+// Prefetched from the start of each successor, at most.
+#define COACCESS_PREFETCH_BYTES (256 * 1024)
+
+// Counts of a file are halved once it's been opened this many times, so
+// the graph keeps up with the game.
+#define COACCESS_OPENS_MAX 64
+
+// The graph is saved after this many updates.
+#define COACCESS_SAVE_EVERY 64
+
+/*
+ * Records that the game opened loose file `path` (translated) for reading,
+ * and prefetches the files that usually follow it. Loads the graph on the
+ * first call.
+ */
+void coaccess_note_open(const char* path);
+
+#endif // SOLOADER_COACCESS_H
@@ -0,0 +1,211 @@
+/*
+ * io/io_pool.c
+ *
+ * Pool of worker threads for background file I/O, with priority classes.
+ * Workers take the most urgent job queued, and don't start prefetch jobs
+ * while a game thread is waiting for the card. So that a steady stream of
+ * urgent jobs can't hold the others back forever, a class passed over
+ * IO_POOL_MAX_PASSED times in a row gets the next pick.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "io_pool.h"
+
+#include <pthread.h>
+#include <psp2/kernel/processmgr.h>
+
+#include "utils/utils.h"
+
+typedef struct {
+    IoJob job;
+    void* arg;
+    uint32_t queued_at;
+} IoPoolJob;
+
+typedef struct {
+    IoPoolJob jobs[IO_POOL_QUEUE_SIZE];
+    int head;
+    int len; // changed with ioPool_mutex held, but also read without it
+} IoPoolQueue;
+
+static IoPoolQueue ioPool_queues[IO_CLASS_COUNT];
+static int ioPool_passed[IO_CLASS_COUNT]; // picks since the class was last served
+static IoClassStats ioPool_stats[IO_CLASS_COUNT]; // IO_CLASS_FOREGROUND's are atomic
+static uint32_t ioPool_jobs_done = 0; // background jobs, for the reports
+static int ioPool_foreground = 0; // game threads in foreground I/O, atomic
+static int ioPool_workers = 0;
+
+static pthread_mutex_t ioPool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ioPool_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t ioPool_once = PTHREAD_ONCE_INIT;
+
+static const char* class_names[IO_CLASS_COUNT] = {
+    "foreground", "streaming", "save", "prefetch", "idle",
+};
+
+// Copies the stats of `cls`. Must be called with ioPool_mutex held, which
+// doesn't cover the foreground ones.
+static void snapshot_locked(int cls, IoClassStats* out) {
+    IoClassStats* s = &ioPool_stats[cls];
+    if (cls != IO_CLASS_FOREGROUND) {
+        *out = *s;
+        return;
+    }
+
+    out->submitted = __atomic_load_n(&s->submitted, __ATOMIC_RELAXED);
+    out->rejected = 0;
+    out->completed = __atomic_load_n(&s->completed, __ATOMIC_RELAXED);
+    out->wait_us = 0;
+    out->run_us = __atomic_load_n(&s->run_us, __ATOMIC_RELAXED);
+    out->max_wait_us = 0;
+    out->max_run_us = __atomic_load_n(&s->max_run_us, __ATOMIC_RELAXED);
+}
+
+// Must be called with ioPool_mutex held.
+static void count_locked(IoClass cls, uint32_t wait_us, uint32_t run_us) {
+    IoClassStats* s = &ioPool_stats[cls];
+    s->completed++;
+    s->wait_us += wait_us;
+    s->run_us += run_us;
+    if (wait_us > s->max_wait_us) s->max_wait_us = wait_us;
+    if (run_us > s->max_run_us) s->max_run_us = run_us;
+
+    if (cls != IO_CLASS_FOREGROUND && ++ioPool_jobs_done % IO_POOL_REPORT_EVERY == 0) {
+        for (int i = 0; i < IO_CLASS_COUNT; i++) {
+            IoClassStats c;
+            snapshot_locked(i, &c);
+            if (!c.completed) continue;
+            debugPrintf("[IoPool] %s: %u jobs, %u rejected, wait %llu us avg / %u max, run %llu us avg / %u max.\n",
+                        class_names[i], c.completed, c.rejected, c.wait_us / c.completed, c.max_wait_us,
+                        c.run_us / c.completed, c.max_run_us);
+        }
+    }
+}
+
+// Must be called with ioPool_mutex held.
+static int can_take_locked(int cls) {
+    if (ioPool_queues[cls].len == 0) return 0;
+    return cls != IO_CLASS_PREFETCH || __atomic_load_n(&ioPool_foreground, __ATOMIC_ACQUIRE) == 0;
+}
+
+// Must be called with ioPool_mutex held. Returns the class of the job taken,
+// or -1 if there's nothing to do right now.
+static int take_locked(IoPoolJob* out) {
+    // The most urgent class, unless a less urgent one has waited too long.
+    int pick = -1;
+    for (int cls = 0; cls < IO_CLASS_COUNT; cls++) {
+        if (!can_take_locked(cls)) continue;
+        if (pick < 0 || ioPool_passed[cls] >= IO_POOL_MAX_PASSED) {
+            pick = cls;
+            if (ioPool_passed[cls] >= IO_POOL_MAX_PASSED) break;
+        }
+    }
+    if (pick < 0) return -1;
+
+    for (int cls = 0; cls < IO_CLASS_COUNT; cls++) {
+        if (cls != pick && can_take_locked(cls)) ioPool_passed[cls]++;
+    }
+    ioPool_passed[pick] = 0;
+
+    IoPoolQueue* q = &ioPool_queues[pick];
+    *out = q->jobs[q->head];
+    q->head = (q->head + 1) % IO_POOL_QUEUE_SIZE;
+    __atomic_sub_fetch(&q->len, 1, __ATOMIC_RELAXED);
+    return pick;
+}
+
+static void* worker(__attribute__((unused)) void* arg) {
+    pthread_mutex_lock(&ioPool_mutex);
+    while (1) {
+        IoPoolJob j;
+        int cls;
+        while ((cls = take_locked(&j)) < 0) {
+            pthread_cond_wait(&ioPool_cond, &ioPool_mutex);
+        }
+        pthread_mutex_unlock(&ioPool_mutex);
+
+        uint32_t start = sceKernelGetProcessTimeLow();
+        j.job(j.arg);
+        uint32_t end = sceKernelGetProcessTimeLow();
+
+        pthread_mutex_lock(&ioPool_mutex);
+        count_locked(cls, start - j.queued_at, end - start);
+    }
+    return NULL;
+}
+
+static void start_workers() {
+    for (int i = 0; i < IO_POOL_WORKERS; i++) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, worker, NULL) != 0) {
+            debugPrintf("[IoPool] Can't start worker #%i.\n", i);
+            break;
+        }
+        pthread_detach(t);
+        ioPool_workers++;
+    }
+}
+
+int io_pool_submit(IoClass cls, IoJob job, void* arg) {
+    if (cls < 0 || cls >= IO_CLASS_COUNT) return -1;
+
+    pthread_once(&ioPool_once, start_workers);
+
+    pthread_mutex_lock(&ioPool_mutex);
+    IoPoolQueue* q = &ioPool_queues[cls];
+    if (ioPool_workers == 0 || q->len == IO_POOL_QUEUE_SIZE) {
+        ioPool_stats[cls].rejected++;
+        pthread_mutex_unlock(&ioPool_mutex);
+        return -1;
+    }
+
+    IoPoolJob* j = &q->jobs[(q->head + q->len) % IO_POOL_QUEUE_SIZE];
+    j->job = job;
+    j->arg = arg;
+    j->queued_at = sceKernelGetProcessTimeLow();
+    __atomic_add_fetch(&q->len, 1, __ATOMIC_RELAXED);
+    ioPool_stats[cls].submitted++;
+
+    pthread_cond_signal(&ioPool_cond);
+    pthread_mutex_unlock(&ioPool_mutex);
+    return 0;
+}
+
+uint32_t io_pool_foreground_begin(void) {
+    __atomic_add_fetch(&ioPool_foreground, 1, __ATOMIC_ACQ_REL);
+    __atomic_add_fetch(&ioPool_stats[IO_CLASS_FOREGROUND].submitted, 1, __ATOMIC_RELAXED);
+    return sceKernelGetProcessTimeLow();
+}
+
+void io_pool_foreground_end(uint32_t begin) {
+    uint32_t run_us = sceKernelGetProcessTimeLow() - begin;
+
+    IoClassStats* s = &ioPool_stats[IO_CLASS_FOREGROUND];
+    __atomic_add_fetch(&s->completed, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s->run_us, run_us, __ATOMIC_RELAXED);
+    uint32_t max = __atomic_load_n(&s->max_run_us, __ATOMIC_RELAXED);
+    while (run_us > max && !__atomic_compare_exchange_n(&s->max_run_us, &max, run_us, 1,
+                                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    // Prefetch jobs held back may go now. The broadcast is done under the
+    // mutex so that it can't fall between a worker's check and its wait.
+    if (__atomic_sub_fetch(&ioPool_foreground, 1, __ATOMIC_ACQ_REL) == 0
+        && __atomic_load_n(&ioPool_queues[IO_CLASS_PREFETCH].len, __ATOMIC_RELAXED) > 0) {
+        pthread_mutex_lock(&ioPool_mutex);
+        pthread_cond_broadcast(&ioPool_cond);
+        pthread_mutex_unlock(&ioPool_mutex);
+    }
+}
+
+void io_pool_get_stats(IoClass cls, IoClassStats* stats) {
+    if (cls < 0 || cls >= IO_CLASS_COUNT) return;
+
+    pthread_mutex_lock(&ioPool_mutex);
+    snapshot_locked(cls, stats);
+    pthread_mutex_unlock(&ioPool_mutex);
+}
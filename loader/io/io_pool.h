@@ -0,0 +1,70 @@
+/*
+ * io/io_pool.h
+ *
+ * Pool of worker threads for background file I/O, with priority classes.
+ * Workers take the most urgent job queued, and don't start prefetch jobs
+ * while a game thread is waiting for the card. So that a steady stream of
+ * urgent jobs can't hold the others back forever, a class passed over
+ * IO_POOL_MAX_PASSED times in a row gets the next pick.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_IO_POOL_H
+#define SOLOADER_IO_POOL_H
+
+#include <stdint.h>
+
+// Most urgent first.
+typedef enum {
+    IO_CLASS_FOREGROUND = 0, // a game thread is blocked on it
+    IO_CLASS_STREAMING,      // data the game is about to read, e.g. read-ahead
+    IO_CLASS_SAVE,           // writes that must land, but nobody waits for
+    IO_CLASS_PREFETCH,       // data the game may read at some point
+    IO_CLASS_IDLE,           // work that can wait, e.g. zeroing memory
+    IO_CLASS_COUNT
+} IoClass;
+
+typedef void (*IoJob)(void* arg);
+
+#define IO_POOL_WORKERS 2
+
+// Jobs that can be queued per class.
+#define IO_POOL_QUEUE_SIZE 256
+
+#define IO_POOL_MAX_PASSED 8
+
+// In DEBUG builds, the stats are logged every this many background jobs.
+#define IO_POOL_REPORT_EVERY 1024
+
+typedef struct {
+    uint32_t submitted;
+    uint32_t rejected;  // queue full, or no worker could be started
+    uint32_t completed;
+    uint64_t wait_us;   // total time spent queued
+    uint64_t run_us;    // total time spent running
+    uint32_t max_wait_us;
+    uint32_t max_run_us;
+} IoClassStats;
+
+/*
+ * Queues `job(arg)` to run on a worker. Returns 0 on success, -1 if it
+ * can't be queued; the caller still owns `arg` then.
+ */
+int io_pool_submit(IoClass cls, IoJob job, void* arg);
+
+/*
+ * Foreground I/O runs on the game's own thread, there's no point in handing
+ * it over. Bracketing it with these holds back prefetch jobs meanwhile and
+ * counts it in the IO_CLASS_FOREGROUND stats. Both are lock-free, except
+ * when the end of foreground I/O lets held back prefetch jobs go.
+ */
+uint32_t io_pool_foreground_begin(void);
+void io_pool_foreground_end(uint32_t begin);
+
+void io_pool_get_stats(IoClass cls, IoClassStats* stats);
+
+#endif // SOLOADER_IO_POOL_H
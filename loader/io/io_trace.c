@@ -0,0 +1,262 @@
+/*
+ * io/io_trace.c
+ *
+ * Optional binary trace of the file operations made by the game, meant to
+ * be analyzed on the host with tools/io_trace_report.py. Enabled with the
+ * IO_TRACE CMake option; compiles to nothing otherwise.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "io_trace.h"
+
+#ifdef IO_TRACE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <psp2/kernel/threadmgr.h>
+
+#include "io/io_pool.h"
+#include "utils/utils.h"
+
+typedef struct {
+    char* path;  // NULL if the slot is free
+    uint32_t id;
+} IoTracePath;
+
+typedef struct {
+    int used;
+    int fd;
+    uint32_t path;
+    int64_t pos;
+} IoTraceFd;
+
+static FILE * ioTrace_file = NULL;
+static pthread_mutex_t ioTrace_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Records go into one buffer while the other one is written out by the
+// pool, so traced calls don't wait for the card themselves.
+static uint8_t ioTrace_buffers[2][IO_TRACE_BUFFER_SIZE];
+static int ioTrace_current = 0;
+static size_t ioTrace_used = 0;
+static size_t ioTrace_writeLen = 0;
+static int ioTrace_writing = 0;
+static uint32_t ioTrace_lastFlush = 0;
+static pthread_cond_t ioTrace_written = PTHREAD_COND_INITIALIZER;
+
+// Open addressing, kept at most half full.
+static IoTracePath ioTrace_paths[IO_TRACE_PATHS * 2];
+static uint32_t ioTrace_pathCount = 0;
+
+static IoTraceFd ioTrace_fds[IO_TRACE_FDS];
+
+static void write_job(void* arg) {
+    fwrite(arg, 1, ioTrace_writeLen, ioTrace_file);
+    fflush(ioTrace_file);
+
+    pthread_mutex_lock(&ioTrace_mutex);
+    ioTrace_writing = 0;
+    pthread_cond_broadcast(&ioTrace_written);
+    pthread_mutex_unlock(&ioTrace_mutex);
+}
+
+// Must be called with ioTrace_mutex held.
+static void flush_locked(int sync) {
+    while (ioTrace_writing) pthread_cond_wait(&ioTrace_written, &ioTrace_mutex);
+    if (!ioTrace_used) return;
+
+    uint8_t* buf = ioTrace_buffers[ioTrace_current];
+    ioTrace_writeLen = ioTrace_used;
+    ioTrace_current ^= 1;
+    ioTrace_used = 0;
+    ioTrace_writing = 1;
+    ioTrace_lastFlush = sceKernelGetProcessTimeLow();
+
+    if (sync || io_pool_submit(IO_CLASS_SAVE, write_job, buf) != 0) {
+        fwrite(buf, 1, ioTrace_writeLen, ioTrace_file);
+        fflush(ioTrace_file);
+        ioTrace_writing = 0;
+    }
+}
+
+// Records are never split across buffers; a thread that finds the buffer
+// full may wait for the previous one to be written, and others may put
+// theirs meanwhile.
+static void put(const void * data, size_t size) {
+    while (ioTrace_used + size > IO_TRACE_BUFFER_SIZE) flush_locked(0);
+
+    memcpy(ioTrace_buffers[ioTrace_current] + ioTrace_used, data, size);
+    ioTrace_used += size;
+}
+
+// Must be called with ioTrace_mutex held, once a record is put. Hands the
+// buffer over every IO_TRACE_FLUSH_MS, so that little is lost when the game
+// is killed rather than exits.
+static void end_record_locked() {
+    if (!ioTrace_writing && sceKernelGetProcessTimeLow() - ioTrace_lastFlush >= IO_TRACE_FLUSH_MS * 1000) {
+        flush_locked(0);
+    }
+}
+
+static void make_record(IoTraceRecord* r, IoTraceOp op, uint8_t flags, uint32_t start_us, uint32_t end_us,
+                        uint32_t path, int fd, int64_t offset, int32_t size, int32_t result) {
+    r->op = (uint8_t)op;
+    r->flags = flags;
+    r->reserved = 0;
+    r->thread = (uint32_t)sceKernelGetThreadId();
+    r->time_us = start_us;
+    r->latency_us = end_us - start_us;
+    r->path = path;
+    r->fd = fd;
+    r->offset = offset;
+    r->size = size;
+    r->result = result;
+}
+
+// Must be called with ioTrace_mutex held. Returns 0 once out of ids.
+static uint32_t intern_locked(const char * path) {
+    if (!path) return 0;
+
+    uint32_t h = 2166136261u;
+    for (const char * c = path; *c; c++) h = (h ^ (uint8_t)*c) * 16777619u;
+
+    const uint32_t mask = IO_TRACE_PATHS * 2 - 1;
+    for (uint32_t i = h & mask;; i = (i + 1) & mask) {
+        IoTracePath* p = &ioTrace_paths[i];
+        if (p->path && strcmp(p->path, path) == 0) return p->id;
+        if (p->path) continue;
+
+        if (ioTrace_pathCount == IO_TRACE_PATHS) return 0;
+        p->path = strdup(path);
+        if (!p->path) return 0;
+        p->id = ++ioTrace_pathCount;
+
+        struct __attribute__((packed)) {
+            IoTraceRecord r;
+            uint16_t len;
+            char path[IO_TRACE_MAX_PATH];
+        } e;
+        make_record(&e.r, IO_TRACE_PATH_NAME, 0, 0, 0, p->id, -1, 0, 0, 0);
+        e.len = (uint16_t)strnlen(path, IO_TRACE_MAX_PATH);
+        memcpy(e.path, path, e.len);
+        put(&e, sizeof(e.r) + sizeof(e.len) + e.len);
+        return p->id;
+    }
+}
+
+// Must be called with ioTrace_mutex held.
+static IoTraceFd* fd_find_locked(int fd) {
+    for (int i = 0; i < IO_TRACE_FDS; i++) {
+        if (ioTrace_fds[i].used && ioTrace_fds[i].fd == fd) return &ioTrace_fds[i];
+    }
+    return NULL;
+}
+
+// Must be called with ioTrace_mutex held.
+static void fd_track_locked(int fd, uint32_t path) {
+    IoTraceFd* f = fd_find_locked(fd);
+    for (int i = 0; !f && i < IO_TRACE_FDS; i++) {
+        if (!ioTrace_fds[i].used) f = &ioTrace_fds[i];
+    }
+    if (!f) return;
+
+    f->used = 1;
+    f->fd = fd;
+    f->path = path;
+    f->pos = 0;
+}
+
+void io_trace_init() {
+    ioTrace_file = fopen(IO_TRACE_FILE, "wb");
+    if (!ioTrace_file) {
+        debugPrintf("[io][Trace] Can't open %s for writing.\n", IO_TRACE_FILE);
+        return;
+    }
+
+    IoTraceFileHeader h = { IO_TRACE_MAGIC, IO_TRACE_VERSION, 0 };
+    fwrite(&h, sizeof(h), 1, ioTrace_file);
+    ioTrace_lastFlush = sceKernelGetProcessTimeLow();
+
+    atexit(io_trace_flush);
+}
+
+void io_trace_path(IoTraceOp op, uint8_t flags, const char * path, int fd, int32_t result, uint32_t start_us) {
+    if (!ioTrace_file) return;
+    uint32_t end_us = sceKernelGetProcessTimeLow();
+
+    pthread_mutex_lock(&ioTrace_mutex);
+    uint32_t id = intern_locked(path);
+    if ((op == IO_TRACE_OPEN || op == IO_TRACE_FOPEN) && fd != -1) fd_track_locked(fd, id);
+    IoTraceRecord r;
+    make_record(&r, op, flags, start_us, end_us, id, fd, 0, 0, result);
+    put(&r, sizeof(r));
+    end_record_locked();
+    pthread_mutex_unlock(&ioTrace_mutex);
+}
+
+void io_trace_rename(const char * oldpath, const char * newpath, int32_t result, uint32_t start_us) {
+    if (!ioTrace_file) return;
+    uint32_t end_us = sceKernelGetProcessTimeLow();
+
+    pthread_mutex_lock(&ioTrace_mutex);
+    uint32_t old_id = intern_locked(oldpath);
+    uint32_t new_id = intern_locked(newpath);
+    IoTraceRecord r;
+    make_record(&r, IO_TRACE_RENAME, 0, start_us, end_us, old_id, -1, 0, (int32_t)new_id, result);
+    put(&r, sizeof(r));
+    end_record_locked();
+    pthread_mutex_unlock(&ioTrace_mutex);
+}
+
+void io_trace_fd(IoTraceOp op, uint8_t flags, int fd, int32_t size, int64_t result, uint32_t start_us) {
+    if (!ioTrace_file) return;
+    uint32_t end_us = sceKernelGetProcessTimeLow();
+
+    pthread_mutex_lock(&ioTrace_mutex);
+    IoTraceFd* f = fd_find_locked(fd);
+    uint32_t path = f ? f->path : 0;
+    int64_t offset = f ? f->pos : -1;
+
+    if (f) {
+        switch (op) {
+            case IO_TRACE_READ:
+            case IO_TRACE_WRITE:
+                if (result > 0) f->pos += result;
+                break;
+            case IO_TRACE_FFULLREAD:
+                f->pos += size;
+                break;
+            case IO_TRACE_LSEEK:
+                if (result >= 0) f->pos = result;
+                break;
+            case IO_TRACE_CLOSE:
+            case IO_TRACE_FCLOSE:
+                f->used = 0;
+                break;
+            default:
+                break;
+        }
+    }
+
+    IoTraceRecord r;
+    make_record(&r, op, flags, start_us, end_us, path, fd, offset, size, (int32_t)result);
+    put(&r, sizeof(r));
+    end_record_locked();
+    pthread_mutex_unlock(&ioTrace_mutex);
+}
+
+void io_trace_flush() {
+    if (!ioTrace_file) return;
+
+    pthread_mutex_lock(&ioTrace_mutex);
+    flush_locked(1);
+    pthread_mutex_unlock(&ioTrace_mutex);
+}
+
+#endif // IO_TRACE
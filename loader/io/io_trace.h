@@ -0,0 +1,129 @@
+/*
+ * io/io_trace.h
+ *
+ * Optional binary trace of the file operations made by the game, meant to
+ * be analyzed on the host with tools/io_trace_report.py. Enabled with the
+ * IO_TRACE CMake option; compiles to nothing otherwise.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_IO_TRACE_H
+#define SOLOADER_IO_TRACE_H
+
+#include <stdint.h>
+
+#define IO_TRACE_FILE DATA_PATH "io_trace.bin"
+#define IO_TRACE_BUFFER_SIZE (64 * 1024)
+
+// Buffered records are written out at least this often while I/O goes on.
+#define IO_TRACE_FLUSH_MS 250
+
+#define IO_TRACE_MAGIC 0x52544F49 // "IOTR"
+#define IO_TRACE_VERSION 1
+
+// Distinct paths that get an id; later ones are recorded as id 0.
+#define IO_TRACE_PATHS 4096
+
+// Longer paths are cut short.
+#define IO_TRACE_MAX_PATH 1024
+
+// Open fds whose path and position are followed.
+#define IO_TRACE_FDS 256
+
+typedef enum IoTraceOp {
+    IO_TRACE_PATH_NAME = 1, // defines path id `path`; no operation
+    IO_TRACE_OPEN,
+    IO_TRACE_FOPEN,
+    IO_TRACE_OPENDIR,
+    IO_TRACE_READ,
+    IO_TRACE_WRITE,
+    IO_TRACE_LSEEK,
+    IO_TRACE_FSTAT,
+    IO_TRACE_FSYNC,
+    IO_TRACE_FTRUNCATE,
+    IO_TRACE_CLOSE,
+    IO_TRACE_FCLOSE,
+    IO_TRACE_FFULLREAD,
+    IO_TRACE_STAT,
+    IO_TRACE_UNLINK,
+    IO_TRACE_REMOVE,
+    IO_TRACE_RENAME,
+    IO_TRACE_MKDIR,
+    IO_TRACE_RMDIR,
+} IoTraceOp;
+
+// Set in `flags` for operations made through java.io.InputStream.
+#define IO_TRACE_FROM_STREAM 1
+
+/*
+ * File layout: IoTraceFileHeader followed by IoTraceRecords. A PATH_NAME
+ * record is followed by the path: a uint16 length and the bytes, without a
+ * terminator. Integers are little-endian.
+ *
+ * `path` is the id of the translated path, 0 if unknown. For fd operations
+ * it's the path the fd was opened with, and `offset` the fd's position
+ * before the operation, -1 if unknown. FILE operations use the FILE
+ * pointer as the fd. `size` is the size asked for (for LSEEK, the whence;
+ * for FFULLREAD, the bytes read; for RENAME, the id of the new path),
+ * `result` what the call returned. `time_us` is when the call started,
+ * `latency_us` how long it took.
+ */
+
+typedef struct __attribute__((packed)) IoTraceFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+} IoTraceFileHeader;
+
+typedef struct __attribute__((packed)) IoTraceRecord {
+    uint8_t op;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t thread;
+    uint32_t time_us;
+    uint32_t latency_us;
+    uint32_t path;
+    int32_t fd;
+    int64_t offset;
+    int32_t size;
+    int32_t result;
+} IoTraceRecord;
+
+#ifdef IO_TRACE
+
+#include <psp2/kernel/processmgr.h>
+
+void io_trace_init();
+
+// An operation on a path. For OPEN and FOPEN, `fd` is the new fd (or -1)
+// and starts being followed.
+void io_trace_path(IoTraceOp op, uint8_t flags, const char * path, int fd, int32_t result, uint32_t start_us);
+
+void io_trace_rename(const char * oldpath, const char * newpath, int32_t result, uint32_t start_us);
+
+// An operation on an fd. For CLOSE and FCLOSE, it stops being followed.
+void io_trace_fd(IoTraceOp op, uint8_t flags, int fd, int32_t size, int64_t result, uint32_t start_us);
+
+// Writes out everything buffered so far. Called at exit and when the Vita
+// suspends.
+void io_trace_flush();
+
+#define IO_TRACE_BEGIN(t) uint32_t t = sceKernelGetProcessTimeLow()
+#define IO_TRACE_PATH(t, op, flags, path, fd, result) io_trace_path(op, flags, path, fd, result, t)
+#define IO_TRACE_FD(t, op, flags, fd, size, result) io_trace_fd(op, flags, fd, size, result, t)
+#define IO_TRACE_RENAME(t, oldpath, newpath, result) io_trace_rename(oldpath, newpath, result, t)
+
+#else
+
+#define IO_TRACE_BEGIN(t)
+#define IO_TRACE_PATH(t, op, flags, path, fd, result)
+#define IO_TRACE_FD(t, op, flags, fd, size, result)
+#define IO_TRACE_RENAME(t, oldpath, newpath, result)
+
+#endif // IO_TRACE
+
+#endif // SOLOADER_IO_TRACE_H
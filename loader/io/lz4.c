@@ -0,0 +1,70 @@
+/*
+ * io/lz4.c
+ *
+ * Decoder for the LZ4 block format, used for compressed entries of the
+ * asset pack.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "lz4.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// Reads the 255-terminated extension of a literal or match length.
+static int read_length(const uint8_t** ip, const uint8_t* iend, size_t* len) {
+    uint8_t b;
+    do {
+        if (*ip >= iend) return -1;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+int lz4_decompress(const uint8_t* src, int src_len, uint8_t* dst, int dst_cap) {
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + src_len;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dst_cap;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t lit = token >> 4;
+        if (lit == 15 && read_length(&ip, iend, &lit) != 0) return -1;
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op)) return -1;
+
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+
+        // The last sequence has literals only.
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return -1;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return -1;
+
+        size_t len = token & 15;
+        if (len == 15 && read_length(&ip, iend, &len) != 0) return -1;
+        len += 4;
+        if (len > (size_t)(oend - op)) return -1;
+
+        const uint8_t* match = op - offset;
+        if (offset >= len) {
+            memcpy(op, match, len);
+            op += len;
+        } else {
+            // Overlapping match, repeats the last `offset` bytes.
+            while (len--) *op++ = *match++;
+        }
+    }
+
+    return (int)(op - dst);
+}
@@ -0,0 +1,25 @@
+/*
+ * io/lz4.h
+ *
+ * Decoder for the LZ4 block format, used for compressed entries of the
+ * asset pack.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_LZ4_H
+#define SOLOADER_LZ4_H
+
+#include <stdint.h>
+
+/*
+ * Decompresses one LZ4 block. Never reads past `src + src_len` or writes
+ * past `dst + dst_cap`. Returns the decompressed size, or -1 if the input
+ * is malformed or doesn't fit.
+ */
+int lz4_decompress(const uint8_t* src, int src_len, uint8_t* dst, int dst_cap);
+
+#endif // SOLOADER_LZ4_H
@@ -0,0 +1,301 @@
+/*
+ * io/meta_cache.c
+ *
+ * Cache of stat() results, including "doesn't exist", keyed by translated
+ * path. The game probes the same paths over and over and every memory card
+ * stat is slow; since nothing but the game writes to its data directory,
+ * invalidating entries on our own writes is enough to keep it correct.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "meta_cache.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/utils.h"
+
+typedef struct {
+    char* path;   // NULL if the slot was never used
+    uint32_t hash;
+    int valid;    // invalidated slots keep their key so probing still works
+    int exists;
+    struct stat st;
+} MetaCacheEntry;
+
+static MetaCacheEntry metaCache[META_CACHE_SLOTS];
+static uint32_t metaCache_used = 0;
+static uint32_t metaCache_generation = 0;
+static MetaCacheStats metaCache_stats;
+static pthread_mutex_t metaCache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Fds opened for writing and their paths, see meta_cache_track_fd(). Only a
+// few are open at a time, so they're looked up by a linear scan.
+typedef struct {
+    int fd;
+    char* path;
+} MetaCacheFd;
+
+static MetaCacheFd* metaCache_fds = NULL;
+static int metaCache_fds_count = 0;
+static int metaCache_fds_cap = 0;
+static int metaCache_fds_lost = 0; // set once an fd couldn't be tracked
+
+static uint32_t hash_path(const char* path) {
+    uint32_t h = 2166136261u;
+    while (*path) {
+        h ^= (uint8_t)*path++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Must be called with metaCache_mutex held.
+static void flush_locked() {
+    for (int i = 0; i < META_CACHE_SLOTS; i++) {
+        free(metaCache[i].path);
+    }
+    memset(metaCache, 0, sizeof(metaCache));
+    metaCache_used = 0;
+    metaCache_stats.flushes++;
+}
+
+// Finds the slot of `path`, or with `create`, the slot to put it in (NULL if
+// out of memory). Must be called with metaCache_mutex held.
+static MetaCacheEntry* lookup_locked(const char* path, uint32_t hash, int create) {
+    if (create && metaCache_used >= META_CACHE_SLOTS / 4 * 3) {
+        flush_locked();
+    }
+
+    uint32_t i = hash & (META_CACHE_SLOTS - 1);
+    while (metaCache[i].path) {
+        if (metaCache[i].hash == hash && strcmp(metaCache[i].path, path) == 0) {
+            return &metaCache[i];
+        }
+        i = (i + 1) & (META_CACHE_SLOTS - 1);
+    }
+
+    if (!create) return NULL;
+
+    metaCache[i].path = strdup(path);
+    if (!metaCache[i].path) return NULL;
+    metaCache[i].hash = hash;
+    metaCache[i].valid = 0;
+    metaCache_used++;
+    return &metaCache[i];
+}
+
+// Must be called with metaCache_mutex held.
+static void count_lookup_locked(int hit) {
+    if (hit) metaCache_stats.hits++;
+    else metaCache_stats.misses++;
+
+    if ((metaCache_stats.hits + metaCache_stats.misses) % META_CACHE_REPORT_EVERY == 0) {
+        debugPrintf("[MetaCache] %u hits, %u misses, %u invalidations, %u flushes, %u entries.\n",
+                    metaCache_stats.hits, metaCache_stats.misses, metaCache_stats.invalidations,
+                    metaCache_stats.flushes, metaCache_used);
+    }
+}
+
+static void put(const char* path, uint32_t hash, uint32_t generation, int exists, const struct stat* st) {
+    pthread_mutex_lock(&metaCache_mutex);
+    // Skip it if something was invalidated while we were asking the card;
+    // the answer may already be out of date.
+    if (generation == metaCache_generation) {
+        MetaCacheEntry* e = lookup_locked(path, hash, 1);
+        if (e) {
+            e->valid = 1;
+            e->exists = exists;
+            if (exists) e->st = *st;
+        }
+    }
+    pthread_mutex_unlock(&metaCache_mutex);
+}
+
+int meta_cache_peek(const char* path, struct stat* st) {
+    uint32_t hash = hash_path(path);
+    int ret = -1;
+
+    pthread_mutex_lock(&metaCache_mutex);
+    MetaCacheEntry* e = lookup_locked(path, hash, 0);
+    if (e && e->valid) {
+        ret = e->exists;
+        if (e->exists && st) *st = e->st;
+    }
+    count_lookup_locked(ret >= 0);
+    pthread_mutex_unlock(&metaCache_mutex);
+
+    return ret;
+}
+
+int meta_cache_stat(const char* path, struct stat* st) {
+    int cached = meta_cache_peek(path, st);
+    if (cached == 1) return 0;
+    if (cached == 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    uint32_t hash = hash_path(path);
+    pthread_mutex_lock(&metaCache_mutex);
+    uint32_t generation = metaCache_generation;
+    pthread_mutex_unlock(&metaCache_mutex);
+
+    int res = stat(path, st);
+    if (res == 0) {
+        put(path, hash, generation, 1, st);
+    } else if (errno == ENOENT) {
+        int err = errno;
+        put(path, hash, generation, 0, NULL);
+        errno = err;
+    }
+    return res;
+}
+
+void meta_cache_put_missing(const char* path) {
+    uint32_t hash = hash_path(path);
+
+    pthread_mutex_lock(&metaCache_mutex);
+    MetaCacheEntry* e = lookup_locked(path, hash, 1);
+    if (e) {
+        e->valid = 1;
+        e->exists = 0;
+    }
+    pthread_mutex_unlock(&metaCache_mutex);
+}
+
+// Must be called with metaCache_mutex held.
+static void invalidate_locked(const char* path) {
+    MetaCacheEntry* e = lookup_locked(path, hash_path(path), 0);
+    if (e) e->valid = 0;
+}
+
+void meta_cache_invalidate(const char* path) {
+    if (!path) return;
+
+    char p[1024];
+    strncpy(p, path, sizeof(p) - 1);
+    p[sizeof(p) - 1] = '\0';
+
+    pthread_mutex_lock(&metaCache_mutex);
+    metaCache_generation++;
+    metaCache_stats.invalidations++;
+
+    // Both "dir" and "dir/" may be cached, for the path and for its parent.
+    for (int level = 0; level < 2; level++) {
+        size_t len = strlen(p);
+        if (len > 1 && p[len - 1] == '/') p[--len] = '\0';
+        invalidate_locked(p);
+
+        if (len + 1 < sizeof(p)) {
+            p[len] = '/';
+            p[len + 1] = '\0';
+            invalidate_locked(p);
+            p[len] = '\0';
+        }
+
+        char* slash = strrchr(p, '/');
+        if (!slash) break;
+        *slash = '\0';
+    }
+
+    pthread_mutex_unlock(&metaCache_mutex);
+}
+
+// Must be called with metaCache_mutex held.
+static MetaCacheFd* find_fd_locked(int fd) {
+    for (int i = 0; i < metaCache_fds_count; i++) {
+        if (metaCache_fds[i].fd == fd) return &metaCache_fds[i];
+    }
+    return NULL;
+}
+
+void meta_cache_track_fd(int fd, const char* path) {
+    if (fd < 0) return;
+
+    char* p = strdup(path);
+    pthread_mutex_lock(&metaCache_mutex);
+
+    MetaCacheFd* f = find_fd_locked(fd);
+    if (!f && p && metaCache_fds_count == metaCache_fds_cap) {
+        int cap = metaCache_fds_cap ? metaCache_fds_cap * 2 : 16;
+        MetaCacheFd* fds = realloc(metaCache_fds, cap * sizeof(MetaCacheFd));
+        if (fds) {
+            metaCache_fds = fds;
+            metaCache_fds_cap = cap;
+        }
+    }
+
+    if (f && p) {
+        free(f->path);
+        f->path = p;
+    } else if (p && metaCache_fds_count < metaCache_fds_cap) {
+        metaCache_fds[metaCache_fds_count].fd = fd;
+        metaCache_fds[metaCache_fds_count].path = p;
+        metaCache_fds_count++;
+    } else {
+        debugPrintf("[MetaCache] Out of memory, can't track fd %i.\n", fd);
+        if (f) {
+            free(f->path);
+            *f = metaCache_fds[--metaCache_fds_count];
+        }
+        free(p);
+        metaCache_fds_lost = 1;
+    }
+
+    pthread_mutex_unlock(&metaCache_mutex);
+}
+
+void meta_cache_fd_written(int fd) {
+    // Unlocked peek, most writes are to fds that aren't tracked.
+    if (__atomic_load_n(&metaCache_fds_count, __ATOMIC_RELAXED) == 0
+        && !__atomic_load_n(&metaCache_fds_lost, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    pthread_mutex_lock(&metaCache_mutex);
+    MetaCacheFd* f = find_fd_locked(fd);
+    if (f) {
+        metaCache_generation++;
+        invalidate_locked(f->path);
+    } else if (!f && metaCache_fds_lost) {
+        // Might be the fd that couldn't be tracked.
+        metaCache_generation++;
+        flush_locked();
+    }
+    pthread_mutex_unlock(&metaCache_mutex);
+}
+
+void meta_cache_untrack_fd(int fd) {
+    pthread_mutex_lock(&metaCache_mutex);
+    MetaCacheFd* f = find_fd_locked(fd);
+    if (f) {
+        metaCache_generation++;
+        invalidate_locked(f->path);
+        free(f->path);
+        *f = metaCache_fds[--metaCache_fds_count];
+    }
+    pthread_mutex_unlock(&metaCache_mutex);
+}
+
+int meta_cache_fd_path(int fd, char* out, size_t size) {
+    pthread_mutex_lock(&metaCache_mutex);
+    MetaCacheFd* f = find_fd_locked(fd);
+    int ok = f && strlen(f->path) < size;
+    if (ok) strcpy(out, f->path);
+    pthread_mutex_unlock(&metaCache_mutex);
+    return ok;
+}
+
+void meta_cache_get_stats(MetaCacheStats* stats) {
+    pthread_mutex_lock(&metaCache_mutex);
+    *stats = metaCache_stats;
+    stats->entries = metaCache_used;
+    pthread_mutex_unlock(&metaCache_mutex);
+}
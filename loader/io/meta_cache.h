@@ -0,0 +1,69 @@
+/*
+ * io/meta_cache.h
+ *
+ * Cache of stat() results, including "doesn't exist", keyed by translated
+ * path. The game probes the same paths over and over and every memory card
+ * stat is slow; since nothing but the game writes to its data directory,
+ * invalidating entries on our own writes is enough to keep it correct.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_META_CACHE_H
+#define SOLOADER_META_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+// Hash table slots; the cache is flushed when it's 3/4 full.
+#define META_CACHE_SLOTS 4096
+
+// In DEBUG builds, the stats are logged every this many lookups.
+#define META_CACHE_REPORT_EVERY 10000
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t invalidations;
+    uint32_t flushes;
+    uint32_t entries;
+} MetaCacheStats;
+
+// stat(), answered from the cache when possible. Same return value and
+// errno as stat().
+int meta_cache_stat(const char* path, struct stat* st);
+
+/*
+ * Result of a lookup that doesn't fill the cache: 1 if `path` is known to
+ * exist (and `*st` is set), 0 if it's known not to, -1 if it's not cached.
+ */
+int meta_cache_peek(const char* path, struct stat* st);
+
+// Records that `path` doesn't exist, e.g. after a failed opendir().
+void meta_cache_put_missing(const char* path);
+
+// Forgets `path` and its parent directory, whose mtime changes when entries
+// are created or removed in it.
+void meta_cache_invalidate(const char* path);
+
+/*
+ * Writes through fds don't name the path, so fds opened for writing are
+ * remembered here until they're closed. Any fd number can be tracked; if
+ * one can't be for lack of memory, writes to fds that aren't tracked flush
+ * the whole cache from then on.
+ */
+void meta_cache_track_fd(int fd, const char* path);
+void meta_cache_fd_written(int fd);
+void meta_cache_untrack_fd(int fd);
+
+// Copies the path `fd` is tracked with to `out`. Returns 0 if it isn't
+// tracked, or the path doesn't fit.
+int meta_cache_fd_path(int fd, char* out, size_t size);
+
+void meta_cache_get_stats(MetaCacheStats* stats);
+
+#endif // SOLOADER_META_CACHE_H
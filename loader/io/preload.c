@@ -0,0 +1,246 @@
+/*
+ * io/preload.c
+ *
+ * Profile-guided preloading at boot. The files the game opens early on are
+ * recorded, in the order it first opens them; on the next boot, they're read
+ * into the block and metadata caches in that order on the I/O pool, while a
+ * progress bar is shown in place of the splash screen.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "preload.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <psp2/kernel/processmgr.h>
+#include <psp2/kernel/threadmgr.h>
+
+#include "io/block_cache.h"
+#include "io/io_pool.h"
+#include "io/meta_cache.h"
+#include "utils/loading_screen.h"
+#include "utils/settings.h"
+#include "utils/utils.h"
+
+typedef struct {
+    char* path;
+    uint32_t hash;
+} PreloadPath;
+
+// The profile being replayed. Only one preload job runs at a time, so only
+// `done` is shared, with the screen thread, and `class`, which drops to
+// IO_CLASS_IDLE once the game is up.
+static char** preload_paths = NULL;
+static int preload_count = 0;
+static int preload_next = 0;
+static int preload_done = 0;
+static int64_t preload_bytes = 0;
+static int64_t preload_budget = 0;
+static uint32_t preload_startTime = 0;
+static IoClass preload_class = IO_CLASS_STREAMING;
+
+static pthread_t preload_screenThread;
+static int preload_screenShown = 0;
+static int preload_screenStop = 0;
+static int preload_screenExited = 0;
+
+// The profile being recorded.
+static PreloadPath preload_recorded[PRELOAD_PATHS_MAX];
+static int preload_recordedCount = 0;
+static int preload_recording = 0;
+static pthread_mutex_t preload_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t hash_path(const char* path) {
+    uint32_t h = 2166136261u;
+    for (const char* c = path; *c; c++) h = (h ^ (uint8_t)*c) * 16777619u;
+    return h;
+}
+
+static int load_profile() {
+    FILE* f = fopen(PRELOAD_PROFILE_PATH, "r");
+    if (!f) return 0;
+
+    preload_paths = malloc(sizeof(char*) * PRELOAD_PATHS_MAX);
+    char line[1024];
+    while (preload_paths && preload_count < PRELOAD_PATHS_MAX && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') continue;
+
+        char* p = strdup(line);
+        if (!p) break;
+        preload_paths[preload_count++] = p;
+    }
+    fclose(f);
+
+    return preload_count;
+}
+
+static void free_profile() {
+    for (int i = 0; i < preload_count; i++) free(preload_paths[i]);
+    free(preload_paths);
+    preload_paths = NULL;
+}
+
+// Preloads one file per job, so the files go in the order they're needed
+// and other jobs get a worker in between.
+static void preload_job(void* arg) {
+    const char* path = preload_paths[preload_next++];
+
+    struct stat st;
+    if (meta_cache_stat(path, &st) == 0 && S_ISREG(st.st_mode) && preload_bytes < preload_budget) {
+        int64_t len = st.st_size;
+        if (len > PRELOAD_FILE_MAX) len = PRELOAD_FILE_MAX;
+        if (len > preload_budget - preload_bytes) len = preload_budget - preload_bytes;
+
+        int64_t n = block_cache_warm(path, 0, len);
+        if (n > 0) preload_bytes += n;
+    }
+
+    if (preload_next < preload_count) {
+        __atomic_store_n(&preload_done, preload_next, __ATOMIC_RELEASE);
+        IoClass cls = __atomic_load_n(&preload_class, __ATOMIC_RELAXED);
+        if (io_pool_submit(cls, preload_job, NULL) == 0) return;
+    }
+
+    debugPrintf("[Preload] %i of %i files, %lli bytes in %u ms.\n", preload_next, preload_count,
+                preload_bytes, (sceKernelGetProcessTimeLow() - preload_startTime) / 1000);
+    free_profile();
+    // Even if the chain broke off early, there's nothing more to wait for.
+    __atomic_store_n(&preload_done, preload_count, __ATOMIC_RELEASE);
+}
+
+static void* screen_thread(void* arg) {
+    loading_screen_run_assets_preloader();
+
+    int done;
+    while ((done = __atomic_load_n(&preload_done, __ATOMIC_ACQUIRE)) < preload_count
+           && sceKernelGetProcessTimeLow() - preload_startTime < PRELOAD_SCREEN_MAX_MS * 1000) {
+        loading_screen_update_assets_preloader((float)done / (float)preload_count);
+        for (int i = 0; i < 5 && !__atomic_load_n(&preload_screenStop, __ATOMIC_ACQUIRE); i++) {
+            sceKernelDelayThread(10 * 1000);
+        }
+        if (__atomic_load_n(&preload_screenStop, __ATOMIC_ACQUIRE)) break;
+    }
+
+    loading_screen_quit();
+    __atomic_store_n(&preload_screenExited, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void save_job(void* arg) {
+    const char* tmp = PRELOAD_PROFILE_PATH ".tmp";
+
+    FILE* f = fopen(tmp, "w");
+    if (!f) {
+        debugPrintf("[Preload] Can't open %s for writing.\n", tmp);
+    } else {
+        int ok = 1;
+        for (int i = 0; i < preload_recordedCount; i++) {
+            if (fprintf(f, "%s\n", preload_recorded[i].path) < 0) ok = 0;
+        }
+        if (fclose(f) != 0) ok = 0;
+
+        if (ok) {
+            remove(PRELOAD_PROFILE_PATH);
+            rename(tmp, PRELOAD_PROFILE_PATH);
+        } else {
+            remove(tmp);
+        }
+        debugPrintf("[Preload] Recorded %i files.\n", preload_recordedCount);
+    }
+
+    for (int i = 0; i < preload_recordedCount; i++) free(preload_recorded[i].path);
+    preload_recordedCount = 0;
+}
+
+void preload_start(void) {
+    preload_startTime = sceKernelGetProcessTimeLow();
+    __atomic_store_n(&preload_recording, 1, __ATOMIC_RELAXED);
+
+    if (!preloadAssets || !load_profile()) {
+        free_profile();
+        return;
+    }
+
+    // Not more than the block cache holds, or the last files would push the
+    // first ones out.
+    preload_budget = (int64_t)blockCacheSize * 1024 * 1024 * 3 / 4;
+
+    if (io_pool_submit(preload_class, preload_job, NULL) != 0) {
+        free_profile();
+        preload_count = 0;
+        return;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 256 * 1024);
+    preload_screenShown = pthread_create(&preload_screenThread, &attr, screen_thread, NULL) == 0;
+    pthread_attr_destroy(&attr);
+}
+
+void preload_note_open(const char* path) {
+    if (!__atomic_load_n(&preload_recording, __ATOMIC_RELAXED)) return;
+
+    pthread_mutex_lock(&preload_mutex);
+    if (!preload_recording) {
+        pthread_mutex_unlock(&preload_mutex);
+        return;
+    }
+
+    if (sceKernelGetProcessTimeLow() - preload_startTime > PRELOAD_RECORD_MS * 1000
+        || preload_recordedCount == PRELOAD_PATHS_MAX) {
+        __atomic_store_n(&preload_recording, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&preload_mutex);
+
+        // Nothing touches the list anymore, the job can have it.
+        if (io_pool_submit(IO_CLASS_SAVE, save_job, NULL) != 0) save_job(NULL);
+        return;
+    }
+
+    uint32_t h = hash_path(path);
+    int seen = 0;
+    for (int i = 0; i < preload_recordedCount && !seen; i++) {
+        seen = preload_recorded[i].hash == h && strcmp(preload_recorded[i].path, path) == 0;
+    }
+
+    if (!seen) {
+        char* p = strdup(path);
+        if (p) {
+            preload_recorded[preload_recordedCount].path = p;
+            preload_recorded[preload_recordedCount].hash = h;
+            preload_recordedCount++;
+        }
+    }
+    pthread_mutex_unlock(&preload_mutex);
+}
+
+void preload_hide_screen(void) {
+    // The game is up, what's left of the profile mustn't compete with it.
+    __atomic_store_n(&preload_class, IO_CLASS_IDLE, __ATOMIC_RELAXED);
+
+    if (!preload_screenShown) return;
+    preload_screenShown = 0;
+
+    __atomic_store_n(&preload_screenStop, 1, __ATOMIC_RELEASE);
+    uint32_t start = sceKernelGetProcessTimeLow();
+    while (!__atomic_load_n(&preload_screenExited, __ATOMIC_ACQUIRE)
+           && sceKernelGetProcessTimeLow() - start < PRELOAD_SCREEN_JOIN_MS * 1000) {
+        sceKernelDelayThread(5 * 1000);
+    }
+
+    if (__atomic_load_n(&preload_screenExited, __ATOMIC_ACQUIRE)) {
+        pthread_join(preload_screenThread, NULL);
+    } else {
+        debugPrintf("[Preload] The progress screen didn't stop in %i ms, not waiting for it.\n",
+                    PRELOAD_SCREEN_JOIN_MS);
+        pthread_detach(preload_screenThread);
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * io/preload.h
+ *
+ * Profile-guided preloading at boot. The files the game opens early on are
+ * recorded, in the order it first opens them; on the next boot, they're read
+ * into the block and metadata caches in that order on the I/O pool, while a
+ * progress bar is shown in place of the splash screen.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_PRELOAD_H
+#define SOLOADER_PRELOAD_H
+
+// One path per line, in the order the game first opened them.
+#define PRELOAD_PROFILE_PATH DATA_PATH "preload_profile.txt"
+
+// Files first opened this long after preload_start() aren't recorded.
+#define PRELOAD_RECORD_MS 60000
+
+#define PRELOAD_PATHS_MAX 1024
+
+// Files are preloaded up to this size; larger ones get only their start,
+// the rest is left to read-ahead.
+#define PRELOAD_FILE_MAX (512 * 1024)
+
+// The progress screen stays up until preloading is over or the game is
+// ready to draw, but not longer than this after preload_start().
+#define PRELOAD_SCREEN_MAX_MS 30000
+
+// How long preload_hide_screen() waits for the screen to go away.
+#define PRELOAD_SCREEN_JOIN_MS 250
+
+/*
+ * Replays the profile from the last boot, if there is one and preloadAssets
+ * is set in config.txt, and starts recording the one for the next boot.
+ * Call once settings are loaded.
+ */
+void preload_start(void);
+
+// Records that the game opened loose file `path` (translated) for reading.
+void preload_note_open(const char* path);
+
+// Takes the progress screen down, so the game can set up the GPU, waiting
+// for it at most PRELOAD_SCREEN_JOIN_MS. Whatever is left to preload
+// carries on in the background at IO_CLASS_IDLE.
+void preload_hide_screen(void);
+
+#endif // SOLOADER_PRELOAD_H
@@ -0,0 +1,354 @@
+/*
+ * io/readahead.c
+ *
+ * Read-ahead for files read sequentially in small pieces. Once a tracked fd
+ * has been read sequentially for a while, a background worker keeps the
+ * next window of the file in memory, so that the following reads are
+ * memcpys instead of memory card requests.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "readahead.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "io/block_cache.h"
+#include "io/io_pool.h"
+#include "utils/settings.h"
+#include "utils/utils.h"
+
+typedef enum {
+    WINDOW_EMPTY = 0,
+    WINDOW_QUEUED,
+    WINDOW_FILLING,
+    WINDOW_READY,
+} WindowState;
+
+typedef struct {
+    WindowState state;
+    uint8_t* data;
+    int64_t off;
+    int len;       // valid bytes once READY; short means end of file
+    int consumed;  // bytes of it served to the game
+} Window;
+
+// Each tracked fd has two windows: one being read by the game and one being
+// filled by the worker.
+typedef struct {
+    int used;
+    int size;         // window size
+    int64_t pos;      // position as seen by the game
+    int64_t last_end; // where the previous read ended
+    int streak;       // sequential reads in a row
+    Window win[2];
+
+    // Guards the kernel offset of the fd, which the worker and the game's
+    // thread both move.
+    pthread_mutex_t io_mutex;
+    int64_t fd_pos;
+} ReadAheadFd;
+
+static ReadAheadFd raFds[READAHEAD_FDS_MAX];
+static ReadAheadStats ra_stats;
+
+// Guards raFds (except the io parts) and the stats.
+static pthread_mutex_t ra_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ra_ready_cond = PTHREAD_COND_INITIALIZER;
+
+static int window_size() {
+    int kb = readAheadWindow;
+    if (kb <= 0) return 0;
+    if (kb > 1024) kb = 1024;
+    return kb * 1024;
+}
+
+// Reads at `off`, moving the kernel offset only when needed.
+static int pread_locked(ReadAheadFd* f, int fd, void* buf, int len, int64_t off) {
+    // The block cache keeps the kernel offset itself for the fds it tracks.
+    if (block_cache_is_tracked(fd)) return block_cache_pread(fd, buf, len, off);
+
+    if (f->fd_pos != off) {
+        if (lseek(fd, (off_t)off, SEEK_SET) < 0) {
+            f->fd_pos = -1;
+            return -1;
+        }
+        f->fd_pos = off;
+    }
+
+    int n = read(fd, buf, len);
+    if (n > 0) f->fd_pos += n;
+    else if (n < 0) f->fd_pos = -1;
+    return n;
+}
+
+// Windows are filled by the I/O pool. The job is fd * 2 + window; a window
+// is queued once at a time, but jobs of windows dropped since are skipped.
+static void fill_window(void* arg) {
+    int job = (int)(intptr_t)arg;
+    int fd = job / 2;
+    ReadAheadFd* f = &raFds[fd];
+    Window* w = &f->win[job % 2];
+
+    pthread_mutex_lock(&ra_mutex);
+    if (!f->used || w->state != WINDOW_QUEUED) {
+        pthread_mutex_unlock(&ra_mutex);
+        return;
+    }
+
+    w->state = WINDOW_FILLING;
+    if (!w->data) w->data = malloc(f->size);
+    int64_t off = w->off;
+    pthread_mutex_unlock(&ra_mutex);
+
+    pthread_mutex_lock(&f->io_mutex);
+    int n = w->data ? pread_locked(f, fd, w->data, f->size, off) : -1;
+    pthread_mutex_unlock(&f->io_mutex);
+
+    pthread_mutex_lock(&ra_mutex);
+    w->len = (n > 0) ? n : 0;
+    w->consumed = 0;
+    w->state = WINDOW_READY;
+    ra_stats.prefetched += w->len;
+    ra_stats.windows++;
+    if (ra_stats.windows % READAHEAD_REPORT_EVERY == 0) {
+        debugPrintf("[ReadAhead] %u windows, %llu bytes prefetched, %llu hit, %llu wasted.\n",
+                    ra_stats.windows, ra_stats.prefetched, ra_stats.hit, ra_stats.wasted);
+    }
+    pthread_cond_broadcast(&ra_ready_cond);
+    pthread_mutex_unlock(&ra_mutex);
+}
+
+static ReadAheadFd* get(int fd) {
+    if (fd < 0 || fd >= READAHEAD_FDS_MAX || !raFds[fd].used) return NULL;
+    return &raFds[fd];
+}
+
+// Must be called with ra_mutex held.
+static void drop_window_locked(Window* w) {
+    if (w->state == WINDOW_READY && w->len > w->consumed) {
+        ra_stats.wasted += w->len - w->consumed;
+    }
+    w->state = WINDOW_EMPTY;
+}
+
+// Whether `w` has, or will have, the byte at `pos`.
+static int window_covers(const ReadAheadFd* f, const Window* w, int64_t pos) {
+    switch (w->state) {
+        case WINDOW_READY:
+            return pos >= w->off && pos < w->off + w->len;
+        case WINDOW_QUEUED:
+        case WINDOW_FILLING:
+            return pos >= w->off && pos < w->off + f->size;
+        default:
+            return 0;
+    }
+}
+
+// Queues the window after the one the game is reading. Must be called with
+// ra_mutex held.
+static void prefetch_locked(int fd, ReadAheadFd* f) {
+    int64_t next = f->pos;
+
+    for (int i = 0; i < 2; i++) {
+        Window* w = &f->win[i];
+        if (!window_covers(f, w, f->pos)) continue;
+
+        // A short window means the end of the file is in it.
+        if (w->state == WINDOW_READY && w->len < f->size) return;
+        next = w->off + f->size;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (window_covers(f, &f->win[i], next)) return;
+    }
+
+    // Take the window that doesn't hold the current position, unless the
+    // worker is filling it.
+    for (int i = 0; i < 2; i++) {
+        Window* w = &f->win[i];
+        if (w->state == WINDOW_FILLING || window_covers(f, w, f->pos)) continue;
+
+        drop_window_locked(w);
+        w->off = next;
+        w->state = WINDOW_QUEUED;
+
+        if (io_pool_submit(IO_CLASS_STREAMING, fill_window, (void*)(intptr_t)(fd * 2 + i)) != 0) {
+            w->state = WINDOW_EMPTY;
+        }
+        return;
+    }
+}
+
+void readahead_open(int fd) {
+    int size = window_size();
+    if (fd < 0 || fd >= READAHEAD_FDS_MAX || size <= 0) return;
+
+    pthread_mutex_lock(&ra_mutex);
+    ReadAheadFd* f = &raFds[fd];
+    if (!f->used) {
+        f->used = 1;
+        f->size = size;
+        f->pos = 0;
+        f->last_end = 0;
+        f->streak = 0;
+        f->fd_pos = 0;
+        memset(f->win, 0, sizeof(f->win));
+        pthread_mutex_init(&f->io_mutex, NULL);
+    }
+    pthread_mutex_unlock(&ra_mutex);
+}
+
+int readahead_is_tracked(int fd) {
+    return fd >= 0 && fd < READAHEAD_FDS_MAX && raFds[fd].used;
+}
+
+int readahead_read(int fd, void* buf, int len) {
+    uint8_t* dst = buf;
+    int total = 0;
+
+    pthread_mutex_lock(&ra_mutex);
+    ReadAheadFd* f = get(fd);
+    if (!f) {
+        pthread_mutex_unlock(&ra_mutex);
+        errno = EBADF;
+        return -1;
+    }
+
+    f->streak = (f->pos == f->last_end) ? f->streak + 1 : 0;
+
+    while (len > 0) {
+        Window* w = NULL;
+        for (int i = 0; i < 2; i++) {
+            if (window_covers(f, &f->win[i], f->pos)) w = &f->win[i];
+        }
+        if (!w) break;
+
+        if (w->state == WINDOW_FILLING) {
+            // It's coming, waiting is cheaper than reading it twice.
+            pthread_cond_wait(&ra_ready_cond, &ra_mutex);
+            continue;
+        }
+        if (w->state == WINDOW_QUEUED) {
+            // The pool hasn't got to it, and may not for a while behind
+            // other work. Read it ourselves; the job will be skipped.
+            drop_window_locked(w);
+            break;
+        }
+
+        int in = (int)(f->pos - w->off);
+        int n = w->len - in;
+        if (n > len) n = len;
+
+        memcpy(dst, w->data + in, n);
+        w->consumed += n;
+        ra_stats.hit += n;
+        f->pos += n;
+        dst += n;
+        total += n;
+        len -= n;
+    }
+
+    int err = 0;
+    if (len > 0) {
+        int64_t pos = f->pos;
+        pthread_mutex_unlock(&ra_mutex);
+
+        pthread_mutex_lock(&f->io_mutex);
+        int n = pread_locked(f, fd, dst, len, pos);
+        err = errno;
+        pthread_mutex_unlock(&f->io_mutex);
+
+        pthread_mutex_lock(&ra_mutex);
+        if (n > 0) {
+            f->pos += n;
+            total += n;
+        } else if (n < 0 && total == 0) {
+            total = -1;
+        }
+    }
+
+    f->last_end = f->pos;
+    if (f->streak >= READAHEAD_MIN_STREAK && total > 0) {
+        prefetch_locked(fd, f);
+    }
+    pthread_mutex_unlock(&ra_mutex);
+
+    if (total < 0) errno = err;
+    return total;
+}
+
+int64_t readahead_lseek(int fd, int64_t offset, int whence) {
+    pthread_mutex_lock(&ra_mutex);
+    ReadAheadFd* f = get(fd);
+    if (!f) {
+        pthread_mutex_unlock(&ra_mutex);
+        errno = EBADF;
+        return -1;
+    }
+
+    int64_t pos;
+    if (whence == SEEK_SET) {
+        pos = offset;
+    } else if (whence == SEEK_CUR) {
+        pos = f->pos + offset;
+    } else if (whence == SEEK_END) {
+        // fstat() rather than lseek(), which would move the kernel offset
+        // behind the back of whoever reads the fd.
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            pthread_mutex_unlock(&ra_mutex);
+            return -1;
+        }
+        pos = st.st_size + offset;
+    } else {
+        pos = -1;
+    }
+
+    if (pos < 0) {
+        pthread_mutex_unlock(&ra_mutex);
+        errno = EINVAL;
+        return -1;
+    }
+
+    f->pos = pos;
+    pthread_mutex_unlock(&ra_mutex);
+    return pos;
+}
+
+void readahead_close(int fd) {
+    pthread_mutex_lock(&ra_mutex);
+    ReadAheadFd* f = get(fd);
+    if (!f) {
+        pthread_mutex_unlock(&ra_mutex);
+        return;
+    }
+
+    // The worker may be reading from the fd right now.
+    while (f->win[0].state == WINDOW_FILLING || f->win[1].state == WINDOW_FILLING) {
+        pthread_cond_wait(&ra_ready_cond, &ra_mutex);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        drop_window_locked(&f->win[i]);
+        free(f->win[i].data);
+        f->win[i].data = NULL;
+    }
+    f->used = 0;
+    pthread_mutex_destroy(&f->io_mutex);
+    pthread_mutex_unlock(&ra_mutex);
+}
+
+void readahead_get_stats(ReadAheadStats* stats) {
+    pthread_mutex_lock(&ra_mutex);
+    *stats = ra_stats;
+    pthread_mutex_unlock(&ra_mutex);
+}
@@ -0,0 +1,56 @@
+/*
+ * io/readahead.h
+ *
+ * Read-ahead for files read sequentially in small pieces. Once a tracked fd
+ * has been read sequentially for a while, a background worker keeps the
+ * next window of the file in memory, so that the following reads are
+ * memcpys instead of memory card requests.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_READAHEAD_H
+#define SOLOADER_READAHEAD_H
+
+#include <stdint.h>
+
+// Fds above this aren't tracked and are read directly.
+#define READAHEAD_FDS_MAX 64
+
+// Sequential reads it takes before the worker starts prefetching.
+#define READAHEAD_MIN_STREAK 2
+
+// Window size used when config.txt doesn't set readAheadWindow (in KiB).
+#define READAHEAD_WINDOW_DEFAULT_KB 64
+
+// In DEBUG builds, the stats are logged every this many windows.
+#define READAHEAD_REPORT_EVERY 256
+
+typedef struct {
+    uint64_t prefetched; // bytes read by the worker
+    uint64_t hit;        // bytes served from prefetched windows
+    uint64_t wasted;     // prefetched bytes dropped unread
+    uint32_t windows;
+} ReadAheadStats;
+
+/*
+ * Starts tracking `fd`, a file opened read-only. From then on, the fd's
+ * position is kept here: it must be read, seeked and closed only through
+ * the functions below.
+ */
+void readahead_open(int fd);
+
+int readahead_is_tracked(int fd);
+int readahead_read(int fd, void* buf, int len);
+int64_t readahead_lseek(int fd, int64_t offset, int whence);
+
+// Stops tracking `fd`, waiting for the worker if it's busy with it. Doesn't
+// close the fd itself.
+void readahead_close(int fd);
+
+void readahead_get_stats(ReadAheadStats* stats);
+
+#endif // SOLOADER_READAHEAD_H
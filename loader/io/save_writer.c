@@ -0,0 +1,510 @@
+/*
+ * io/save_writer.c
+ *
+ * Write-behind for save files. The game writes saves into memory through a
+ * virtual fd; closing it hands the data to the I/O pool, which commits it
+ * as one write to a temporary file, one fsync and a rename, so the game
+ * never waits for the memory card and a crash never leaves half a save.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "save_writer.h"
+
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <psp2/kernel/processmgr.h>
+
+#include "io/block_cache.h"
+#include "io/io_pool.h"
+#include "io/meta_cache.h"
+#include "utils/utils.h"
+
+// Written next to the temporary file once it's complete and synced.
+typedef struct {
+    uint32_t magic;
+    uint32_t length;
+    uint32_t checksum; // FNV-1a of the data
+} SaveWriterMarker;
+
+typedef struct {
+    char* path;          // NULL if the slot is free
+    uint8_t* pending;    // closed and not committed yet (or whose commit
+                         // failed), NULL if none
+    size_t pending_len;
+    uint8_t* inflight;   // being committed, NULL if none
+    size_t inflight_len;
+    int queued;          // a commit job is queued or running
+} SaveWriterFile;
+
+typedef struct {
+    int used;
+    int writable;
+    SaveWriterFile* file;
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+    int64_t pos;
+} SaveWriterFd;
+
+static SaveWriterFile saveWriter_files[SAVE_WRITER_FILES_MAX];
+static SaveWriterFd saveWriter_fds[SAVE_WRITER_FDS_MAX];
+
+static pthread_mutex_t saveWriter_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t saveWriter_committed = PTHREAD_COND_INITIALIZER;
+
+static const char* save_names[] = {
+    "CheckpointSave", "LevelSave", "settings.sb", "AchievementsSave.sb",
+};
+
+int save_writer_is_save(const char* path) {
+    for (size_t i = 0; i < sizeof(save_names) / sizeof(save_names[0]); i++) {
+        if (strstr(path, save_names[i])) return 1;
+    }
+    return 0;
+}
+
+static int tmp_path(const char* path, char* out, size_t size) {
+    int len = snprintf(out, size, "%s" SAVE_WRITER_TMP_SUFFIX, path);
+    return (len < 0 || (size_t)len >= size) ? -1 : 0;
+}
+
+static int marker_path(const char* path, char* out, size_t size) {
+    int len = snprintf(out, size, "%s" SAVE_WRITER_MARKER_SUFFIX, path);
+    return (len < 0 || (size_t)len >= size) ? -1 : 0;
+}
+
+// FNV-1a
+static uint32_t checksum(const uint8_t* data, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int write_all(const char* path, const void* data, size_t len) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) return -1;
+
+    size_t done = 0;
+    while (done < len) {
+        int n = write(fd, (const uint8_t*)data + done, len - done);
+        if (n <= 0) break;
+        done += n;
+    }
+
+    int ok = done == len && fsync(fd) == 0;
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+// Whether the temporary file `tmp` is what the commit marker `marker` says.
+static int tmp_complete(const char* tmp, const char* marker) {
+    SaveWriterMarker m;
+    FILE* f = fopen(marker, "rb");
+    if (!f) return 0;
+    int ok = fread(&m, sizeof(m), 1, f) == 1 && m.magic == SAVE_WRITER_MARKER_MAGIC;
+    fclose(f);
+    if (!ok) return 0;
+
+    // Before allocating anything for it, the length has to be right.
+    struct stat st;
+    if (stat(tmp, &st) != 0 || (uint64_t)st.st_size != m.length) return 0;
+
+    f = fopen(tmp, "rb");
+    if (!f) return 0;
+    uint8_t* data = malloc(m.length ? m.length : 1);
+    ok = data && fread(data, 1, m.length, f) == m.length && fgetc(f) == EOF
+         && checksum(data, m.length) == m.checksum;
+    fclose(f);
+    free(data);
+    return ok;
+}
+
+/*
+ * Commits go: write the temporary file and fsync it, write the commit
+ * marker and fsync it, remove the save, rename, remove the marker. So a
+ * temporary file matching its marker is a complete save that may not have
+ * replaced the old one yet, and any other is the remains of a commit that
+ * never got that far.
+ */
+static void recover(const char* path) {
+    char tmp[1024], marker[1024];
+    if (tmp_path(path, tmp, sizeof(tmp)) != 0 || marker_path(path, marker, sizeof(marker)) != 0) return;
+
+    struct stat st;
+    if (stat(tmp, &st) == 0) {
+        if (tmp_complete(tmp, marker)) {
+            debugPrintf("[SaveWriter] Finishing the interrupted commit of %s.\n", path);
+            remove(path);
+            rename(tmp, path);
+        } else {
+            debugPrintf("[SaveWriter] Dropping the interrupted commit of %s.\n", path);
+            remove(tmp);
+        }
+    }
+    remove(marker);
+}
+
+// Looks for interrupted commits in `dir` and below, skipping DATA_PATH_INT.
+static void recover_dir(const char* dir, int depth) {
+    DIR* d = opendir(dir);
+    if (!d) return;
+
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        const char* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+        char p[1024];
+        int len = snprintf(p, sizeof(p), "%s%s%s", dir, dir[strlen(dir) - 1] == '/' ? "" : "/", name);
+        if (len < 0 || (size_t)len >= sizeof(p)) continue;
+
+        struct stat st;
+        if (stat(p, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            int assets = strncmp(p, DATA_PATH_INT, len) == 0 && strcmp(DATA_PATH_INT + len, "/") == 0;
+            if (!assets && depth < SAVE_WRITER_RECOVER_DEPTH) recover_dir(p, depth + 1);
+            continue;
+        }
+
+        size_t suffix = strlen(SAVE_WRITER_TMP_SUFFIX);
+        if ((size_t)len > suffix && strcmp(p + len - suffix, SAVE_WRITER_TMP_SUFFIX) == 0) {
+            p[len - suffix] = '\0';
+            if (save_writer_is_save(p)) recover(p);
+        }
+    }
+    closedir(d);
+}
+
+void save_writer_init() {
+    recover_dir(DATA_PATH, 0);
+    atexit(save_writer_flush_all);
+}
+
+// Must be called with saveWriter_mutex held.
+static SaveWriterFile* file_get_locked(const char* path, int create) {
+    SaveWriterFile* free_slot = NULL;
+    for (int i = 0; i < SAVE_WRITER_FILES_MAX; i++) {
+        SaveWriterFile* f = &saveWriter_files[i];
+        if (!f->path) {
+            if (!free_slot) free_slot = f;
+        } else if (strcmp(f->path, path) == 0) {
+            return f;
+        }
+    }
+
+    if (!create || !free_slot) return NULL;
+
+    free_slot->path = strdup(path);
+    return free_slot->path ? free_slot : NULL;
+}
+
+static int commit(const char* path, const uint8_t* data, size_t len) {
+    char tmp[1024], marker[1024];
+    if (tmp_path(path, tmp, sizeof(tmp)) != 0 || marker_path(path, marker, sizeof(marker)) != 0) return -1;
+
+    SaveWriterMarker m = {SAVE_WRITER_MARKER_MAGIC, (uint32_t)len, checksum(data, len)};
+    int ok = write_all(tmp, data, len) == 0 && write_all(marker, &m, sizeof(m)) == 0;
+
+    if (ok) {
+        remove(path);
+        ok = rename(tmp, path) == 0;
+    } else {
+        remove(tmp);
+    }
+    remove(marker);
+
+    meta_cache_invalidate(tmp);
+    meta_cache_invalidate(marker);
+    meta_cache_invalidate(path);
+    block_cache_invalidate(path);
+    return ok ? 0 : -1;
+}
+
+static void commit_job(void* arg) {
+    SaveWriterFile* f = arg;
+
+    pthread_mutex_lock(&saveWriter_mutex);
+    // Saves closed meanwhile replace the pending one, so a burst of them
+    // ends up as one or two commits.
+    while (f->pending) {
+        f->inflight = f->pending;
+        f->inflight_len = f->pending_len;
+        f->pending = NULL;
+        pthread_mutex_unlock(&saveWriter_mutex);
+
+        uint32_t start = sceKernelGetProcessTimeLow();
+        int res = commit(f->path, f->inflight, f->inflight_len);
+        debugPrintf("[SaveWriter] Committed %s (%u bytes): %i, %u us.\n", f->path, f->inflight_len, res,
+                    sceKernelGetProcessTimeLow() - start);
+
+        pthread_mutex_lock(&saveWriter_mutex);
+        if (res != 0 && !f->pending) {
+            // Keep it for the next flush to try again, rather than lose
+            // the save; a newer one replaces it.
+            debugPrintf("[SaveWriter] Keeping %s for another try.\n", f->path);
+            f->pending = f->inflight;
+            f->pending_len = f->inflight_len;
+            f->inflight = NULL;
+            break;
+        }
+        free(f->inflight);
+        f->inflight = NULL;
+    }
+    f->queued = 0;
+    pthread_cond_broadcast(&saveWriter_committed);
+    pthread_mutex_unlock(&saveWriter_mutex);
+}
+
+static SaveWriterFd* fd_get(int fd) {
+    int slot = fd - SAVE_WRITER_FD_BASE;
+    if (slot < 0 || slot >= SAVE_WRITER_FDS_MAX || !saveWriter_fds[slot].used) {
+        errno = EBADF;
+        return NULL;
+    }
+    return &saveWriter_fds[slot];
+}
+
+int save_writer_open(const char* path, int for_writing) {
+    pthread_mutex_lock(&saveWriter_mutex);
+    SaveWriterFile* f = file_get_locked(path, 1);
+    if (!f) {
+        pthread_mutex_unlock(&saveWriter_mutex);
+        return -1;
+    }
+
+    const uint8_t* src = f->pending ? f->pending : f->inflight;
+    size_t len = f->pending ? f->pending_len : f->inflight_len;
+    if (!for_writing && !src) {
+        pthread_mutex_unlock(&saveWriter_mutex);
+        return -1;
+    }
+
+    int slot = 0;
+    while (slot < SAVE_WRITER_FDS_MAX && saveWriter_fds[slot].used) slot++;
+    if (slot == SAVE_WRITER_FDS_MAX) {
+        pthread_mutex_unlock(&saveWriter_mutex);
+        debugPrintf("[SaveWriter] Out of fds for %s.\n", path);
+        return -1;
+    }
+
+    SaveWriterFd* s = &saveWriter_fds[slot];
+    memset(s, 0, sizeof(SaveWriterFd));
+    if (!for_writing && len > 0) {
+        // A copy, the commit may free the original any time.
+        s->data = malloc(len);
+        if (!s->data) {
+            pthread_mutex_unlock(&saveWriter_mutex);
+            errno = ENOMEM;
+            return -1;
+        }
+        memcpy(s->data, src, len);
+        s->len = s->cap = len;
+    }
+    s->used = 1;
+    s->writable = for_writing;
+    s->file = f;
+    pthread_mutex_unlock(&saveWriter_mutex);
+
+    return SAVE_WRITER_FD_BASE + slot;
+}
+
+int save_writer_is_fd(int fd) {
+    return fd >= SAVE_WRITER_FD_BASE && fd < SAVE_WRITER_FD_BASE + SAVE_WRITER_FDS_MAX;
+}
+
+int save_writer_read(int fd, void* buf, int len) {
+    SaveWriterFd* s = fd_get(fd);
+    if (!s) return -1;
+
+    if (len <= 0 || s->pos >= (int64_t)s->len) return 0;
+    if ((int64_t)len > (int64_t)s->len - s->pos) len = (int)(s->len - s->pos);
+
+    memcpy(buf, s->data + s->pos, len);
+    s->pos += len;
+    return len;
+}
+
+// Makes room for `size` bytes, zeroing whatever is new past s->len.
+static int reserve(SaveWriterFd* s, size_t size) {
+    if (size > s->cap) {
+        size_t cap = s->cap ? s->cap : 64 * 1024;
+        while (cap < size) cap *= 2;
+
+        uint8_t* data = realloc(s->data, cap);
+        if (!data) {
+            errno = ENOSPC;
+            return -1;
+        }
+        s->data = data;
+        s->cap = cap;
+    }
+    if (size > s->len) memset(s->data + s->len, 0, size - s->len);
+    return 0;
+}
+
+int save_writer_write(int fd, const void* buf, int len) {
+    SaveWriterFd* s = fd_get(fd);
+    if (!s) return -1;
+    if (!s->writable) {
+        errno = EBADF;
+        return -1;
+    }
+    if (len <= 0) return 0;
+
+    size_t end = (size_t)s->pos + len;
+    if (reserve(s, end) != 0) return -1;
+
+    memcpy(s->data + s->pos, buf, len);
+    s->pos = end;
+    if (end > s->len) s->len = end;
+    return len;
+}
+
+int64_t save_writer_lseek(int fd, int64_t offset, int whence) {
+    SaveWriterFd* s = fd_get(fd);
+    if (!s) return -1;
+
+    int64_t pos;
+    switch (whence) {
+        case SEEK_SET: pos = offset; break;
+        case SEEK_CUR: pos = s->pos + offset; break;
+        case SEEK_END: pos = (int64_t)s->len + offset; break;
+        default: pos = -1; break;
+    }
+
+    if (pos < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    s->pos = pos;
+    return pos;
+}
+
+int64_t save_writer_fsize(int fd) {
+    SaveWriterFd* s = fd_get(fd);
+    return s ? (int64_t)s->len : -1;
+}
+
+int save_writer_ftruncate(int fd, int64_t length) {
+    SaveWriterFd* s = fd_get(fd);
+    if (!s) return -1;
+    if (!s->writable || length < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (reserve(s, (size_t)length) != 0) return -1;
+    s->len = (size_t)length;
+    return 0;
+}
+
+int save_writer_close(int fd) {
+    SaveWriterFd* s = fd_get(fd);
+    if (!s) return -1;
+
+    pthread_mutex_lock(&saveWriter_mutex);
+    SaveWriterFile* f = s->file;
+    int submit = 0;
+
+    if (s->writable) {
+        free(f->pending);
+        // A save can be empty; keep it distinct from "nothing pending".
+        f->pending = s->data ? s->data : malloc(1);
+        f->pending_len = s->len;
+        s->data = NULL;
+
+        if (f->pending && !f->queued) {
+            f->queued = 1;
+            submit = 1;
+        }
+    }
+
+    free(s->data);
+    s->data = NULL;
+    s->used = 0;
+    pthread_mutex_unlock(&saveWriter_mutex);
+
+    // Without the pool, commit right here rather than not at all.
+    if (submit && io_pool_submit(IO_CLASS_SAVE, commit_job, f) != 0) {
+        commit_job(f);
+    }
+    return 0;
+}
+
+int save_writer_stat(const char* path, int64_t* size) {
+    if (!save_writer_is_save(path)) return 0;
+
+    pthread_mutex_lock(&saveWriter_mutex);
+    SaveWriterFile* f = file_get_locked(path, 0);
+    int ret = 0;
+    if (f && (f->pending || f->inflight)) {
+        *size = (int64_t)(f->pending ? f->pending_len : f->inflight_len);
+        ret = 1;
+    }
+    pthread_mutex_unlock(&saveWriter_mutex);
+
+    return ret;
+}
+
+// Queues a commit of what's pending if none is queued, i.e. retries one that
+// failed. Must be called with saveWriter_mutex held, which it drops
+// meanwhile.
+static void retry_locked(SaveWriterFile* f) {
+    if (!f->pending || f->queued) return;
+
+    f->queued = 1;
+    pthread_mutex_unlock(&saveWriter_mutex);
+    if (io_pool_submit(IO_CLASS_SAVE, commit_job, f) != 0) {
+        commit_job(f);
+    }
+    pthread_mutex_lock(&saveWriter_mutex);
+}
+
+void save_writer_flush(const char* path) {
+    pthread_mutex_lock(&saveWriter_mutex);
+    SaveWriterFile* f = file_get_locked(path, 0);
+    if (f) retry_locked(f);
+    while (f && f->queued) {
+        pthread_cond_wait(&saveWriter_committed, &saveWriter_mutex);
+    }
+    pthread_mutex_unlock(&saveWriter_mutex);
+}
+
+void save_writer_drop(const char* path) {
+    pthread_mutex_lock(&saveWriter_mutex);
+    SaveWriterFile* f = file_get_locked(path, 0);
+    while (f && f->queued) {
+        pthread_cond_wait(&saveWriter_committed, &saveWriter_mutex);
+    }
+    if (f) {
+        free(f->pending);
+        f->pending = NULL;
+    }
+    pthread_mutex_unlock(&saveWriter_mutex);
+}
+
+void save_writer_flush_all() {
+    pthread_mutex_lock(&saveWriter_mutex);
+    for (int i = 0; i < SAVE_WRITER_FILES_MAX; i++) {
+        SaveWriterFile* f = &saveWriter_files[i];
+        if (f->path) retry_locked(f);
+        while (f->path && f->queued) {
+            pthread_cond_wait(&saveWriter_committed, &saveWriter_mutex);
+        }
+    }
+    pthread_mutex_unlock(&saveWriter_mutex);
+}
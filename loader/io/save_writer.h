@@ -0,0 +1,80 @@
+/*
+ * io/save_writer.h
+ *
+ * Write-behind for save files. The game writes saves into memory through a
+ * virtual fd; closing it hands the data to the I/O pool, which commits it
+ * as one write to a temporary file, one fsync, a commit marker and a
+ * rename, so the game never waits for the memory card and a crash never
+ * leaves half a save.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_SAVE_WRITER_H
+#define SOLOADER_SAVE_WRITER_H
+
+#include <stdint.h>
+
+// Virtual fds start here, above the asset pack's.
+#define SAVE_WRITER_FD_BASE 0x20000
+#define SAVE_WRITER_FDS_MAX 16
+
+// Save paths whose state is kept; the game has a handful.
+#define SAVE_WRITER_FILES_MAX 32
+
+// Saves are committed to `path` SAVE_WRITER_TMP_SUFFIX, then renamed. The
+// marker next to it says the temporary file is complete.
+#define SAVE_WRITER_TMP_SUFFIX ".saving"
+#define SAVE_WRITER_MARKER_SUFFIX ".saved"
+#define SAVE_WRITER_MARKER_MAGIC 0x31435753 // "SWC1"
+
+// Directory levels below DATA_PATH searched for interrupted commits.
+#define SAVE_WRITER_RECOVER_DEPTH 4
+
+/*
+ * Finishes or rolls back the commits a crash or power loss interrupted, and
+ * flushes all saves at exit. Call before the game starts.
+ */
+void save_writer_init();
+
+// Whether `path` (translated) is one of the game's save files.
+int save_writer_is_save(const char* path);
+
+/*
+ * Opens save file `path`. For writing (the game always truncates), returns
+ * a virtual fd writing into memory. For reading, returns a virtual fd
+ * reading the data not committed yet, or -1 if everything is on the card
+ * and the file can be opened as usual.
+ */
+int save_writer_open(const char* path, int for_writing);
+
+int save_writer_is_fd(int fd);
+int save_writer_read(int fd, void* buf, int len);
+int save_writer_write(int fd, const void* buf, int len);
+int64_t save_writer_lseek(int fd, int64_t offset, int whence);
+int64_t save_writer_fsize(int fd);
+int save_writer_ftruncate(int fd, int64_t length);
+
+// Queues the data written for a commit, if the fd was opened for writing.
+int save_writer_close(int fd);
+
+// Size of `path` including data not committed yet. Returns 1 if there is
+// such data, 0 if the card is up to date.
+int save_writer_stat(const char* path, int64_t* size);
+
+// Waits until `path` is committed, e.g. before it's removed or renamed. A
+// save whose commit failed is kept in memory and tried again here.
+void save_writer_flush(const char* path);
+
+// Waits for a commit of `path` in progress, and forgets whatever is left
+// uncommitted, before it's removed.
+void save_writer_drop(const char* path);
+
+// Waits until every save is committed, e.g. before the Vita suspends,
+// trying failed commits again.
+void save_writer_flush_all();
+
+#endif // SOLOADER_SAVE_WRITER_H
@@ -0,0 +1,98 @@
+# jni_bindings.spec
+#
+# Java methods implemented by the fake JNI. tools/jni_bindgen.py turns this
+# into jni_bindings.h (ID-indexed dispatch table and name hash table) at
+# build time; see jni_specific.h for how they are used.
+#
+# Columns: id, class, name, signature, return type, handler.
+#
+#   id         Unique, 1..4095. Handlers receive it as their first argument.
+#   class      Declaring class. Several classes sharing one binding are
+#              separated by commas. Only matters for constructors, which are
+#              looked up as "class/<init>"; other methods are looked up by
+#              name alone, so a name may appear only once.
+#   signature  JNI signature, or * if unknown. In DEBUG builds, GetMethodID()
+#              warns when the game asks for a different one.
+#   type       void, int, long, float, double, boolean or object.
+#   handler    C function, see jni_specific.h for the prototypes.
+#
+# Copyright (C) 2022 Volodymyr Atamanenko
+#
+# This software may be modified and distributed under the terms
+# of the MIT license. See the LICENSE file for details.
+
+# Display, power, orientation
+100  com/ea/blast/MainActivity                      isContentReady               ()Z                     boolean  isContentReady
+101  com/ea/blast/PowerManagerAndroid               ApplyKeepAwake               *                       void     ApplyKeepAwake
+102  com/ea/blast/DisplayAndroidDelegate            GetStdOrientation            ()I                     int      GetStdOrientation
+103  com/ea/blast/DisplayAndroidDelegate            GetDefaultWidth              ()I                     int      GetDefaultWidth
+104  com/ea/blast/DisplayAndroidDelegate            GetDefaultHeight             ()I                     int      GetDefaultHeight
+105  com/ea/blast/DisplayAndroidDelegate            GetDpiX                      ()F                     float    GetDpiX
+106  com/ea/blast/DisplayAndroidDelegate            GetDpiY                      ()F                     float    GetDpiY
+107  com/ea/blast/GetAppDataDirectoryDelegate       GetAppDataDirectory          ()Ljava/lang/String;    object   GetAppDataDirectory
+108  com/ea/blast/GetAppDataDirectoryDelegate       GetExternalStorageDirectory  ()Ljava/lang/String;    object   GetExternalStorageDirectory
+109  com/ea/blast/DeviceOrientationHandlerAndroidDelegate  SetStdOrientation    *                       void     SetStdOrientation
+110  com/ea/blast/DeviceOrientationHandlerAndroidDelegate  OnLifeCycleFocusGained  *                    void     OnLifeCycleFocusGained
+111  com/ea/blast/AccelerometerAndroidDelegate,com/ea/blast/DeviceOrientationHandlerAndroidDelegate  SetEnabled  *  void  SetEnabled
+112  com/ea/blast/SystemAndroidDelegate             IsTouchScreenMultiTouch      ()Z                     boolean  IsTouchScreenMultiTouch
+113  com/eamobile/Query                             getVersion                   ()Ljava/lang/String;    object   getVersion
+114  com/eamobile/Query                             getTotalMemory               ()J                     long     getTotalMemory
+115  com/ea/blast/AccelerometerAndroidDelegate      SetUpdateFrequency           *                       void     SetUpdateFrequency
+
+# EAAudioCore
+116  android/media/AudioTrack                       play                         ()V                     void     EAAudioCore_AudioTrack_play
+117  android/media/AudioTrack                       stop                         ()V                     void     EAAudioCore_AudioTrack_stop
+118  android/media/AudioTrack                       write                        ([SII)I                 int      EAAudioCore_AudioTrack_write
+
+# Startup
+219  com/ea/EAIO/EAIO                               Startup                      (Landroid/content/res/AssetManager;)V  void    ea_EAIO_Startup
+220  com/ea/blast/MainActivity                      GetInstance                  ()Lcom/ea/blast/MainActivity;          object  ea_blast_MainActivity_GetInstance
+221  android/content/Context                        getAssets                    ()Landroid/content/res/AssetManager;   object  android_content_Context_getAssets
+
+# com/ea/blast/SystemAndroidDelegate
+300  com/ea/blast/SystemAndroidDelegate             GetAccelerometerCount        ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetAccelerometerCount
+301  com/ea/blast/SystemAndroidDelegate             IsBatteryStateAvailable      ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_IsBatteryStateAvailable
+302  com/ea/blast/SystemAndroidDelegate             GetCameraCount               ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetCameraCount
+303  com/ea/blast/SystemAndroidDelegate             GetChipset                   ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetChipset
+304  com/ea/blast/SystemAndroidDelegate             GetCompassCount              ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetCompassCount
+305  com/ea/blast/SystemAndroidDelegate             GetManufacturer              ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetManufacturer
+306  com/ea/blast/SystemAndroidDelegate             GetDeviceModel               ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetDeviceModel
+307  com/ea/blast/SystemAndroidDelegate             GetDeviceName                ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetDeviceName
+308  com/ea/blast/SystemAndroidDelegate             GetPhoneNumber               ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetPhoneNumber
+309  com/ea/blast/SystemAndroidDelegate             GetDeviceSubscriberID        ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetDeviceSubscriberID
+310  com/ea/blast/SystemAndroidDelegate             GetDeviceUniqueId            ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetDeviceUniqueId
+311  com/ea/blast/SystemAndroidDelegate             GetDisplayCount              ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetDisplayCount
+312  com/ea/blast/SystemAndroidDelegate             GetGyroscopeCount            ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetGyroscopeCount
+313  com/ea/blast/SystemAndroidDelegate             GetLocationAvailable         ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetLocationAvailable
+314  com/ea/blast/SystemAndroidDelegate             GetMicrophoneCount           ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetMicrophoneCount
+315  com/ea/blast/SystemAndroidDelegate             GetApiLevel                  ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetApiLevel
+316  com/ea/blast/SystemAndroidDelegate             GetPlatformRawName           ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetPlatformRawName
+317  com/ea/blast/SystemAndroidDelegate             GetPlatformStdName           ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetPlatformStdName
+318  com/ea/blast/SystemAndroidDelegate             GetPlatformVersion           ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetPlatformVersion
+319  com/ea/blast/SystemAndroidDelegate             GetPhysicalKeyboardCount     ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetPhysicalKeyboardCount
+320  com/ea/blast/SystemAndroidDelegate             GetProcessorArchitecture     ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetProcessorArchitecture
+321  com/ea/blast/SystemAndroidDelegate             GetLanguage                  ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetLanguage
+322  com/ea/blast/SystemAndroidDelegate             GetLocale                    ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetLocale
+323  com/ea/blast/SystemAndroidDelegate             GetTotalRAM                  ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetTotalRAM
+324  com/ea/blast/SystemAndroidDelegate             GetTouchPadCount             ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetTouchPadCount
+325  com/ea/blast/SystemAndroidDelegate             GetTouchScreenCount          ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetTouchScreenCount
+326  com/ea/blast/SystemAndroidDelegate             GetTrackBallCount            ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetTrackBallCount
+327  com/ea/blast/SystemAndroidDelegate             GetVibratorCount             ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetVibratorCount
+328  com/ea/blast/SystemAndroidDelegate             GetVirtualKeyboardCount      ()Ljava/lang/String;    object   ea_blast_SystemAndroidDelegate_GetVirtualKeyboardCount
+
+# Class constructors
+401  com/ea/blast/SystemAndroidDelegate             <init>  *  object  dummyConstructor
+402  com/ea/blast/PowerManagerAndroid               <init>  *  object  dummyConstructor
+403  com/ea/blast/DisplayAndroidDelegate            <init>  *  object  dummyConstructor
+404  com/ea/blast/DeviceOrientationHandlerAndroidDelegate  <init>  *  object  dummyConstructor
+405  com/ea/blast/GetAppDataDirectoryDelegate       <init>  *  object  dummyConstructor
+406  com/ea/blast/AccelerometerAndroidDelegate      <init>  *  object  dummyConstructor
+
+# AssetManager and java.io.InputStream
+600  java/io/InputStream                            read        ([BII)I                                                  int     InputStream_read
+601  java/io/InputStream                            close       ()V                                                      void    InputStream_close
+602  java/io/InputStream                            skip        (J)J                                                     long    InputStream_skip
+603  android/content/res/AssetManager               open        (Ljava/lang/String;)Ljava/io/InputStream;                object  InputStream_open
+604  android/content/res/AssetManager               openFd      (Ljava/lang/String;)Landroid/content/res/AssetFileDescriptor;  object  InputStream_openFd
+605  android/content/res/AssetManager               list        (Ljava/lang/String;)[Ljava/lang/String;                  object  InputStream_list
+606  android/content/res/AssetFileDescriptor        getLength   ()J                                                      long    InputStream_getLength
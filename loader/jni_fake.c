@@ -33,6 +33,11 @@
 //#include "android/AAssetManager_acquirer.h"
 
 #include "jni_specific.h"
+#include "jni_profiler.h"
+#include "jni_trace.h"
+#include "io/asset_index.h"
+#include "utils/arena.h"
+#include "utils/utf.h"
 
 #pragma ide diagnostic ignored "UnusedParameter"
 
@@ -40,13 +45,15 @@ struct JNIInvokeInterface *_jvm; // NOLINT(bugprone-reserved-identifier)
 struct JNINativeInterface *_jni; // NOLINT(bugprone-reserved-identifier)
 
 JavaVM jvm;
-JNIEnv jni;
 
 // VM functions:
 
 jint GetEnv(JavaVM *vm, void **env, jint version) {
     //debugPrintf("[JVM] GetEnv(vm, **env, version:%i)\n", version);
-    *env = &jni;
+    // A real VM would return JNI_EDETACHED for threads that were never
+    // attached. The game doesn't always attach its threads though, so we
+    // do it for them.
+    *env = jni_get_env();
     return JNI_OK;
 }
 
@@ -72,15 +79,201 @@ jclass FindClass (JNIEnv* env, const char* name) {
     return (jclass)clazz;
 }
 
+pthread_key_t jniThreadEnv_key;
+
+static void jni_thread_env_destroy(void * p) {
+    JniThreadEnv * te = p;
+    if (!te) return;
+
+    debugPrintf("[JNI] Thread 0x%x detached: %u local frames, %u local allocations, peak usage %u bytes\n",
+                te->thread_id, te->localFrames_pushed, te->localAllocs, te->localPeak);
+
+    arena_destroy(&te->localArena);
+    free(te);
+}
+
+static inline JniThreadEnv * jni_thread_env() {
+    JniThreadEnv * te = pthread_getspecific(jniThreadEnv_key);
+    if (te) return te;
+
+    te = calloc(1, sizeof(JniThreadEnv));
+    if (!te) {
+        fprintf(stderr, "[JNI][Env] thread env alloc failed! aborting.\n");
+        abort();
+    }
+    te->functions = _jni;
+    te->thread_id = sceKernelGetThreadId();
+    arena_init(&te->localArena, JNI_LOCAL_ARENA_BLOCK_SIZE);
+    pthread_setspecific(jniThreadEnv_key, te);
+
+    debugPrintf("[JNI] Thread 0x%x attached, env 0x%x\n", te->thread_id, (int)te);
+    return te;
+}
+
+JNIEnv * jni_get_env() {
+    return (JNIEnv *)jni_thread_env();
+}
+
+void jni_release_env() {
+    JniThreadEnv * te = pthread_getspecific(jniThreadEnv_key);
+    if (te) {
+        pthread_setspecific(jniThreadEnv_key, NULL);
+        jni_thread_env_destroy(te);
+    }
+}
+
+static inline void jni_local_update_peak(JniThreadEnv * te) {
+    JniLocalFrame * top = &te->localFrames[te->localFrames_depth - 1];
+    size_t used = te->localArena.used - top->mark.used;
+    if (used > top->peak) top->peak = used;
+    if (te->localArena.used > te->localPeak) te->localPeak = te->localArena.used;
+}
+
+void * jni_local_alloc(size_t size) {
+    JniThreadEnv * te = jni_thread_env();
+
+    if (te->localFrames_depth == 0) {
+        return malloc(size);
+    }
+
+    JniLocalHeader * hdr = arena_alloc(&te->localArena, sizeof(JniLocalHeader) + size);
+    if (!hdr) return NULL;
+
+    hdr->size = size;
+    te->localAllocs++;
+    jni_local_update_peak(te);
+    return (void *)(hdr + 1);
+}
+
+jboolean jni_is_local(const void * p) {
+    if (!p) return JNI_FALSE;
+    return arena_owns(&jni_thread_env()->localArena, p) ? JNI_TRUE : JNI_FALSE;
+}
+
+void jni_local_free(void * p) {
+    if (!p) return;
+
+    JniThreadEnv * te = jni_thread_env();
+    if (arena_owns(&te->localArena, p)) {
+        // Memory of the frame is released in PopLocalFrame(). If this happens
+        // to be the latest allocation though, we can give it back right away.
+        JniLocalHeader * hdr = (JniLocalHeader *)p - 1;
+        size_t sz = sizeof(JniLocalHeader) + hdr->size;
+        JniLocalFrame * top = &te->localFrames[te->localFrames_depth - 1];
+        if (te->localArena.used - top->mark.used >= sz) {
+            arena_pop(&te->localArena, hdr, sz);
+        }
+        return;
+    }
+
+    free(p);
+}
+
+jint PushLocalFrame(JNIEnv* env, jint capacity) {
+    debugPrintf("[JNI] PushLocalFrame(env, %i)\n", capacity);
+
+    JniThreadEnv * te = jni_thread_env();
+
+    if (te->localFrames_depth >= JNI_LOCAL_FRAMES_MAX) {
+        fprintf(stderr, "[JNI][PushLocalFrame] too many nested frames (%i)!\n", te->localFrames_depth);
+        return JNI_ERR;
+    }
+
+    JniLocalFrame * frame = &te->localFrames[te->localFrames_depth++];
+    frame->mark = arena_save(&te->localArena);
+    frame->peak = 0;
+    te->localFrames_pushed++;
+
+    return JNI_OK;
+}
+
+jobject PopLocalFrame(JNIEnv* env, jobject result) {
+    JniThreadEnv * te = jni_thread_env();
+
+    if (te->localFrames_depth == 0) {
+        debugPrintf("[JNI] PopLocalFrame(env, 0x%x): no frame to pop\n", (int)result);
+        return result;
+    }
+
+    JniLocalFrame * frame = &te->localFrames[--te->localFrames_depth];
+
+    // `result` has to survive the frame. Stash it aside before releasing the
+    // arena, then move it into the parent frame (or to the heap if there is
+    // none) unless it was already owned by an outer frame.
+    void * stash = NULL;
+    uint32_t result_size = 0;
+    if (result && arena_owns(&te->localArena, result)) {
+        result_size = ((JniLocalHeader *)result - 1)->size;
+        stash = malloc(result_size);
+        if (!stash) {
+            fprintf(stderr, "[JNI][PopLocalFrame] can't keep the result (%u bytes)!\n", result_size);
+            result = NULL;
+        } else {
+            memcpy(stash, result, result_size);
+        }
+    }
+
+    arena_restore(&te->localArena, frame->mark);
+
+    debugPrintf("[JNI] PopLocalFrame(env, 0x%x): frame #%i peak usage %u bytes\n",
+                (int)result, te->localFrames_depth, frame->peak);
+
+    if (te->localFrames_depth > 0) {
+        // Parent frame's peak includes whatever its children had allocated.
+        JniLocalFrame * parent = &te->localFrames[te->localFrames_depth - 1];
+        size_t child_peak = (frame->mark.used - parent->mark.used) + frame->peak;
+        if (child_peak > parent->peak) parent->peak = child_peak;
+    } else {
+        arena_reset(&te->localArena);
+    }
+
+    if (stash && !arena_owns(&te->localArena, result)) {
+        if (te->localFrames_depth > 0) {
+            JniLocalHeader * hdr = arena_alloc(&te->localArena, sizeof(JniLocalHeader) + result_size);
+            if (!hdr) {
+                fprintf(stderr, "[JNI][PopLocalFrame] can't move the result to the parent frame (%u bytes)!\n", result_size);
+                free(stash);
+                return NULL;
+            }
+            hdr->size = result_size;
+            memcpy(hdr + 1, stash, result_size);
+            free(stash);
+            result = (jobject)(hdr + 1);
+        } else {
+            result = (jobject)stash;
+        }
+        stash = NULL;
+    }
+
+    free(stash);
+
+    return result;
+}
+
 jobject NewGlobalRef(JNIEnv* env, jobject obj) {
     debugPrintf("[JNI] NewGlobalRef(env, 0x%x)\n", (int)obj);
+    return jni_global_ref(obj);
+}
 
+jobject jni_global_ref(jobject obj) {
     // As far as I understand, the concept of global/local references really
     // makes sense only on a real JVM. Here, since we basically operate with
     // shared global pointers everywhere, it should be safe to just return
-    // obj as a "Global Ref"
+    // obj as a "Global Ref"...
+    if (!jni_is_local(obj)) {
+        return obj;
+    }
 
-    return obj;
+    // ...unless it lives in a local frame and would be gone after the frame
+    // is popped. Such objects are moved to the heap.
+    uint32_t size = ((JniLocalHeader *)obj - 1)->size;
+    void * ret = malloc(size);
+    if (!ret) {
+        fprintf(stderr, "[JNI][NewGlobalRef] can't allocate %u bytes!\n", size);
+        return NULL;
+    }
+    memcpy(ret, obj, size);
+    return ret;
 }
 
 int dynamicallyAllocatedArrays_length = 0;
@@ -164,246 +357,446 @@ jboolean tryFreeDynamicallyAllocatedArray(const void * arr) {
 void DeleteGlobalRef(JNIEnv* env, jobject obj) {
     debugPrintf("[JNI] DeleteGlobalRef(env, 0x%x): ", (int)obj);
 
-    if (tryFreeDynamicallyAllocatedArray(obj) == JNI_FALSE) {
-        if (obj) free(obj);
+    if (jni_is_local(obj)) {
+        // Owned by a local frame, will be released together with it.
+        debugPrintf("local ref, skipped.\n");
+        return;
     }
 
-    debugPrintf("success.\n");
-}
+    if (jni_is_interned(obj)) {
+        debugPrintf("interned string, skipped.\n");
+        return;
+    }
 
-jobject NewObject(JNIEnv* env, jclass clazz, jmethodID _methodID, ...) {
-    debugPrintf("[JNI] NewObject(env, 0x%x, %i): ", clazz, _methodID);
+    if (InputStream_isHandle(obj)) {
+        // Stream slots are released by close().
+        debugPrintf("stream handle, skipped.\n");
+        return;
+    }
 
-    jobject ret;
-    va_list args;
-    va_start(args, _methodID);
-    ret = methodObjectCall((int)_methodID, args);
-    va_end(args);
+    if (asset_index_owns(obj)) {
+        // Paths returned by AssetManager.list() belong to the asset index.
+        debugPrintf("asset path, skipped.\n");
+        return;
+    }
 
-    return ret;
-}
+    if (tryFreeDynamicallyAllocatedArray(obj) == JNI_FALSE) {
+        if (obj) free(obj);
+    }
 
-jobject NewObjectV(JNIEnv* env, jclass clazz, jmethodID _methodID, va_list args) {
-    debugPrintf("[JNI] NewObjectV(env, 0x%x, %i): ", clazz, _methodID);
-    return methodObjectCall((int)_methodID, args);
+    debugPrintf("success.\n");
 }
 
-jobject NewObjectA(JNIEnv *env, jclass clazz, jmethodID _methodID, const jvalue *args) {
-    debugPrintf("[JNI] NewObjectA(env, 0x%x, %i): not implemented\n", (int)clazz, _methodID);
-    return NULL;
-}
+FakeJavaMethod jniMethods[JNI_METHODS_MAX];
+int jniMethods_count = 0;
+pthread_mutex_t jniMethods_mutex;
 
-jclass GetObjectClass(JNIEnv* env, jobject obj) {
-    debugPrintf("[JNI] GetObjectClass(0x%x)\n", (int)obj);
-    // Due to the way we implement class methods, it's safe to not waste
-    // resources on mapping objects to classess and return just a constant val.
-    return (void *)0x44444444;
-}
+// Parses a method signature like "(Ljava/lang/String;[BI)V" into `m`.
+// Returns 0 on success, -1 if the signature is malformed or has too many
+// arguments.
+static int jni_method_parse_signature(const char* sig, FakeJavaMethod* m) {
+    if (!sig || *sig != '(') return -1;
+    sig++;
 
-jmethodID GetMethodID(JNIEnv* env, jclass clazz, const char* name, const char* sig) {
-    debugPrintf("[JNI] GetMethodID(env, 0x%x, \"%s\", \"%s\"): ", (int)clazz, name, sig);
+    m->argc = 0;
+    m->strings = 0;
+    while (*sig && *sig != ')') {
+        if (m->argc >= JNI_METHOD_MAX_ARGS) return -1;
 
-    if (strcmp("<init>", name) == 0) {
-        // Class constructor. Get class name and prepend it to `name`
-        FakeJavaClass * clazz_fake = (FakeJavaClass *) clazz;
-        if (!clazz_fake) {
-            debugPrintf("Error! Fake class is not initialized.\n");
-            return NULL;
+        char t = *sig;
+        if (t == '[') {
+            while (*sig == '[') sig++;
+            if (*sig == 'L') {
+                while (*sig && *sig != ';') sig++;
+            }
+            if (!*sig) return -1;
+            t = 'L';
+        } else if (t == 'L') {
+            if (strncmp(sig, "Ljava/lang/String;", 18) == 0) {
+                m->strings |= (1u << m->argc);
+            }
+            while (*sig && *sig != ';') sig++;
+            if (!*sig) return -1;
+        } else if (!strchr("ZBCSIJFD", t)) {
+            return -1;
         }
-        debugPrintf("detected class constructor \"%s\" : ", clazz_fake->name);
 
-        char* name_new = malloc(256);
-        snprintf(name_new, 256, "%s/%s", clazz_fake->name, name);
-
-        return (jmethodID)getMethodIdByName(name_new);
+        m->args[m->argc++] = t;
+        sig++;
     }
 
-    return (jmethodID)getMethodIdByName(name);
-}
+    if (*sig != ')') return -1;
+    sig++;
 
-jmethodID GetStaticMethodID(JNIEnv* env, jclass clazz, const char* name, const char* sig) {
-    debugPrintf("[JNI] GetStaticMethodID(env, 0x%x, \"%s\", \"%s\"): ", (int)clazz, name, sig);
-    return (jmethodID)getMethodIdByName(name);
-}
+    if (strcmp(sig, "Ljava/lang/String;") == 0) {
+        m->strings |= JNI_METHOD_RET_STRING;
+    }
 
-jobject CallObjectMethod(JNIEnv* env, jobject clazz, jmethodID id, ...) {
-    debugPrintf("[JNI] CallObjectMethod(env, 0x%x, %i): ", (int)clazz, id);
+    m->ret = (*sig == '[') ? 'L' : *sig;
+    if (!m->ret || !strchr("ZBCSIJFDVL", m->ret)) return -1;
 
-    jobject ret;
-    va_list args;
-    va_start(args, id);
-    ret = methodObjectCall((int)id, args);
-    va_end(args);
-    return ret;
+    return 0;
 }
 
+// Returns a FakeJavaMethod for the method `id` with signature `sig`. The
+// same pointer is returned for the same (id, signature) pair.
+static jmethodID jni_method_get(int id, const char* sig) {
+    if (id == 0) return NULL;
 
-void CallVoidMethodV(JNIEnv* env, jobject clazz, jmethodID _methodID, va_list args) {
-    debugPrintf("[JNI] CallVoidMethodV(env, 0x%x, %i, args): ", (int)clazz, (int)_methodID);
-    methodVoidCall((int)_methodID, args);
-}
+    FakeJavaMethod m;
+    memset(&m, 0, sizeof(FakeJavaMethod));
+    m.id = id;
+    if (jni_method_parse_signature(sig, &m) != 0) {
+        fprintf(stderr, "[JNI] Can't parse method signature \"%s\" (id %i)!\n", sig, id);
+        return NULL;
+    }
 
-jobject CallObjectMethodV(JNIEnv* env, jobject obj, jmethodID _methodID, va_list args) {
-    debugPrintf("[JNI] CallObjectMethodV(env, 0x%x, %i, args): ", (int)obj, (int)_methodID);
-    return methodObjectCall((int)_methodID, args);
-}
+    jmethodID ret = NULL;
+    pthread_mutex_lock(&jniMethods_mutex);
 
-jboolean CallBooleanMethodV(JNIEnv* env, jobject obj, jmethodID _methodID, va_list args) {
-    debugPrintf("[JNI] CallStaticBooleanMethodV(env, 0x%x, %i, args): ", (int)obj, (int)_methodID);
-    return methodBooleanCall((int)_methodID, args);
-}
+    for (int i = 0; i < jniMethods_count; i++) {
+        if (memcmp(&jniMethods[i], &m, sizeof(FakeJavaMethod)) == 0) {
+            ret = (jmethodID)&jniMethods[i];
+            goto exit;
+        }
+    }
 
-jboolean CallStaticBooleanMethod(JNIEnv* env, jclass clazz, jmethodID _methodID, ...) {
-    debugPrintf("[JNI] CallStaticBooleanMethod(env, 0x%x, %i, ...): ", (int)clazz, (int)_methodID);
+    if (jniMethods_count >= JNI_METHODS_MAX) {
+        fprintf(stderr, "[JNI] Too many methods, increase JNI_METHODS_MAX!\n");
+        goto exit;
+    }
 
-    jboolean ret;
-    va_list args;
-    va_start(args, _methodID);
-    ret = methodBooleanCall((int)_methodID, args);
-    va_end(args);
+    jniMethods[jniMethods_count] = m;
+    ret = (jmethodID)&jniMethods[jniMethods_count++];
 
+exit:
+    pthread_mutex_unlock(&jniMethods_mutex);
     return ret;
 }
 
-jboolean CallStaticBooleanMethodV(JNIEnv* env, jclass clazz, jmethodID _methodID, va_list args) {
-    debugPrintf("[JNI] CallStaticBooleanMethodV(env, 0x%x, %i, args): ", (int)clazz, (int)_methodID);
-    return methodBooleanCall((int)_methodID, args);
-}
-
-jboolean CallStaticBooleanMethodA(JNIEnv* p1, jclass p2, jmethodID p3, const jvalue* p4) {
-    debugPrintf("[JNI] CallStaticBooleanMethodA(): not implemented\n");
-    return 0;
+static inline int jni_method_id(jmethodID methodID) {
+    return methodID ? ((const FakeJavaMethod *)methodID)->id : 0;
 }
 
-jlong CallLongMethodV(JNIEnv* env, jobject obj, jmethodID _methodID, va_list args) {
-    debugPrintf("[JNI] CallLongMethodV(env, 0x%x, %i, args): ", (int)obj, (int)_methodID);
-    return methodLongCall((int)_methodID, args);
+// Position of the method in jniMethods, -1 for NULL.
+static inline int jni_method_slot(jmethodID methodID) {
+    return methodID ? (int)((const FakeJavaMethod *)methodID - jniMethods) : -1;
 }
 
-jlong CallLongMethod(JNIEnv* env, jobject obj, jmethodID _methodID, ...) {
-    debugPrintf("[JNI] CallLongMethod(env, 0x%x, %i, ...): ", (int)obj, (int)_methodID);
+// Converts a va_list to the jvalue array as described by the signature.
+static void jni_method_marshal(jmethodID methodID, va_list va, jvalue* out) {
+    const FakeJavaMethod * m = (const FakeJavaMethod *)methodID;
+    if (!m) return;
 
-    jlong ret;
-    va_list args;
-    va_start(args, _methodID);
-    ret = methodLongCall((int)_methodID, args);
-    va_end(args);
+    for (int i = 0; i < m->argc; i++) {
+        switch (m->args[i]) {
+            case 'Z': out[i].z = (jboolean)va_arg(va, int); break;
+            case 'B': out[i].b = (jbyte)va_arg(va, int); break;
+            case 'C': out[i].c = (jchar)va_arg(va, int); break;
+            case 'S': out[i].s = (jshort)va_arg(va, int); break;
+            case 'I': out[i].i = va_arg(va, jint); break;
+            case 'J': out[i].j = va_arg(va, jlong); break;
+            // floats are promoted to double when passed through varargs
+            case 'F': out[i].f = (jfloat)va_arg(va, double); break;
+            case 'D': out[i].d = va_arg(va, double); break;
+            case 'L':
+            default: out[i].l = va_arg(va, jobject); break;
+        }
+    }
+}
 
+// All the Call<Type>Method{,V,A} families below end up in the A variant,
+// which passes the jvalue array straight to the handler from jni_specific.h.
+// Types that have no handler table of their own are served by the closest
+// one: byte, char and short by the int table, double by the float table.
+
+#define JNI_DEFINE_CALL_METHODS(Type, type, member, dispatch)                                            \
+type Call##Type##MethodA(JNIEnv* env, jobject obj, jmethodID methodID, const jvalue* args) {       \
+    debugPrintf("[JNI] Call" #Type "Method(env, 0x%x, %i): ", (int)obj, jni_method_id(methodID));  \
+    JNI_PROFILER_BEGIN(t);                                                                         \
+    type ret = (type)dispatch(jni_method_id(methodID), obj, args);                                 \
+    JNI_PROFILER_END(t, JNI_PROFILER_METHOD, jni_method_id(methodID));                             \
+    JNI_TRACE_CALL(JNI_TRACE_CALL_METHOD, methodID, args, member, ret);                            \
+    return ret;                                                                                    \
+}                                                                                                  \
+type Call##Type##MethodV(JNIEnv* env, jobject obj, jmethodID methodID, va_list va) {               \
+    jvalue args[JNI_METHOD_MAX_ARGS];                                                              \
+    jni_method_marshal(methodID, va, args);                                                        \
+    return Call##Type##MethodA(env, obj, methodID, args);                                          \
+}                                                                                                  \
+type Call##Type##Method(JNIEnv* env, jobject obj, jmethodID methodID, ...) {                       \
+    va_list va;                                                                                    \
+    va_start(va, methodID);                                                                        \
+    type ret = Call##Type##MethodV(env, obj, methodID, va);                                        \
+    va_end(va);                                                                                    \
+    return ret;                                                                                    \
+}                                                                                                  \
+type CallNonvirtual##Type##MethodA(JNIEnv* env, jobject obj, jclass clazz, jmethodID methodID,     \
+                                   const jvalue* args) {                                           \
+    return Call##Type##MethodA(env, obj, methodID, args);                                          \
+}                                                                                                  \
+type CallNonvirtual##Type##MethodV(JNIEnv* env, jobject obj, jclass clazz, jmethodID methodID,     \
+                                   va_list va) {                                                   \
+    return Call##Type##MethodV(env, obj, methodID, va);                                            \
+}                                                                                                  \
+type CallNonvirtual##Type##Method(JNIEnv* env, jobject obj, jclass clazz, jmethodID methodID, ...) { \
+    va_list va;                                                                                    \
+    va_start(va, methodID);                                                                        \
+    type ret = Call##Type##MethodV(env, obj, methodID, va);                                        \
+    va_end(va);                                                                                    \
+    return ret;                                                                                    \
+}                                                                                                  \
+type CallStatic##Type##MethodA(JNIEnv* env, jclass clazz, jmethodID methodID, const jvalue* args) { \
+    debugPrintf("[JNI] CallStatic" #Type "Method(env, 0x%x, %i): ", (int)clazz, jni_method_id(methodID)); \
+    JNI_PROFILER_BEGIN(t);                                                                         \
+    type ret = (type)dispatch(jni_method_id(methodID), NULL, args);                                \
+    JNI_PROFILER_END(t, JNI_PROFILER_METHOD, jni_method_id(methodID));                             \
+    JNI_TRACE_CALL(JNI_TRACE_CALL_STATIC_METHOD, methodID, args, member, ret);                     \
+    return ret;                                                                                    \
+}                                                                                                  \
+type CallStatic##Type##MethodV(JNIEnv* env, jclass clazz, jmethodID methodID, va_list va) {        \
+    jvalue args[JNI_METHOD_MAX_ARGS];                                                              \
+    jni_method_marshal(methodID, va, args);                                                        \
+    return CallStatic##Type##MethodA(env, clazz, methodID, args);                                  \
+}                                                                                                  \
+type CallStatic##Type##Method(JNIEnv* env, jclass clazz, jmethodID methodID, ...) {                \
+    va_list va;                                                                                    \
+    va_start(va, methodID);                                                                        \
+    type ret = CallStatic##Type##MethodV(env, clazz, methodID, va);                                \
+    va_end(va);                                                                                    \
+    return ret;                                                                                    \
+}
+
+JNI_DEFINE_CALL_METHODS(Object, jobject, l, methodObjectCall)
+JNI_DEFINE_CALL_METHODS(Boolean, jboolean, z, methodBooleanCall)
+JNI_DEFINE_CALL_METHODS(Byte, jbyte, b, methodIntCall)
+JNI_DEFINE_CALL_METHODS(Char, jchar, c, methodIntCall)
+JNI_DEFINE_CALL_METHODS(Short, jshort, s, methodIntCall)
+JNI_DEFINE_CALL_METHODS(Int, jint, i, methodIntCall)
+JNI_DEFINE_CALL_METHODS(Long, jlong, j, methodLongCall)
+JNI_DEFINE_CALL_METHODS(Float, jfloat, f, methodFloatCall)
+JNI_DEFINE_CALL_METHODS(Double, jdouble, d, methodDoubleCall)
+
+void CallVoidMethodA(JNIEnv* env, jobject obj, jmethodID methodID, const jvalue* args) {
+    debugPrintf("[JNI] CallVoidMethod(env, 0x%x, %i): ", (int)obj, jni_method_id(methodID));
+    JNI_PROFILER_BEGIN(t);
+    methodVoidCall(jni_method_id(methodID), obj, args);
+    JNI_PROFILER_END(t, JNI_PROFILER_METHOD, jni_method_id(methodID));
+    JNI_TRACE_CALL_VOID(JNI_TRACE_CALL_METHOD, methodID, args);
+}
+
+void CallVoidMethodV(JNIEnv* env, jobject obj, jmethodID methodID, va_list va) {
+    jvalue args[JNI_METHOD_MAX_ARGS];
+    jni_method_marshal(methodID, va, args);
+    CallVoidMethodA(env, obj, methodID, args);
+}
+
+void CallVoidMethod(JNIEnv* env, jobject obj, jmethodID methodID, ...) {
+    va_list va;
+    va_start(va, methodID);
+    CallVoidMethodV(env, obj, methodID, va);
+    va_end(va);
+}
+
+void CallNonvirtualVoidMethodA(JNIEnv* env, jobject obj, jclass clazz, jmethodID methodID, const jvalue* args) {
+    CallVoidMethodA(env, obj, methodID, args);
+}
+
+void CallNonvirtualVoidMethodV(JNIEnv* env, jobject obj, jclass clazz, jmethodID methodID, va_list va) {
+    CallVoidMethodV(env, obj, methodID, va);
+}
+
+void CallNonvirtualVoidMethod(JNIEnv* env, jobject obj, jclass clazz, jmethodID methodID, ...) {
+    va_list va;
+    va_start(va, methodID);
+    CallVoidMethodV(env, obj, methodID, va);
+    va_end(va);
+}
+
+void CallStaticVoidMethodA(JNIEnv* env, jclass clazz, jmethodID methodID, const jvalue* args) {
+    debugPrintf("[JNI] CallStaticVoidMethod(env, 0x%x, %i): ", (int)clazz, jni_method_id(methodID));
+    JNI_PROFILER_BEGIN(t);
+    methodVoidCall(jni_method_id(methodID), NULL, args);
+    JNI_PROFILER_END(t, JNI_PROFILER_METHOD, jni_method_id(methodID));
+    JNI_TRACE_CALL_VOID(JNI_TRACE_CALL_STATIC_METHOD, methodID, args);
+}
+
+void CallStaticVoidMethodV(JNIEnv* env, jclass clazz, jmethodID methodID, va_list va) {
+    jvalue args[JNI_METHOD_MAX_ARGS];
+    jni_method_marshal(methodID, va, args);
+    CallStaticVoidMethodA(env, clazz, methodID, args);
+}
+
+void CallStaticVoidMethod(JNIEnv* env, jclass clazz, jmethodID methodID, ...) {
+    va_list va;
+    va_start(va, methodID);
+    CallStaticVoidMethodV(env, clazz, methodID, va);
+    va_end(va);
+}
+
+jobject NewObjectA(JNIEnv *env, jclass clazz, jmethodID methodID, const jvalue *args) {
+    debugPrintf("[JNI] NewObject(env, 0x%x, %i): ", (int)clazz, jni_method_id(methodID));
+    JNI_PROFILER_BEGIN(t);
+    jobject ret = methodObjectCall(jni_method_id(methodID), NULL, args);
+    JNI_PROFILER_END(t, JNI_PROFILER_METHOD, jni_method_id(methodID));
+    JNI_TRACE_CALL(JNI_TRACE_NEW_OBJECT, methodID, args, l, ret);
     return ret;
 }
 
-jlong CallLongMethodA(JNIEnv* env, jobject obj, jmethodID _methodID, const jvalue* p4) {
-    debugPrintf("[JNI] CallLongMethodA(): not implemented\n");
-    return 0;
+jobject NewObjectV(JNIEnv* env, jclass clazz, jmethodID methodID, va_list va) {
+    jvalue args[JNI_METHOD_MAX_ARGS];
+    jni_method_marshal(methodID, va, args);
+    return NewObjectA(env, clazz, methodID, args);
 }
 
-jlong CallStaticLongMethod(JNIEnv* env, jclass clazz, jmethodID _methodID, ...) {
-    debugPrintf("[JNI] CallStaticLongMethod(env, 0x%x, %i, ...): ", (int)clazz, (int)_methodID);
-
-    jlong ret;
-    va_list args;
-    va_start(args, _methodID);
-    ret = methodLongCall((int)_methodID, args);
-    va_end(args);
-
+jobject NewObject(JNIEnv* env, jclass clazz, jmethodID methodID, ...) {
+    va_list va;
+    va_start(va, methodID);
+    jobject ret = NewObjectV(env, clazz, methodID, va);
+    va_end(va);
     return ret;
 }
 
-jlong CallStaticLongMethodV(JNIEnv* env, jclass clazz, jmethodID _methodID, va_list args) {
-    debugPrintf("[JNI] CallStaticLongMethodV(env, 0x%x, %i, args): ", (int)clazz, (int)_methodID);
-    return methodLongCall((int)_methodID, args);
+#ifdef JNI_PROFILER
+const char * jni_profiler_name(JniProfilerKind kind, int id) {
+    if (kind == JNI_PROFILER_METHOD) {
+        const JniBinding * b = jni_binding_get(id);
+        if (b) return b->name;
+    } else {
+        const FakeJavaField * field = fieldGet(id);
+        if (field) return field->name;
+    }
+    return NULL;
 }
+#endif
 
-jlong CallStaticLongMethodA(JNIEnv* env, jclass clazz, jmethodID _methodID, const jvalue* p4) {
-    debugPrintf("[JNI] CallStaticLongMethodA(): not implemented\n");
-    return 0;
+jclass GetObjectClass(JNIEnv* env, jobject obj) {
+    debugPrintf("[JNI] GetObjectClass(0x%x)\n", (int)obj);
+    // Due to the way we implement class methods, it's safe to not waste
+    // resources on mapping objects to classess and return just a constant val.
+    return (void *)0x44444444;
 }
 
-jint CallIntMethod(JNIEnv* env, jobject obj, jmethodID _methodID, ...) {
-    debugPrintf("[JNI] CallIntMethod(env, 0x%x, %i, ...): ", (int)obj, (int)_methodID);
+jmethodID GetMethodID(JNIEnv* env, jclass clazz, const char* name, const char* sig) {
+    debugPrintf("[JNI] GetMethodID(env, 0x%x, \"%s\", \"%s\"): ", (int)clazz, name, sig);
 
-    jint ret;
-    va_list args;
-    va_start(args, _methodID);
-    ret = methodIntCall((int)_methodID, args);
-    va_end(args);
+    if (strcmp("<init>", name) == 0) {
+        // Class constructor. Get class name and prepend it to `name`
+        FakeJavaClass * clazz_fake = (FakeJavaClass *) clazz;
+        if (!clazz_fake) {
+            debugPrintf("Error! Fake class is not initialized.\n");
+            return NULL;
+        }
+        debugPrintf("detected class constructor \"%s\" : ", clazz_fake->name);
 
-    return ret;
-}
-jint CallIntMethodV(JNIEnv* env, jobject obj, jmethodID _methodID, va_list args) {
-    //debugPrintf("[JNI] CallIntMethodV(env, 0x%x, %i, args): ", (int)obj, (int)_methodID);
-    return methodIntCall((int)_methodID, args);
-}
-jint CallIntMethodA(JNIEnv* env, jobject obj, jmethodID _methodID, const jvalue* p4) {
-    debugPrintf("[JNI] CallIntMethodA(): not implemented\n"); return 0;
-}
-jint CallStaticIntMethod(JNIEnv* env, jclass clazz, jmethodID _methodID, ...) {
-    debugPrintf("[JNI] CallStaticIntMethod(env, 0x%x, %i, ...): ", (int)clazz, (int)_methodID);
+        char name_new[256];
+        snprintf(name_new, sizeof(name_new), "%s/%s", clazz_fake->name, name);
 
-    jint ret;
-    va_list args;
-    va_start(args, _methodID);
-    ret = methodIntCall((int)_methodID, args);
-    va_end(args);
+        jmethodID ret = jni_method_get(getMethodIdByName(name_new, sig), sig);
+        JNI_TRACE_LOOKUP(JNI_TRACE_GET_METHOD_ID, jni_method_slot(ret), name_new, sig);
+        return ret;
+    }
 
+    jmethodID ret = jni_method_get(getMethodIdByName(name, sig), sig);
+    JNI_TRACE_LOOKUP(JNI_TRACE_GET_METHOD_ID, jni_method_slot(ret), name, sig);
     return ret;
 }
-jint CallStaticIntMethodV(JNIEnv* env, jclass clazz, jmethodID _methodID, va_list args) {
-    debugPrintf("[JNI] CallStaticIntMethodV(env, 0x%x, %i, args): ", (int)clazz, (int)_methodID);
-    return methodIntCall((int)_methodID, args);
-}
-jint CallStaticIntMethodA(JNIEnv* env, jclass clazz, jmethodID _methodID, const jvalue* p4) {
-    debugPrintf("[JNI] CallStaticIntMethodA(): not implemented\n"); return 0;
+
+jmethodID GetStaticMethodID(JNIEnv* env, jclass clazz, const char* name, const char* sig) {
+    debugPrintf("[JNI] GetStaticMethodID(env, 0x%x, \"%s\", \"%s\"): ", (int)clazz, name, sig);
+    jmethodID ret = jni_method_get(getMethodIdByName(name, sig), sig);
+    JNI_TRACE_LOOKUP(JNI_TRACE_GET_STATIC_METHOD_ID, jni_method_slot(ret), name, sig);
+    return ret;
 }
 
-jfloat CallFloatMethod(JNIEnv* env, jobject obj, jmethodID _methodID, ...) {
-    debugPrintf("[JNI] CallFloatMethod(env, 0x%x, %i, ...): ", (int)obj, (int)_methodID);
 
-    jfloat ret;
-    va_list args;
-    va_start(args, _methodID);
-    ret = methodFloatCall((int)_methodID, args);
-    va_end(args);
+arena jniInternedStrings_arena;
+const char * jniInternedStrings[JNI_INTERN_TABLE_SIZE];
+int jniInternedStrings_count = 0;
+pthread_mutex_t jniInternedStrings_mutex;
 
-    return ret;
-}
-jfloat CallFloatMethodV(JNIEnv* env, jobject obj, jmethodID _methodID, va_list args) {
-    debugPrintf("[JNI] CallFloatMethodV(env, 0x%x, %i, args): ", (int)obj, (int)_methodID);
-    return methodFloatCall((int)_methodID, args);
-}
-jfloat CallFloatMethodA(JNIEnv* env, jobject obj, jmethodID _methodID, const jvalue* p4) {
-    debugPrintf("[JNI] CallFloatMethodA(): not implemented\n"); return 0;
-}
-jfloat CallStaticFloatMethod(JNIEnv* env, jclass clazz, jmethodID _methodID, ...) {
-    debugPrintf("[JNI] CallStaticFloatMethod(env, 0x%x, %i, ...): ", (int)clazz, (int)_methodID);
+// How many times strings were passed to NewStringUTF() lately, by hash. Only
+// those seen often enough get interned; one-off strings are left alone. A
+// slot is taken over by the latest string that hashes to it.
+typedef struct {
+    uint32_t hash;
+    uint32_t count;
+} JniInternSeen;
 
-    jfloat ret;
-    va_list args;
-    va_start(args, _methodID);
-    ret = methodFloatCall((int)_methodID, args);
-    va_end(args);
+static JniInternSeen jniInternedStrings_seen[JNI_INTERN_SEEN_SLOTS];
+static uint32_t jniInternedStrings_lookups = 0;
 
-    return ret;
-}
-jfloat CallStaticFloatMethodV(JNIEnv* env, jclass clazz, jmethodID _methodID, va_list args) {
-    debugPrintf("[JNI] CallStaticFloatMethodV(env, 0x%x, %i, args): ", (int)clazz, (int)_methodID);
-    return methodFloatCall((int)_methodID, args);
-}
-jfloat CallStaticFloatMethodA(JNIEnv* env, jclass obj, jmethodID _methodID, const jvalue* p4) {
-    debugPrintf("[JNI] CallStaticFloatMethodA(): not implemented\n"); return 0;
+static inline uint32_t jniInternedStrings_hash(const char * str, size_t len) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)str[i];
+        h *= 16777619u;
+    }
+    return h;
 }
 
+// Returns the interned copy of `str`, creating it if the string has been
+// seen often enough and there is still room. Returns NULL otherwise.
+static const char * jniInternedStrings_get(const char * str, size_t len) {
+    if (len > JNI_INTERN_MAX_LENGTH) return NULL;
+
+    uint32_t mask = JNI_INTERN_TABLE_SIZE - 1;
+    uint32_t hash = jniInternedStrings_hash(str, len);
+    uint32_t i = hash & mask;
+    const char * ret = NULL;
 
+    pthread_mutex_lock(&jniInternedStrings_mutex);
 
+    // Linear probing. The table is kept at most 3/4 full, so there is
+    // always an empty slot to stop at.
+    while (jniInternedStrings[i]) {
+        if (memcmp(jniInternedStrings[i], str, len + 1) == 0) {
+            ret = jniInternedStrings[i];
+            goto exit;
+        }
+        i = (i + 1) & mask;
+    }
+
+    // Counts are halved every so often, so strings have to keep coming up
+    // to be interned rather than just add up over a long session.
+    if (++jniInternedStrings_lookups >= JNI_INTERN_SEEN_DECAY) {
+        jniInternedStrings_lookups = 0;
+        for (int j = 0; j < JNI_INTERN_SEEN_SLOTS; j++) jniInternedStrings_seen[j].count /= 2;
+    }
+
+    JniInternSeen * seen = &jniInternedStrings_seen[hash % JNI_INTERN_SEEN_SLOTS];
+    if (seen->hash != hash) {
+        seen->hash = hash;
+        seen->count = 0;
+    }
+    if (++seen->count < JNI_INTERN_MIN_SEEN) {
+        goto exit;
+    }
+
+    if (jniInternedStrings_count < JNI_INTERN_TABLE_SIZE / 4 * 3) {
+        char * copy = arena_alloc(&jniInternedStrings_arena, len + 1);
+        if (copy) {
+            memcpy(copy, str, len + 1);
+            jniInternedStrings[i] = copy;
+            jniInternedStrings_count++;
+            ret = copy;
+        }
+    }
 
-void CallStaticVoidMethodV(JNIEnv* env, jclass clazz, jmethodID _methodID, va_list args) {
-    debugPrintf("[JNI] CallStaticVoidMethodV(env, 0x%x, %i, args): ", (int)clazz, (int)_methodID);
-    methodVoidCall((int)_methodID, args);
+exit:
+    pthread_mutex_unlock(&jniInternedStrings_mutex);
+    return ret;
 }
 
-jobject CallStaticObjectMethodV(JNIEnv* env, jclass clazz, jmethodID _methodID, va_list args) {
-    debugPrintf("[JNI] CallStaticObjectMethodV(env, 0x%x, %i, args): ", (int)clazz, (int)_methodID);
-    return methodObjectCall((int)_methodID, args);
+jboolean jni_is_interned(const void * p) {
+    if (!p) return JNI_FALSE;
+
+    pthread_mutex_lock(&jniInternedStrings_mutex);
+    int ret = arena_owns(&jniInternedStrings_arena, p);
+    pthread_mutex_unlock(&jniInternedStrings_mutex);
+
+    return ret ? JNI_TRUE : JNI_FALSE;
 }
 
 jstring NewStringUTF(JNIEnv* env, const char* bytes) {
@@ -414,7 +807,20 @@ jstring NewStringUTF(JNIEnv* env, const char* bytes) {
         /* this shouldn't happen; throw NPE? */
         newStr = NULL;
     } else {
-        newStr = strdup(bytes);
+        size_t len = strlen(bytes);
+#ifdef DEBUG
+        if (!utf8_validate(bytes, len)) {
+            debugPrintf("[JNI][NewStringUTF] Warning: malformed UTF-8 string.\n");
+        }
+#endif
+        const char * interned = jniInternedStrings_get(bytes, len);
+        if (interned) {
+            return (jstring)interned;
+        }
+
+        len += 1;
+        newStr = jni_local_alloc(len);
+        if (newStr) memcpy(newStr, bytes, len);
         if (newStr == NULL) {
             /* assume memory failure */
             fprintf(stderr, "[JNI][NewStringUTF] native heap string alloc failed! aborting.\n");
@@ -425,8 +831,11 @@ jstring NewStringUTF(JNIEnv* env, const char* bytes) {
     return newStr;
 }
 
+// Strings up to this many UTF-16 units are converted on the stack by NewString().
+#define JNI_NEW_STRING_STACK_UNITS 256
+
 jstring NewString(JNIEnv* env, const jchar* chars, jsize char_count) {
-    debugPrintf("[JNI] NewString(env, \"%s\", %i)\n", (const char*)chars, char_count);
+    debugPrintf("[JNI] NewString(env, 0x%x, %i)\n", (int)chars, char_count);
 
     if (char_count < 0) {
         fprintf(stderr, "[JNI][NewString] char_count < 0: %d! aborting.\n", char_count);
@@ -439,14 +848,35 @@ jstring NewString(JNIEnv* env, const jchar* chars, jsize char_count) {
         return NULL;
     }
 
-    char* newStr = malloc(char_count+1);
-    strncpy(newStr, (const char*)chars, char_count+1);
+    // No unit takes more than three bytes, so the string is converted into
+    // a buffer that size first, on the stack when it's short; that saves
+    // going over it once more just to measure it.
+    char stack_buf[JNI_NEW_STRING_STACK_UNITS * 3];
+    char* buf = stack_buf;
+    if (char_count > JNI_NEW_STRING_STACK_UNITS) {
+        buf = malloc((size_t)char_count * 3);
+        if (buf == NULL) {
+            fprintf(stderr, "[JNI][NewString] native heap string alloc failed! aborting.\n");
+            abort();
+        }
+    }
+    size_t len = utf16_to_utf8(chars, char_count, buf);
+
+    char* newStr = jni_local_alloc(len + 1);
+    if (newStr == NULL) {
+        fprintf(stderr, "[JNI][NewString] native heap string alloc failed! aborting.\n");
+        abort();
+    }
+
+    memcpy(newStr, buf, len);
+    newStr[len] = '\0';
+    if (buf != stack_buf) free(buf);
     return newStr;
 }
 
 jbyteArray NewByteArray(JNIEnv* env, jsize length) {
     debugPrintf("[JNI] NewByteArray(env, size:%i)\n", length);
-    char* ret = malloc(length);
+    char* ret = jni_local_alloc(length);
     return ret;
 }
 
@@ -456,22 +886,12 @@ jbyteArray NewByteArray(JNIEnv* env, jsize length) {
 const char* GetStringUTFChars(JNIEnv* env, jstring string, jboolean* isCopy) {
     debugPrintf("[JNI] GetStringUTFChars(env, \"%s\", *isCopy)\n", string);
 
-    char* newStr;
-    if (string == NULL) {
-        /* this shouldn't happen; throw NPE? */
-        newStr = NULL;
-    } else {
-        if (isCopy != NULL)
-            *isCopy = JNI_TRUE;
-        newStr = strdup(string);
-        if (newStr == NULL) {
-            /* assume memory failure */
-            fprintf(stderr, "[JNI][GetStringUTFChars] native heap string alloc failed! aborting.\n");
-            abort();
-        }
-    }
+    // Our jstrings are immutable, null-terminated UTF-8 already, so there is
+    // no need to copy them.
+    if (isCopy != NULL)
+        *isCopy = JNI_FALSE;
 
-    return newStr;
+    return string;
 }
 
 jsize GetStringUTFLength(JNIEnv* env, jstring string) {
@@ -486,16 +906,19 @@ jsize GetStringUTFLength(JNIEnv* env, jstring string) {
 
 void ReleaseStringUTFChars(JNIEnv* env, jstring string, char* chars) {
     debugPrintf("[JNI] ReleaseStringUTFChars(env, 0x%x, \"%s\")\n", (int)string, chars);
-    if (chars) {
-        free(chars);
+    if (chars && chars != string && !jni_is_interned(chars)) {
+        jni_local_free(chars);
     }
 }
 
 void DeleteLocalRef(JNIEnv* env, jobject obj) {
     debugPrintf("[JNI] DeleteLocalRef(env, 0x%x)\n", (int)obj);
-    if (obj) {
-        //free(obj);
+    if (jni_is_local(obj)) {
+        // Gives the memory back only if it was the latest allocation in the
+        // current frame, the rest waits for PopLocalFrame().
+        jni_local_free(obj);
     }
+    // Heap objects may still be referenced from elsewhere, don't free them.
 }
 
 jint GetJavaVM(JNIEnv* env, JavaVM** vm) {
@@ -519,20 +942,41 @@ jclass DefineClass (JNIEnv* env, const char* name, jobject obj, const jbyte* byt
     return 0;
 }
 
+// None of our fake methods throw, but the game may raise exceptions on its
+// own with Throw()/ThrowNew(). Those stay pending on the calling thread
+// until cleared.
+
+jint Throw(JNIEnv* env, jthrowable obj) {
+    debugPrintf("[JNI] Throw(env, 0x%x)\n", (int)obj);
+    jni_thread_env()->pendingException = obj;
+    return JNI_OK;
+}
+
+jint ThrowNew(JNIEnv* env, jclass clazz, const char* message) {
+    FakeJavaClass * clazz_fake = (FakeJavaClass *) clazz;
+    debugPrintf("[JNI] ThrowNew(env, \"%s\", \"%s\")\n", clazz_fake ? clazz_fake->name : "?", message);
+    // The class is the closest thing to a throwable object we have.
+    jni_thread_env()->pendingException = (jthrowable)clazz;
+    return JNI_OK;
+}
+
 jthrowable ExceptionOccurred(JNIEnv* env) {
     debugPrintf("[JNI] ExceptionOccurred(env)\n");
-    // We never have exceptions.
-    return NULL;
+    return jni_thread_env()->pendingException;
 }
 
 void ExceptionDescribe(JNIEnv* env) {
-    debugPrintf("[JNI] ExceptionDescribe(env)\n");
-    // We never have exceptions.
+    jthrowable e = jni_thread_env()->pendingException;
+    debugPrintf("[JNI] ExceptionDescribe(env): 0x%x\n", (int)e);
 }
 
 void ExceptionClear(JNIEnv* env) {
     debugPrintf("[JNI] ExceptionClear(env)\n");
-    // We never have exceptions.
+    jni_thread_env()->pendingException = NULL;
+}
+
+jboolean ExceptionCheck(JNIEnv* env) {
+    return jni_thread_env()->pendingException ? JNI_TRUE : JNI_FALSE;
 }
 
 jsize GetArrayLength(JNIEnv* env, jarray array) {
@@ -584,57 +1028,145 @@ void GetByteArrayRegion(JNIEnv* env, jbyteArray array, jsize start, jsize length
     memcpy(buffer, (jbyte*)array + start, length);
 }
 
-jint PushLocalFrame(JNIEnv* env, jint capacity) {
-    debugPrintf("[JNI] PushLocalFrame(env, %i)\n", capacity);
-    // Since we operate with global pointers everywhere, no need to scope them.
-    return 0;
-}
-
-jobject PopLocalFrame(JNIEnv* env, jobject result) {
-    debugPrintf("[JNI] PopLocalFrame(env, 0x%x)\n", (int)result);
-    // Since we operate with global pointers everywhere, no need to scope them.
-    return NULL;
-}
-
 jfieldID GetFieldID(JNIEnv * env, jclass clazz, const char* name, const char* t) {
     debugPrintf("[JNI] GetFieldID(env, 0x%x, \"%s\", \"%s\"): ", (int)clazz, name, t);
-    return (jfieldID)getFieldIdByName(name);
+    int ret = getFieldIdByName(name);
+    JNI_TRACE_LOOKUP(JNI_TRACE_GET_FIELD_ID, ret, name, t);
+    return (jfieldID)ret;
 }
 
 jfieldID GetStaticFieldID(JNIEnv* env, jclass clazz, const char* name, const char* t) {
     debugPrintf("[JNI] GetStaticFieldID(env, 0x%x, \"%s\", \"%s\"): ", (int)clazz, name, t);
-    return (jfieldID)getFieldIdByName(name);
+    int ret = getFieldIdByName(name);
+    JNI_TRACE_LOOKUP(JNI_TRACE_GET_STATIC_FIELD_ID, ret, name, t);
+    return (jfieldID)ret;
 }
 
 jobject GetStaticObjectField(JNIEnv* env, jclass clazz, jfieldID id) {
     debugPrintf("[JNI] GetStaticObjectField(env, 0x%x, %i): ", (int)clazz, (int)id);
-    return getObjectFieldValueById((int)id);
+    JNI_PROFILER_BEGIN(t);
+    jobject ret = getObjectFieldValueById((int)id);
+    JNI_PROFILER_END(t, JNI_PROFILER_FIELD, (int)id);
+    JNI_TRACE_FIELD(JNI_TRACE_GET_STATIC_OBJECT_FIELD, (int)id, 'L', l, ret);
+    return ret;
 }
 
 jobject GetObjectField(JNIEnv* env, jobject obj, jfieldID id) {
     debugPrintf("[JNI] GetObjectField(env, 0x%x, %i): ", (int)obj, (int)id);
-    return getObjectFieldValueById((int)id);
+    JNI_PROFILER_BEGIN(t);
+    jobject ret = getObjectFieldValueById((int)id);
+    JNI_PROFILER_END(t, JNI_PROFILER_FIELD, (int)id);
+    JNI_TRACE_FIELD(JNI_TRACE_GET_OBJECT_FIELD, (int)id, 'L', l, ret);
+    return ret;
 }
 
 jint GetIntField(JNIEnv* env, jobject obj, jfieldID id) {
     debugPrintf("[JNI] GetIntField(env, 0x%x, %i): ", (int)obj, (int)id);
-    return getIntFieldValueById((int)id);
+    JNI_PROFILER_BEGIN(t);
+    jint ret = getIntFieldValueById((int)id);
+    JNI_PROFILER_END(t, JNI_PROFILER_FIELD, (int)id);
+    JNI_TRACE_FIELD(JNI_TRACE_GET_INT_FIELD, (int)id, 'I', i, ret);
+    return ret;
 }
 
 jboolean GetBooleanField(JNIEnv* env, jobject obj, jfieldID id) {
     debugPrintf("[JNI] GetBooleanField(env, 0x%x, %i): ", (int)obj, (int)id);
-    return getBooleanFieldValueById((int)id);
+    JNI_PROFILER_BEGIN(t);
+    jboolean ret = getBooleanFieldValueById((int)id);
+    JNI_PROFILER_END(t, JNI_PROFILER_FIELD, (int)id);
+    JNI_TRACE_FIELD(JNI_TRACE_GET_BOOLEAN_FIELD, (int)id, 'Z', z, ret);
+    return ret;
+}
+
+jint GetStaticIntField(JNIEnv* env, jclass clazz, jfieldID id) {
+    debugPrintf("[JNI] GetStaticIntField(env, 0x%x, %i): ", (int)clazz, (int)id);
+    JNI_PROFILER_BEGIN(t);
+    jint ret = getIntFieldValueById((int)id);
+    JNI_PROFILER_END(t, JNI_PROFILER_FIELD, (int)id);
+    JNI_TRACE_FIELD(JNI_TRACE_GET_INT_FIELD, (int)id, 'I', i, ret);
+    return ret;
+}
+
+jboolean GetStaticBooleanField(JNIEnv* env, jclass clazz, jfieldID id) {
+    debugPrintf("[JNI] GetStaticBooleanField(env, 0x%x, %i): ", (int)clazz, (int)id);
+    JNI_PROFILER_BEGIN(t);
+    jboolean ret = getBooleanFieldValueById((int)id);
+    JNI_PROFILER_END(t, JNI_PROFILER_FIELD, (int)id);
+    JNI_TRACE_FIELD(JNI_TRACE_GET_BOOLEAN_FIELD, (int)id, 'Z', z, ret);
+    return ret;
+}
+
+void SetObjectField(JNIEnv* env, jobject obj, jfieldID id, jobject value) {
+    debugPrintf("[JNI] SetObjectField(env, 0x%x, %i, 0x%x): ", (int)obj, (int)id, (int)value);
+    setObjectFieldValueById((int)id, value);
+}
+
+void SetStaticObjectField(JNIEnv* env, jclass clazz, jfieldID id, jobject value) {
+    debugPrintf("[JNI] SetStaticObjectField(env, 0x%x, %i, 0x%x): ", (int)clazz, (int)id, (int)value);
+    setObjectFieldValueById((int)id, value);
+}
+
+void SetIntField(JNIEnv* env, jobject obj, jfieldID id, jint value) {
+    debugPrintf("[JNI] SetIntField(env, 0x%x, %i): ", (int)obj, (int)id);
+    setIntFieldValueById((int)id, value);
+}
+
+void SetStaticIntField(JNIEnv* env, jclass clazz, jfieldID id, jint value) {
+    debugPrintf("[JNI] SetStaticIntField(env, 0x%x, %i): ", (int)clazz, (int)id);
+    setIntFieldValueById((int)id, value);
+}
+
+void SetBooleanField(JNIEnv* env, jobject obj, jfieldID id, jboolean value) {
+    debugPrintf("[JNI] SetBooleanField(env, 0x%x, %i): ", (int)obj, (int)id);
+    setBooleanFieldValueById((int)id, value);
+}
+
+void SetStaticBooleanField(JNIEnv* env, jclass clazz, jfieldID id, jboolean value) {
+    debugPrintf("[JNI] SetStaticBooleanField(env, 0x%x, %i): ", (int)clazz, (int)id);
+    setBooleanFieldValueById((int)id, value);
 }
 
 jint AttachCurrentThread(JavaVM* vm, JNIEnv **p_env, void *thr_args) {
     debugPrintf("[JVM] AttachCurrentThread(vm, *p_env, *thr_args)\n");
-    *p_env = &jni;
+    *p_env = jni_get_env();
+    return 0;
+}
+
+jint DetachCurrentThread(JavaVM* vm) {
+    debugPrintf("[JVM] DetachCurrentThread(vm)\n");
+    jni_release_env();
+    return 0;
+}
+
+jint AttachCurrentThreadAsDaemon(JavaVM* vm, JNIEnv** p_env, void* thr_args) {
+    debugPrintf("[JVM] AttachCurrentThreadAsDaemon(vm, *p_env, *thr_args)\n");
+    *p_env = jni_get_env();
     return 0;
 }
 
 jsize GetStringLength(JNIEnv *env, jstring string) {
     debugPrintf("[JNI] GetStringLength(env, 0x%x/\"%s\")\n", string, string);
-    return (jsize)strlen(string);
+
+    if (!string) return 0;
+    return (jsize)utf8_utf16_length(string, strlen(string));
+}
+
+// Shared by GetStringChars() and GetStringCritical().
+static jchar * jni_string_to_utf16(jstring string) {
+    size_t len = strlen(string);
+
+    // No UTF-8 byte makes more than one UTF-16 unit, so there's no need to
+    // count the units before converting. Not a local ref: it lives until the
+    // Release call, which may come after the local frame is popped.
+    jchar * ret = malloc((len + 1) * sizeof(jchar));
+    if (!ret) {
+        fprintf(stderr, "[JNI][GetStringChars] native heap string alloc failed! aborting.\n");
+        abort();
+    }
+
+    size_t units = utf8_to_utf16(string, len, ret, len);
+    ret[units] = 0;
+    return ret;
 }
 
 const jchar * GetStringChars(JNIEnv *env, jstring string, jboolean *isCopy) {
@@ -649,7 +1181,7 @@ const jchar * GetStringChars(JNIEnv *env, jstring string, jboolean *isCopy) {
         *isCopy = JNI_TRUE;
     }
 
-    return (const jchar *)strdup((const char*)string);
+    return jni_string_to_utf16(string);
 }
 
 void ReleaseStringChars(JNIEnv *env, jstring string, const jchar *chars) {
@@ -660,17 +1192,125 @@ void ReleaseStringChars(JNIEnv *env, jstring string, const jchar *chars) {
         return;
     }
 
-    free((char*)chars);
+    free((void *)chars);
 }
 
-jint MonitorEnter(JNIEnv* p1, jobject p2) {
-    debugPrintf("[JNI] MonitorEnter(env, 0x%x): ignored\n", (int)p2);
-    return 0;
+const jchar * GetStringCritical(JNIEnv *env, jstring string, jboolean *isCopy) {
+    debugPrintf("[JNI] GetStringCritical(env, 0x%x/\"%s\", *isCopy)\n", string, string);
+
+    if (!string) {
+        fprintf(stderr, "[JNI][GetStringCritical] Error: string is null.\n");
+        return NULL;
+    }
+
+    if (isCopy != NULL) {
+        *isCopy = JNI_TRUE;
+    }
+
+    return jni_string_to_utf16(string);
 }
 
-jint MonitorExit(JNIEnv* p1, jobject p2) {
-    debugPrintf("[JNI] MonitorExit(env, 0x%x): ignored\n", (int)p2);
-    return 0;
+void ReleaseStringCritical(JNIEnv *env, jstring string, const jchar *chars) {
+    debugPrintf("[JNI] ReleaseStringCritical(env, 0x%x/\"%s\", 0x%x)\n", string, string, chars);
+
+    if (chars) {
+        free((void *)chars);
+    }
+}
+
+void GetStringRegion(JNIEnv *env, jstring string, jsize start, jsize len, jchar *buf) {
+    debugPrintf("[JNI] GetStringRegion(env, 0x%x/\"%s\", %i, %i, 0x%x)\n", string, string, start, len, buf);
+
+    if (!string || !buf || start < 0 || len <= 0) return;
+
+    size_t str_len = strlen(string);
+    size_t offset = utf8_utf16_offset(string, str_len, start);
+    utf8_to_utf16(string + offset, str_len - offset, buf, len);
+}
+
+void GetStringUTFRegion(JNIEnv *env, jstring string, jsize start, jsize len, char *buf) {
+    debugPrintf("[JNI] GetStringUTFRegion(env, 0x%x/\"%s\", %i, %i, 0x%x)\n", string, string, start, len, buf);
+
+    if (!string || !buf || start < 0 || len < 0) return;
+
+    // `start` and `len` are in UTF-16 units, but our strings are UTF-8
+    // already, so it is enough to find the matching byte range.
+    size_t str_len = strlen(string);
+    size_t from = utf8_utf16_offset(string, str_len, start);
+    size_t to = from + utf8_utf16_offset(string + from, str_len - from, len);
+
+    memcpy(buf, string + from, to - from);
+    buf[to - from] = '\0';
+}
+
+typedef struct {
+    int owner;          // thread ID, 0 if free
+    uint32_t depth;     // only touched by the owner
+    uint32_t contended;
+} __attribute__((aligned(32))) JniMonitor; // one per cache line
+
+JniMonitor jniMonitors[JNI_MONITOR_STRIPES];
+
+static inline JniMonitor * jni_monitor_get(jobject obj) {
+    uint32_t h = (uint32_t)(uintptr_t)obj;
+    // Objects are at least 8-aligned, the low bits carry nothing.
+    h = (h >> 3) * 2654435761u;
+    return &jniMonitors[(h >> 24) & (JNI_MONITOR_STRIPES - 1)];
+}
+
+uint32_t jni_monitor_contention(int stripe) {
+    return __atomic_load_n(&jniMonitors[stripe].contended, __ATOMIC_RELAXED);
+}
+
+jint MonitorEnter(JNIEnv* env, jobject obj) {
+    debugPrintf("[JNI] MonitorEnter(env, 0x%x)\n", (int)obj);
+
+    JniMonitor * m = jni_monitor_get(obj);
+    int self = sceKernelGetThreadId();
+
+    int expected = 0;
+    if (__atomic_compare_exchange_n(&m->owner, &expected, self, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        m->depth = 1;
+        return JNI_OK;
+    }
+
+    if (expected == self) {
+        m->depth++;
+        return JNI_OK;
+    }
+
+    __atomic_fetch_add(&m->contended, 1, __ATOMIC_RELAXED);
+
+    for (int spins = 0;; spins++) {
+        expected = 0;
+        if (__atomic_load_n(&m->owner, __ATOMIC_RELAXED) == 0 &&
+            __atomic_compare_exchange_n(&m->owner, &expected, self, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            m->depth = 1;
+            return JNI_OK;
+        }
+        if (spins >= JNI_MONITOR_SPINS) {
+            sceKernelDelayThread(JNI_MONITOR_SLEEP_US);
+        }
+    }
+}
+
+jint MonitorExit(JNIEnv* env, jobject obj) {
+    debugPrintf("[JNI] MonitorExit(env, 0x%x)\n", (int)obj);
+
+    JniMonitor * m = jni_monitor_get(obj);
+
+    if (__atomic_load_n(&m->owner, __ATOMIC_RELAXED) != sceKernelGetThreadId()) {
+        // IllegalMonitorStateException on a real VM.
+        debugPrintf("[JNI] MonitorExit(env, 0x%x): not the owner!\n", (int)obj);
+        return JNI_ERR;
+    }
+
+    if (--m->depth == 0) {
+        __atomic_store_n(&m->owner, 0, __ATOMIC_RELEASE);
+    }
+    return JNI_OK;
 }
 
 
@@ -680,17 +1320,12 @@ jchar        GetCharField(JNIEnv* p1, jobject p2, jfieldID p3) { debugPrintf("[J
 jshort       GetShortField(JNIEnv* p1, jobject p2, jfieldID p3) { debugPrintf("[JNI] GetShortField(): not implemented\n"); return 0; }
 jfloat       GetFloatField(JNIEnv* p1, jobject p2, jfieldID p3) { debugPrintf("[JNI] GetFloatField(): not implemented\n"); return 0; }
 jdouble      GetDoubleField(JNIEnv* p1, jobject p2, jfieldID p3) { debugPrintf("[JNI] GetDoubleField(): not implemented\n"); return 0; }
-void         SetObjectField(JNIEnv* p1, jobject p2, jfieldID p3, jobject p4) { debugPrintf("[JNI] SetObjectField(): not implemented\n"); }
-void         SetBooleanField(JNIEnv* p1, jobject p2, jfieldID p3, jboolean p4) { debugPrintf("[JNI] SetBooleanField(): not implemented\n"); }
 void         SetByteField(JNIEnv* p1, jobject p2, jfieldID p3, jbyte p4) { debugPrintf("[JNI] SetByteField(): not implemented\n"); }
 void         SetCharField(JNIEnv* p1, jobject p2, jfieldID p3, jchar p4) { debugPrintf("[JNI] SetCharField(): not implemented\n"); }
 void         SetShortField(JNIEnv* p1, jobject p2, jfieldID p3, jshort p4) { debugPrintf("[JNI] SetShortField(): not implemented\n"); }
-void         SetIntField(JNIEnv* p1, jobject p2, jfieldID p3, jint p4) { debugPrintf("[JNI] SetIntField(): not implemented\n"); }
 void         SetLongField(JNIEnv* p1, jobject p2, jfieldID p3, jlong p4) { debugPrintf("[JNI] SetLongField(): not implemented\n"); }
 void         SetFloatField(JNIEnv* p1, jobject p2, jfieldID p3, jfloat p4) { debugPrintf("[JNI] SetFloatField(): not implemented\n"); }
 void         SetDoubleField(JNIEnv* p1, jobject p2, jfieldID p3, jdouble p4) { debugPrintf("[JNI] SetDoubleField(): not implemented\n"); }
-jobject      CallStaticObjectMethod(JNIEnv* p1, jclass p2, jmethodID p4, ...) { debugPrintf("[JNI] CallStaticObjectMethod(): not implemented\n"); return 0; }
-jobject      CallStaticObjectMethodA(JNIEnv* p1, jclass p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallStaticObjectMethodA(): not implemented\n"); return 0; }
 jboolean     IsSameObject(JNIEnv* p1, jobject p2, jobject p3) { debugPrintf("[JNI] IsSameObject(): not implemented\n"); return 0; }
 jobject      NewLocalRef(JNIEnv* p1, jobject p2) { debugPrintf("[JNI] NewLocalRef(): not implemented\n"); return 0; }
 jint         EnsureLocalCapacity(JNIEnv* p1, jint p2) { debugPrintf("[JNI] EnsureLocalCapacity(): not implemented\n"); return 0; }
@@ -701,85 +1336,17 @@ jobject      ToReflectedMethod(JNIEnv* p1, jclass p2, jmethodID p3, jboolean p4)
 jclass       GetSuperclass(JNIEnv* p1, jclass p2) { debugPrintf("[JNI] GetSuperclass(): not implemented\n"); return 0; }
 jboolean     IsAssignableFrom(JNIEnv* p1, jclass p2, jclass p3) { debugPrintf("[JNI] IsAssignableFrom(): not implemented\n"); return 0; }
 jobject      ToReflectedField(JNIEnv* p1, jclass p2, jfieldID p3, jboolean p4) { debugPrintf("[JNI] ToReflectedField(): not implemented\n"); return 0; }
-jint         Throw(JNIEnv* p1, jthrowable p2) { debugPrintf("[JNI] Throw(): not implemented\n"); return 0; }
-jint         ThrowNew(JNIEnv * p1, jclass p2, const char * p3) { debugPrintf("[JNI] ThrowNew(): not implemented\n"); return 0; }
 void         FatalError(JNIEnv* p1, const char* p2) { debugPrintf("[JNI] FatalError(): not implemented\n"); }
 jboolean     IsInstanceOf(JNIEnv* p1, jobject p2, jclass p3) { debugPrintf("[JNI] IsInstanceOf(): not implemented\n"); return 0; }
-jobject      CallObjectMethodA(JNIEnv* p1, jobject p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallObjectMethodA(): not implemented\n"); return 0; }
-jboolean     CallBooleanMethod(JNIEnv* p1, jobject p2, jmethodID p3, ...) { debugPrintf("[JNI] CallBooleanMethod(): not implemented\n"); return 0; }
-jboolean     CallBooleanMethodA(JNIEnv* p1, jobject p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallBooleanMethodA(): not implemented\n"); return 0; }
-jbyte        CallByteMethod(JNIEnv* p1, jobject p2, jmethodID p3, ...) { debugPrintf("[JNI] CallByteMethod(): not implemented\n"); return 0; }
-jbyte        CallByteMethodV(JNIEnv* p1, jobject p2, jmethodID p3, va_list p4) { debugPrintf("[JNI] CallByteMethodV(): not implemented\n"); return 0; }
-jbyte        CallByteMethodA(JNIEnv* p1, jobject p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallByteMethodA(): not implemented\n"); return 0; }
-jchar        CallCharMethod(JNIEnv* p1, jobject p2, jmethodID p3, ...) { debugPrintf("[JNI] CallCharMethod(): not implemented\n"); return 0; }
-jchar        CallCharMethodV(JNIEnv* p1, jobject p2, jmethodID p3, va_list p4) { debugPrintf("[JNI] CallCharMethodV(): not implemented\n"); return 0; }
-jchar        CallCharMethodA(JNIEnv* p1, jobject p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallCharMethodA(): not implemented\n"); return 0; }
-jshort       CallShortMethod(JNIEnv* p1, jobject p2, jmethodID p3, ...) { debugPrintf("[JNI] CallShortMethod(): not implemented\n"); return 0; }
-jshort       CallShortMethodV(JNIEnv* p1, jobject p2, jmethodID p3, va_list p4) { debugPrintf("[JNI] CallShortMethodV(): not implemented\n"); return 0; }
-jshort       CallShortMethodA(JNIEnv* p1, jobject p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallShortMethodA(): not implemented\n"); return 0; }
-jdouble      CallDoubleMethod(JNIEnv* p1, jobject p2, jmethodID p3, ...) { debugPrintf("[JNI] CallDoubleMethod(): not implemented\n"); return 0; }
-jdouble      CallDoubleMethodV(JNIEnv* p1, jobject p2, jmethodID p3, va_list p4) { debugPrintf("[JNI] CallDoubleMethodV(): not implemented\n"); return 0; }
-jdouble      CallDoubleMethodA(JNIEnv* p1, jobject p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallDoubleMethodA(): not implemented\n"); return 0; }
-void         CallVoidMethod(JNIEnv* p1, jobject p2, jmethodID p3, ...) { debugPrintf("[JNI] CallVoidMethod(): not implemented\n"); }
-void         CallVoidMethodA(JNIEnv* p1, jobject p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallVoidMethodA(): not implemented\n"); }
-jobject      CallNonvirtualObjectMethod(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, ...) { debugPrintf("[JNI] CallNonvirtualObjectMethod(): not implemented\n"); return 0; }
-jobject      CallNonvirtualObjectMethodV(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, va_list p5) { debugPrintf("[JNI] CallNonvirtualObjectMethodV(): not implemented\n"); return 0; }
-jobject      CallNonvirtualObjectMethodA(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, const jvalue* p5) { debugPrintf("[JNI] CallNonvirtualObjectMethodA(): not implemented\n"); return 0; }
-jboolean     CallNonvirtualBooleanMethod(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, ...) { debugPrintf("[JNI] CallNonvirtualBooleanMethod(): not implemented\n"); return 0; }
-jboolean     CallNonvirtualBooleanMethodV(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, va_list p5) { debugPrintf("[JNI] CallNonvirtualBooleanMethodV(): not implemented\n"); return 0; }
-jboolean     CallNonvirtualBooleanMethodA(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, const jvalue* p5) { debugPrintf("[JNI] CallNonvirtualBooleanMethodA(): not implemented\n"); return 0; }
-jbyte        CallNonvirtualByteMethod(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, ...) { debugPrintf("[JNI] CallNonvirtualByteMethod(): not implemented\n"); return 0; }
-jbyte        CallNonvirtualByteMethodV(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, va_list p5) { debugPrintf("[JNI] CallNonvirtualByteMethodV(): not implemented\n"); return 0; }
-jbyte        CallNonvirtualByteMethodA(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, const jvalue* p5) { debugPrintf("[JNI] CallNonvirtualByteMethodA(): not implemented\n"); return 0; }
-jchar        CallNonvirtualCharMethod(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, ...) { debugPrintf("[JNI] CallNonvirtualCharMethod(): not implemented\n"); return 0; }
-jchar        CallNonvirtualCharMethodV(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, va_list p5) { debugPrintf("[JNI] CallNonvirtualCharMethodV(): not implemented\n"); return 0; }
-jchar        CallNonvirtualCharMethodA(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, const jvalue* p5) { debugPrintf("[JNI] CallNonvirtualCharMethodA(): not implemented\n"); return 0; }
-jshort       CallNonvirtualShortMethod(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, ...) { debugPrintf("[JNI] CallNonvirtualShortMethod(): not implemented\n"); return 0; }
-jshort       CallNonvirtualShortMethodV(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, va_list p5) { debugPrintf("[JNI] CallNonvirtualShortMethodV(): not implemented\n"); return 0; }
-jshort       CallNonvirtualShortMethodA(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, const jvalue* p5) { debugPrintf("[JNI] CallNonvirtualShortMethodA(): not implemented\n"); return 0; }
-jint         CallNonvirtualIntMethod(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, ...) { debugPrintf("[JNI] CallNonvirtualIntMethod(): not implemented\n"); return 0; }
-jint         CallNonvirtualIntMethodV(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, va_list p5) { debugPrintf("[JNI] CallNonvirtualIntMethodV(): not implemented\n"); return 0; }
-jint         CallNonvirtualIntMethodA(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, const jvalue* p5) { debugPrintf("[JNI] CallNonvirtualIntMethodA(): not implemented\n"); return 0; }
-jlong        CallNonvirtualLongMethod(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, ...) { debugPrintf("[JNI] CallNonvirtualLongMethod(): not implemented\n"); return 0; }
-jlong        CallNonvirtualLongMethodV(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, va_list p5) { debugPrintf("[JNI] CallNonvirtualLongMethodV(): not implemented\n"); return 0; }
-jlong        CallNonvirtualLongMethodA(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, const jvalue* p5) { debugPrintf("[JNI] CallNonvirtualLongMethodA(): not implemented\n"); return 0; }
-jfloat       CallNonvirtualFloatMethod(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, ...) { debugPrintf("[JNI] CallNonvirtualFloatMethod(): not implemented\n"); return 0; }
-jfloat       CallNonvirtualFloatMethodV(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, va_list p5) { debugPrintf("[JNI] CallNonvirtualFloatMethodV(): not implemented\n"); return 0; }
-jfloat       CallNonvirtualFloatMethodA(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, const jvalue* p5) { debugPrintf("[JNI] CallNonvirtualFloatMethodA(): not implemented\n"); return 0; }
-jdouble      CallNonvirtualDoubleMethod(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, ...) { debugPrintf("[JNI] CallNonvirtualDoubleMethod(): not implemented\n"); return 0; }
-jdouble      CallNonvirtualDoubleMethodV(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, va_list p5) { debugPrintf("[JNI] CallNonvirtualDoubleMethodV(): not implemented\n"); return 0; }
-jdouble      CallNonvirtualDoubleMethodA(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, const jvalue* p5) { debugPrintf("[JNI] CallNonvirtualDoubleMethodA(): not implemented\n"); return 0; }
-void         CallNonvirtualVoidMethod(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, ...) { debugPrintf("[JNI] CallNonvirtualVoidMethod(): not implemented\n"); }
-void         CallNonvirtualVoidMethodV(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, va_list p5) { debugPrintf("[JNI] CallNonvirtualVoidMethodV(): not implemented\n"); }
-void         CallNonvirtualVoidMethodA(JNIEnv* p1, jobject p2, jclass p3, jmethodID p4, const jvalue* p5) { debugPrintf("[JNI] CallNonvirtualVoidMethodA(): not implemented\n"); }
-jbyte        CallStaticByteMethod(JNIEnv* p1, jclass p2, jmethodID p3, ...) { debugPrintf("[JNI] CallStaticByteMethod(): not implemented\n"); return 0; }
-jbyte        CallStaticByteMethodV(JNIEnv* p1, jclass p2, jmethodID p3, va_list p4) { debugPrintf("[JNI] CallStaticByteMethodV(): not implemented\n"); return 0; }
-jbyte        CallStaticByteMethodA(JNIEnv* p1, jclass p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallStaticByteMethodA(): not implemented\n"); return 0; }
-jchar        CallStaticCharMethod(JNIEnv* p1, jclass p2, jmethodID p3, ...) { debugPrintf("[JNI] CallStaticCharMethod(): not implemented\n"); return 0; }
-jchar        CallStaticCharMethodV(JNIEnv* p1, jclass p2, jmethodID p3, va_list p4) { debugPrintf("[JNI] CallStaticCharMethodV(): not implemented\n"); return 0; }
-jchar        CallStaticCharMethodA(JNIEnv* p1, jclass p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallStaticCharMethodA(): not implemented\n"); return 0; }
-jshort       CallStaticShortMethod(JNIEnv* p1, jclass p2, jmethodID p3, ...) { debugPrintf("[JNI] CallStaticShortMethod(): not implemented\n"); return 0; }
-jshort       CallStaticShortMethodV(JNIEnv* p1, jclass p2, jmethodID p3, va_list p4) { debugPrintf("[JNI] CallStaticShortMethodV(): not implemented\n"); return 0; }
-jshort       CallStaticShortMethodA(JNIEnv* p1, jclass p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallStaticShortMethodA(): not implemented\n"); return 0; }
-jdouble      CallStaticDoubleMethod(JNIEnv* p1, jclass p2, jmethodID p3, ...) { debugPrintf("[JNI] CallStaticDoubleMethod(): not implemented\n"); return 0; }
-jdouble      CallStaticDoubleMethodV(JNIEnv* p1, jclass p2, jmethodID p3, va_list p4) { debugPrintf("[JNI] CallStaticDoubleMethodV(): not implemented\n"); return 0; }
-jdouble      CallStaticDoubleMethodA(JNIEnv* p1, jclass p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallStaticDoubleMethodA(): not implemented\n"); return 0; }
-void         CallStaticVoidMethod(JNIEnv* p1, jclass p2, jmethodID p3, ...) { debugPrintf("[JNI] CallStaticVoidMethod(): not implemented\n"); }
-void         CallStaticVoidMethodA(JNIEnv* p1, jclass p2, jmethodID p3, const jvalue* p4) { debugPrintf("[JNI] CallStaticVoidMethodA(): not implemented\n"); }
-jboolean     GetStaticBooleanField(JNIEnv* p1, jclass p2, jfieldID p3) { debugPrintf("[JNI] GetStaticBooleanField(): not implemented\n"); return 0; }
 jbyte        GetStaticByteField(JNIEnv* p1, jclass p2, jfieldID p3) { debugPrintf("[JNI] GetStaticByteField(): not implemented\n"); return 0; }
 jchar        GetStaticCharField(JNIEnv* p1, jclass p2, jfieldID p3) { debugPrintf("[JNI] GetStaticCharField(): not implemented\n"); return 0; }
 jshort       GetStaticShortField(JNIEnv* p1, jclass p2, jfieldID p3) { debugPrintf("[JNI] GetStaticShortField(): not implemented\n"); return 0; }
-jint         GetStaticIntField(JNIEnv* p1, jclass p2, jfieldID p3) { debugPrintf("[JNI] GetStaticIntField(): not implemented\n"); return 0; }
 jlong        GetStaticLongField(JNIEnv* p1, jclass p2, jfieldID p3) { debugPrintf("[JNI] GetStaticLongField(): not implemented\n"); return 0; }
 jfloat       GetStaticFloatField(JNIEnv* p1, jclass p2, jfieldID p3) { debugPrintf("[JNI] GetStaticFloatField(): not implemented\n"); return 0; }
 jdouble      GetStaticDoubleField(JNIEnv* p1, jclass p2, jfieldID p3) { debugPrintf("[JNI] GetStaticDoubleField(): not implemented\n"); return 0; }
-void         SetStaticObjectField(JNIEnv* p1, jclass p2, jfieldID p3, jobject p4) { debugPrintf("[JNI] SetStaticObjectField(): not implemented\n"); }
-void         SetStaticBooleanField(JNIEnv* p1, jclass p2, jfieldID p3, jboolean p4) { debugPrintf("[JNI] SetStaticBooleanField(): not implemented\n"); }
 void         SetStaticByteField(JNIEnv* p1, jclass p2, jfieldID p3, jbyte p4) { debugPrintf("[JNI] SetStaticByteField(): not implemented\n"); }
 void         SetStaticCharField(JNIEnv* p1, jclass p2, jfieldID p3, jchar p4) { debugPrintf("[JNI] SetStaticCharField(): not implemented\n"); }
 void         SetStaticShortField(JNIEnv* p1, jclass p2, jfieldID p3, jshort p4) { debugPrintf("[JNI] SetStaticShortField(): not implemented\n"); }
-void         SetStaticIntField(JNIEnv* p1, jclass p2, jfieldID p3, jint p4) { debugPrintf("[JNI] SetStaticIntField(): not implemented\n"); }
 void         SetStaticLongField(JNIEnv* p1, jclass p2, jfieldID p3, jlong p4) { debugPrintf("[JNI] SetStaticLongField(): not implemented\n"); }
 void         SetStaticFloatField(JNIEnv* p1, jclass p2, jfieldID p3, jfloat p4) { debugPrintf("[JNI] SetStaticFloatField(): not implemented\n"); }
 void         SetStaticDoubleField(JNIEnv* p1, jclass p2, jfieldID p3, jdouble p4) { debugPrintf("[JNI] SetStaticDoubleField(): not implemented\n"); }
@@ -852,22 +1419,15 @@ void         SetFloatArrayRegion(JNIEnv* p1, jfloatArray p2, jsize p3, jsize p4,
 void         SetDoubleArrayRegion(JNIEnv* p1, jdoubleArray p2, jsize p3, jsize p4, const jdouble* p5) { debugPrintf("[JNI] SetDoubleArrayRegion(): not implemented\n"); }
 jint         RegisterNatives(JNIEnv* p1, jclass p2, const JNINativeMethod* p3, jint p4) { debugPrintf("[JNI] RegisterNatives(): not implemented\n"); return 0; }
 jint         UnregisterNatives(JNIEnv* p1, jclass p2) { debugPrintf("[JNI] UnregisterNatives(): not implemented\n"); return 0; }
-void         GetStringRegion(JNIEnv* p1, jstring p2, jsize p3, jsize p4, jchar* p5) { debugPrintf("[JNI] GetStringRegion(): not implemented\n"); }
-void         GetStringUTFRegion(JNIEnv* p1, jstring p2, jsize p3, jsize p4, char* p5) { debugPrintf("[JNI] GetStringUTFRegion(): not implemented\n"); }
 void*        GetPrimitiveArrayCritical(JNIEnv* p1, jarray p2, jboolean* p3) { debugPrintf("[JNI] GetPrimitiveArrayCritical(): not implemented\n"); return 0; }
 void         ReleasePrimitiveArrayCritical(JNIEnv* p1, jarray p2, void* p3, jint p4) { debugPrintf("[JNI] ReleasePrimitiveArrayCritical(): not implemented\n"); }
-const jchar*  GetStringCritical(JNIEnv* p1, jstring p2, jboolean* p3) { debugPrintf("[JNI] GetStringCritical(): not implemented\n"); return 0; }
-void         ReleaseStringCritical(JNIEnv* p1, jstring p2, const jchar* p3) { debugPrintf("[JNI] ReleaseStringCritical(): not implemented\n"); }
 jweak        NewWeakGlobalRef(JNIEnv* p1, jobject p2) { debugPrintf("[JNI] NewWeakGlobalRef(): not implemented\n"); return 0; }
 void         DeleteWeakGlobalRef(JNIEnv* p1, jweak p2) { debugPrintf("[JNI] DeleteWeakGlobalRef(): not implemented\n"); }
-jboolean     ExceptionCheck(JNIEnv* p1) { debugPrintf("[JNI] ExceptionCheck(): not implemented\n"); return 0; }
 jobject      NewDirectByteBuffer(JNIEnv* p1, void* p2, jlong p3) { debugPrintf("[JNI] NewDirectByteBuffer(): not implemented\n"); return 0; }
 void*        GetDirectBufferAddress(JNIEnv* p1, jobject p2) { debugPrintf("[JNI] GetDirectBufferAddress(): not implemented\n"); return 0; }
 jlong        GetDirectBufferCapacity(JNIEnv* p1, jobject p2) { debugPrintf("[JNI] GetDirectBufferCapacity(): not implemented\n"); return 0; }
 jobjectRefType GetObjectRefType(JNIEnv* p1, jobject p2) { debugPrintf("[JNI] GetObjectRefType(): not implemented\n"); return 0; }
 jint        DestroyJavaVM(JavaVM* vm) { debugPrintf("[JVM] DestroyJavaVM(): not implemented\n"); return 0; }
-jint        DetachCurrentThread(JavaVM* vm) { debugPrintf("[JVM] DetachCurrentThread(): not implemented\n"); return 0; }
-jint        AttachCurrentThreadAsDaemon(JavaVM* vm, JNIEnv** env, void* p3) { debugPrintf("[JVM] AttachCurrentThreadAsDaemon(): not implemented\n"); return 0; }
 
 void jni_init() {
     _jvm = (struct JNIInvokeInterface *) malloc(sizeof(struct JNIInvokeInterface));
@@ -1109,9 +1669,28 @@ void jni_init() {
     _jni->GetObjectRefType = GetObjectRefType;
 
     jvm = _jvm;
-    jni = _jni;
 
     if (pthread_mutex_init(&dynamicallyAllocatedArrays_mutex, NULL) != 0) {
         fprintf(stderr, "[ERROR] dynamicallyAllocatedArrays_mutex init failed!!!\n");
     }
+
+    if (pthread_key_create(&jniThreadEnv_key, jni_thread_env_destroy) != 0) {
+        fprintf(stderr, "[ERROR] jniThreadEnv_key init failed!!!\n");
+    }
+
+    arena_init(&jniInternedStrings_arena, JNI_INTERN_ARENA_BLOCK_SIZE);
+    if (pthread_mutex_init(&jniInternedStrings_mutex, NULL) != 0) {
+        fprintf(stderr, "[ERROR] jniInternedStrings_mutex init failed!!!\n");
+    }
+
+    if (pthread_mutex_init(&jniMethods_mutex, NULL) != 0) {
+        fprintf(stderr, "[ERROR] jniMethods_mutex init failed!!!\n");
+    }
+
+#ifdef JNI_PROFILER
+    jni_profiler_init();
+#endif
+#ifdef JNI_TRACE
+    jni_trace_init(_jni);
+#endif
 }
@@ -13,17 +13,45 @@
  * of the MIT license. See the LICENSE file for details.
  */
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "config.h"
+#include "utils/arena.h"
 #include "utils/utils.h"
 #include "android/jni.h"
 
 extern JavaVM jvm;
-extern JNIEnv jni;
 
 typedef struct FakeJavaClass {
     const char* name;
 } FakeJavaClass;
 
+/// METHODS
+
+// jmethodIDs handed out to the game point to FakeJavaMethod. The signature
+// is parsed once in GetMethodID(), so every call variant (varargs, V and A)
+// can be converted to a jvalue array without guessing argument types.
+//
+// Types are stored as JNI signature chars: 'Z', 'B', 'C', 'S', 'I', 'J',
+// 'F', 'D', 'V' and 'L' for any reference (objects and arrays). References
+// to java.lang.String are additionally flagged in `strings`.
+
+#define JNI_METHOD_MAX_ARGS 16
+#define JNI_METHODS_MAX 256
+
+#define JNI_METHOD_RET_STRING (1u << 31)
+
+typedef struct FakeJavaMethod {
+    int id;
+    char ret;
+    uint8_t argc;
+    char args[JNI_METHOD_MAX_ARGS];
+    uint32_t strings; // bit N: argument N is a String; see JNI_METHOD_RET_STRING
+} FakeJavaMethod;
+
+extern FakeJavaMethod jniMethods[JNI_METHODS_MAX];
+
 extern jint GetEnv(JavaVM *vm, void **env, jint r2);
 
 void jni_init();
@@ -42,4 +70,105 @@ jboolean tryFreeDynamicallyAllocatedArray(const void * arr);
 void saveDynamicallyAllocatedArrayPointer(const void * arr, jsize sz);
 jsize* findDynamicallyAllocatedArrayLength(const void* arr);
 
+
+/// LOCAL REFERENCE FRAMES
+
+// Objects created between PushLocalFrame() and PopLocalFrame() are placed
+// into a bump arena and released all at once when the frame is popped.
+// Outside of any frame, they are allocated on the heap as before.
+
+#define JNI_LOCAL_FRAMES_MAX 32
+#define JNI_LOCAL_ARENA_BLOCK_SIZE (16 * 1024)
+
+typedef struct {
+    uint32_t size;
+    uint32_t _pad;
+} JniLocalHeader;
+
+typedef struct {
+    arena_mark mark;
+    size_t peak;
+} JniLocalFrame;
+
+// Local frames belong to the thread that pushed them, so the calling thread's
+// env is used no matter which JNIEnv* the game passes in. Local refs handed
+// over to another thread have to go through NewGlobalRef() first, just like
+// on a real VM.
+void * jni_local_alloc(size_t size);
+void jni_local_free(void * p);
+jboolean jni_is_local(const void * p);
+
+// What NewGlobalRef() does: moves `obj` to the heap if it lives in a local
+// frame, returns it as is otherwise. Returns NULL if out of memory.
+jobject jni_global_ref(jobject obj);
+
+/// PER-THREAD ENVIRONMENT
+
+// Every thread that talks to the fake JNI gets its own env, created on
+// AttachCurrentThread()/GetEnv() and destroyed on DetachCurrentThread() or
+// thread exit. Everything the JNI functions keep between calls lives here,
+// so none of it needs a global lock.
+
+typedef struct JniThreadEnv {
+    // Must be the first member: a JniThreadEnv* is handed out as JNIEnv*.
+    const struct JNINativeInterface * functions;
+
+    int thread_id;
+
+    arena localArena;
+    JniLocalFrame localFrames[JNI_LOCAL_FRAMES_MAX];
+    int localFrames_depth;
+
+    jthrowable pendingException;
+
+    // Statistics, printed out when the thread is detached.
+    uint32_t localFrames_pushed;
+    uint32_t localAllocs;
+    size_t localPeak;
+} JniThreadEnv;
+
+// Env of the calling thread. Attaches the thread if it wasn't yet.
+JNIEnv * jni_get_env();
+
+// Destroys the env of the calling thread, if it has one. The pthread key
+// destructor never runs for threads made with sceKernelCreateThread(), so
+// those must call this before they exit, or their env leaks.
+void jni_release_env();
+
+/// MONITORS
+
+// MonitorEnter()/MonitorExit() take one of JNI_MONITOR_STRIPES recursive
+// locks, picked by hashing the object address. Unrelated objects may share a
+// stripe; that only costs some extra waiting, unless two threads nest
+// monitors of different objects in opposite orders.
+//
+// A free stripe is taken with a single compare-and-swap. Otherwise the
+// thread spins for a while, then sleeps between attempts.
+
+#define JNI_MONITOR_STRIPES 256 // must be a power of two
+#define JNI_MONITOR_SPINS 64
+#define JNI_MONITOR_SLEEP_US 50
+
+// Number of times MonitorEnter() had to wait for the given stripe.
+uint32_t jni_monitor_contention(int stripe);
+
+/// STRING INTERNING
+
+// Short strings passed to NewStringUTF() over and over, like the constants
+// the game asks for every frame, are interned: the same constant always maps
+// to the same immutable buffer, which lives until exit and must never be
+// freed. Strings the game passes only now and then are allocated as usual.
+
+#define JNI_INTERN_TABLE_SIZE 512 // must be a power of two
+#define JNI_INTERN_MAX_LENGTH 64
+#define JNI_INTERN_ARENA_BLOCK_SIZE (8 * 1024)
+
+// A string is interned once it has been passed this many times since the
+// counts were last halved, which happens every JNI_INTERN_SEEN_DECAY calls.
+#define JNI_INTERN_MIN_SEEN 4
+#define JNI_INTERN_SEEN_SLOTS 2048
+#define JNI_INTERN_SEEN_DECAY 4096
+
+jboolean jni_is_interned(const void * p);
+
 #endif // SOLOADER_JNI_H
@@ -0,0 +1,151 @@
+/*
+ * jni_profiler.c
+ *
+ * Optional profiler for the fake JNI: counts and times method dispatches and
+ * field getters, and keeps track of how much JNI time every frame takes.
+ * Enabled with the JNI_PROFILER CMake option; compiles to nothing otherwise.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "jni_profiler.h"
+
+#ifdef JNI_PROFILER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jni_fake.h"
+#include "utils/utils.h"
+
+typedef struct {
+    uint32_t calls;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t hist[JNI_PROFILER_BUCKETS];
+} JniProfilerStats;
+
+// Everything is updated with relaxed atomics: the game calls into JNI from
+// several threads, and we'd rather not add a lock to every call.
+static JniProfilerStats jniProfilerStats[JNI_PROFILER_KINDS][JNI_PROFILER_MAX_ID];
+
+static uint32_t jniProfiler_frameUs = 0; // JNI time in the current frame
+static JniProfilerStats jniProfilerFrames;
+
+static const char * jniProfilerKindNames[JNI_PROFILER_KINDS] = { "Methods", "Fields" };
+
+static inline int bucket(uint32_t us) {
+    int b = 0;
+    while (us && b < JNI_PROFILER_BUCKETS - 1) {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static inline void stats_add(JniProfilerStats * s, uint32_t us) {
+    __atomic_fetch_add(&s->calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->total_us, us, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->hist[bucket(us)], 1, __ATOMIC_RELAXED);
+
+    uint32_t max = __atomic_load_n(&s->max_us, __ATOMIC_RELAXED);
+    while (us > max && !__atomic_compare_exchange_n(&s->max_us, &max, us, 1,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// Upper bound of the histogram bucket where the `p`th percentile falls.
+static uint32_t stats_percentile(const JniProfilerStats * s, int p) {
+    uint64_t target = ((uint64_t)s->calls * p + 99) / 100;
+    uint64_t seen = 0;
+    for (int b = 0; b < JNI_PROFILER_BUCKETS; b++) {
+        seen += s->hist[b];
+        if (seen >= target) {
+            return (b == JNI_PROFILER_BUCKETS - 1) ? s->max_us : (1u << b);
+        }
+    }
+    return s->max_us;
+}
+
+void jni_profiler_init() {
+    memset(jniProfilerStats, 0, sizeof(jniProfilerStats));
+    memset(&jniProfilerFrames, 0, sizeof(jniProfilerFrames));
+    atexit(jni_profiler_report);
+}
+
+void jni_profiler_record(JniProfilerKind kind, int id, uint32_t start_us) {
+    uint32_t us = sceKernelGetProcessTimeLow() - start_us;
+
+    if (id < 0 || id >= JNI_PROFILER_MAX_ID) id = 0;
+
+    stats_add(&jniProfilerStats[kind][id], us);
+    __atomic_fetch_add(&jniProfiler_frameUs, us, __ATOMIC_RELAXED);
+}
+
+void jni_profiler_frame() {
+    uint32_t us = __atomic_exchange_n(&jniProfiler_frameUs, 0, __ATOMIC_RELAXED);
+    stats_add(&jniProfilerFrames, us);
+}
+
+static int compare_total_desc(const void * a, const void * b) {
+    const JniProfilerStats * sa = *(const JniProfilerStats **)a;
+    const JniProfilerStats * sb = *(const JniProfilerStats **)b;
+    if (sa->total_us == sb->total_us) return 0;
+    return (sa->total_us < sb->total_us) ? 1 : -1;
+}
+
+void jni_profiler_report() {
+    FILE * f = fopen(JNI_PROFILER_REPORT_PATH, "w");
+    if (!f) {
+        debugPrintf("[JNI][Profiler] Can't open %s for writing.\n", JNI_PROFILER_REPORT_PATH);
+        return;
+    }
+
+    const JniProfilerStats * fr = &jniProfilerFrames;
+    fprintf(f, "Frames: %u, JNI time per frame: avg %llu us, p50 <=%u us, p90 <=%u us, p99 <=%u us, max %u us\n\n",
+            fr->calls, fr->calls ? fr->total_us / fr->calls : 0,
+            stats_percentile(fr, 50), stats_percentile(fr, 90),
+            stats_percentile(fr, 99), fr->max_us);
+
+    JniProfilerStats * sorted[JNI_PROFILER_MAX_ID];
+
+    for (int kind = 0; kind < JNI_PROFILER_KINDS; kind++) {
+        int n = 0;
+        for (int id = 0; id < JNI_PROFILER_MAX_ID; id++) {
+            if (jniProfilerStats[kind][id].calls) {
+                sorted[n++] = &jniProfilerStats[kind][id];
+            }
+        }
+        qsort(sorted, n, sizeof(JniProfilerStats *), compare_total_desc);
+
+        fprintf(f, "%s:\n", jniProfilerKindNames[kind]);
+        fprintf(f, "%5s %-40s %10s %12s %8s %8s %8s %8s %8s\n",
+                "id", "name", "calls", "total us", "avg us", "p50", "p90", "p99", "max us");
+
+        for (int i = 0; i < n; i++) {
+            const JniProfilerStats * s = sorted[i];
+            int id = (int)(s - jniProfilerStats[kind]);
+            const char * name = jni_profiler_name(kind, id);
+
+            fprintf(f, "%5i %-40s %10u %12llu %8llu %8u %8u %8u %8u\n",
+                    id, name ? name : "?", s->calls, s->total_us, s->total_us / s->calls,
+                    stats_percentile(s, 50), stats_percentile(s, 90),
+                    stats_percentile(s, 99), s->max_us);
+        }
+        fprintf(f, "\n");
+    }
+
+    fprintf(f, "Contended monitor stripes:\n");
+    for (int stripe = 0; stripe < JNI_MONITOR_STRIPES; stripe++) {
+        uint32_t n = jni_monitor_contention(stripe);
+        if (n) fprintf(f, "%5i %10u\n", stripe, n);
+    }
+
+    fclose(f);
+    debugPrintf("[JNI][Profiler] Report written to %s\n", JNI_PROFILER_REPORT_PATH);
+}
+
+#endif // JNI_PROFILER
@@ -0,0 +1,64 @@
+/*
+ * jni_profiler.h
+ *
+ * Optional profiler for the fake JNI: counts and times method dispatches and
+ * field getters, and keeps track of how much JNI time every frame takes.
+ * Enabled with the JNI_PROFILER CMake option; compiles to nothing otherwise.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_JNI_PROFILER_H
+#define SOLOADER_JNI_PROFILER_H
+
+#include <stdint.h>
+
+#define JNI_PROFILER_REPORT_PATH DATA_PATH "jni_profile.txt"
+
+// Method and field IDs above this are all accounted under ID 0.
+#define JNI_PROFILER_MAX_ID 1024
+
+// Latency histograms use power-of-two buckets: bucket 0 is < 1us, bucket N
+// is [2^(N-1), 2^N) us, the last one catches everything above.
+#define JNI_PROFILER_BUCKETS 24
+
+typedef enum JniProfilerKind {
+    JNI_PROFILER_METHOD = 0,
+    JNI_PROFILER_FIELD  = 1,
+    JNI_PROFILER_KINDS
+} JniProfilerKind;
+
+#ifdef JNI_PROFILER
+
+#include <psp2/kernel/processmgr.h>
+
+void jni_profiler_init();
+
+void jni_profiler_record(JniProfilerKind kind, int id, uint32_t start_us);
+
+// To be called once per rendered frame.
+void jni_profiler_frame();
+
+// Writes the report to JNI_PROFILER_REPORT_PATH. Called at exit, and can be
+// triggered with L + R + SELECT.
+void jni_profiler_report();
+
+// Provided by jni_fake.c, used to print human-readable names in the report.
+const char * jni_profiler_name(JniProfilerKind kind, int id);
+
+#define JNI_PROFILER_BEGIN(t) uint32_t t = sceKernelGetProcessTimeLow()
+#define JNI_PROFILER_END(t, kind, id) jni_profiler_record(kind, id, t)
+#define JNI_PROFILER_FRAME() jni_profiler_frame()
+
+#else
+
+#define JNI_PROFILER_BEGIN(t)
+#define JNI_PROFILER_END(t, kind, id)
+#define JNI_PROFILER_FRAME()
+
+#endif // JNI_PROFILER
+
+#endif // SOLOADER_JNI_PROFILER_H
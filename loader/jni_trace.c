@@ -0,0 +1,497 @@
+/*
+ * jni_trace.c
+ *
+ * Optional binary trace of the JNI calls made by the game, meant to be
+ * replayed on the host with tools/jni_replay. Enabled with the JNI_TRACE
+ * CMake option; compiles to nothing otherwise.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "jni_trace.h"
+
+#ifdef JNI_TRACE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <psp2/kernel/processmgr.h>
+#include <psp2/kernel/threadmgr.h>
+
+#include "jni_fake.h"
+
+static FILE * jniTrace_file = NULL;
+static uint8_t jniTrace_buffer[JNI_TRACE_BUFFER_SIZE];
+static size_t jniTrace_bufferUsed = 0;
+static uint32_t jniTrace_lastFlush = 0;
+static pthread_mutex_t jniTrace_mutex;
+
+// The entry points as implemented by jni_fake.c, called by the wrappers below.
+static struct JNINativeInterface jniTrace_real;
+
+// Must be called with jniTrace_mutex held.
+static void flush_locked() {
+    if (jniTrace_file && jniTrace_bufferUsed) {
+        fwrite(jniTrace_buffer, 1, jniTrace_bufferUsed, jniTrace_file);
+        fflush(jniTrace_file);
+    }
+    jniTrace_bufferUsed = 0;
+    jniTrace_lastFlush = sceKernelGetProcessTimeLow();
+}
+
+// Must be called with jniTrace_mutex held, once a record is complete.
+static void end_record_locked() {
+    if (sceKernelGetProcessTimeLow() - jniTrace_lastFlush >= JNI_TRACE_FLUSH_MS * 1000) {
+        flush_locked();
+    }
+}
+
+static void put(const void * data, size_t size) {
+    const uint8_t * p = data;
+    while (size) {
+        if (jniTrace_bufferUsed == JNI_TRACE_BUFFER_SIZE) flush_locked();
+
+        size_t n = JNI_TRACE_BUFFER_SIZE - jniTrace_bufferUsed;
+        if (n > size) n = size;
+        memcpy(jniTrace_buffer + jniTrace_bufferUsed, p, n);
+        jniTrace_bufferUsed += n;
+        p += n;
+        size -= n;
+    }
+}
+
+static void put_string(const char * str) {
+    size_t len = str ? strnlen(str, JNI_TRACE_MAX_STRING) : 0;
+    uint16_t len16 = (uint16_t)len;
+    put(&len16, sizeof(len16));
+    put(str, len);
+}
+
+static void put_value(char type, int is_string, const jvalue * v) {
+    if (is_string && v->l) {
+        const char t = 'T';
+        put(&t, 1);
+        put_string((const char *)v->l);
+        return;
+    }
+
+    put(&type, 1);
+    put(v, sizeof(jvalue));
+}
+
+static void put_header(JniTraceFunc func, uint8_t argc, int32_t id) {
+    JniTraceRecordHeader h;
+    h.func = (uint8_t)func;
+    h.argc = argc;
+    h.reserved = 0;
+    h.thread = (uint32_t)sceKernelGetThreadId();
+    h.time_us = sceKernelGetProcessTimeLow();
+    h.id = id;
+    put(&h, sizeof(h));
+}
+
+/*
+ * Records a call of one of the entry points wrapped below. `types` has the
+ * type of each of the arguments in `args`, 'T' for a string; `ret_type` is
+ * the type of `ret`.
+ */
+static void event(JniTraceFunc func, int32_t id, const char * types, const jvalue * args,
+                  char ret_type, const jvalue * ret) {
+    if (!jniTrace_file) return;
+
+    int argc = (int)strlen(types);
+
+    pthread_mutex_lock(&jniTrace_mutex);
+    put_header(func, (uint8_t)argc, id);
+    for (int i = 0; i < argc; i++) {
+        put_value(types[i] == 'T' ? 'L' : types[i], types[i] == 'T', &args[i]);
+    }
+    put_value(ret_type == 'T' ? 'L' : ret_type, ret_type == 'T', ret);
+    end_record_locked();
+    pthread_mutex_unlock(&jniTrace_mutex);
+}
+
+#define EVENT(func, id, types, ret_type, member, ret, ...) { \
+    const jvalue _args[] = { __VA_ARGS__ };                  \
+    jvalue _rv;                                              \
+    _rv.j = 0;                                               \
+    _rv.member = (ret);                                      \
+    event(func, id, types, _args, ret_type, &_rv);           \
+}
+
+#define NONE { .j = 0 }
+#define L(x) { .l = (jobject)(x) }
+#define I(x) { .i = (x) }
+#define Z(x) { .z = (x) }
+
+static void trace_SetObjectField(JNIEnv * env, jobject obj, jfieldID id, jobject value) {
+    jniTrace_real.SetObjectField(env, obj, id, value);
+    EVENT(JNI_TRACE_SET_OBJECT_FIELD, (int)id, "L", 'V', j, 0, L(value));
+}
+
+static void trace_SetStaticObjectField(JNIEnv * env, jclass clazz, jfieldID id, jobject value) {
+    jniTrace_real.SetStaticObjectField(env, clazz, id, value);
+    EVENT(JNI_TRACE_SET_OBJECT_FIELD, (int)id, "L", 'V', j, 0, L(value));
+}
+
+static void trace_SetIntField(JNIEnv * env, jobject obj, jfieldID id, jint value) {
+    jniTrace_real.SetIntField(env, obj, id, value);
+    EVENT(JNI_TRACE_SET_INT_FIELD, (int)id, "I", 'V', j, 0, I(value));
+}
+
+static void trace_SetStaticIntField(JNIEnv * env, jclass clazz, jfieldID id, jint value) {
+    jniTrace_real.SetStaticIntField(env, clazz, id, value);
+    EVENT(JNI_TRACE_SET_INT_FIELD, (int)id, "I", 'V', j, 0, I(value));
+}
+
+static void trace_SetBooleanField(JNIEnv * env, jobject obj, jfieldID id, jboolean value) {
+    jniTrace_real.SetBooleanField(env, obj, id, value);
+    EVENT(JNI_TRACE_SET_BOOLEAN_FIELD, (int)id, "Z", 'V', j, 0, Z(value));
+}
+
+static void trace_SetStaticBooleanField(JNIEnv * env, jclass clazz, jfieldID id, jboolean value) {
+    jniTrace_real.SetStaticBooleanField(env, clazz, id, value);
+    EVENT(JNI_TRACE_SET_BOOLEAN_FIELD, (int)id, "Z", 'V', j, 0, Z(value));
+}
+
+static jclass trace_FindClass(JNIEnv * env, const char * name) {
+    jclass ret = jniTrace_real.FindClass(env, name);
+    EVENT(JNI_TRACE_FIND_CLASS, 0, "T", 'L', l, ret, L(name));
+    return ret;
+}
+
+static jclass trace_GetObjectClass(JNIEnv * env, jobject obj) {
+    jclass ret = jniTrace_real.GetObjectClass(env, obj);
+    EVENT(JNI_TRACE_GET_OBJECT_CLASS, 0, "L", 'L', l, ret, L(obj));
+    return ret;
+}
+
+static jint trace_PushLocalFrame(JNIEnv * env, jint capacity) {
+    jint ret = jniTrace_real.PushLocalFrame(env, capacity);
+    EVENT(JNI_TRACE_PUSH_LOCAL_FRAME, 0, "I", 'I', i, ret, I(capacity));
+    return ret;
+}
+
+static jobject trace_PopLocalFrame(JNIEnv * env, jobject result) {
+    jobject ret = jniTrace_real.PopLocalFrame(env, result);
+    EVENT(JNI_TRACE_POP_LOCAL_FRAME, 0, "L", 'L', l, ret, L(result));
+    return ret;
+}
+
+static jobject trace_NewGlobalRef(JNIEnv * env, jobject obj) {
+    jobject ret = jniTrace_real.NewGlobalRef(env, obj);
+    EVENT(JNI_TRACE_NEW_GLOBAL_REF, 0, "L", 'L', l, ret, L(obj));
+    return ret;
+}
+
+static void trace_DeleteGlobalRef(JNIEnv * env, jobject obj) {
+    EVENT(JNI_TRACE_DELETE_GLOBAL_REF, 0, "L", 'V', j, 0, L(obj));
+    jniTrace_real.DeleteGlobalRef(env, obj);
+}
+
+static void trace_DeleteLocalRef(JNIEnv * env, jobject obj) {
+    EVENT(JNI_TRACE_DELETE_LOCAL_REF, 0, "L", 'V', j, 0, L(obj));
+    jniTrace_real.DeleteLocalRef(env, obj);
+}
+
+static jstring trace_NewStringUTF(JNIEnv * env, const char * bytes) {
+    jstring ret = jniTrace_real.NewStringUTF(env, bytes);
+    EVENT(JNI_TRACE_NEW_STRING_UTF, 0, "T", 'T', l, ret, L(bytes));
+    return ret;
+}
+
+// Only the length is recorded; the replayer gets the UTF-16 back from the
+// result.
+static jstring trace_NewString(JNIEnv * env, const jchar * chars, jsize len) {
+    jstring ret = jniTrace_real.NewString(env, chars, len);
+    EVENT(JNI_TRACE_NEW_STRING, 0, "I", 'T', l, ret, I(len));
+    return ret;
+}
+
+static jsize trace_GetStringLength(JNIEnv * env, jstring string) {
+    jsize ret = jniTrace_real.GetStringLength(env, string);
+    EVENT(JNI_TRACE_GET_STRING_LENGTH, 0, "T", 'I', i, ret, L(string));
+    return ret;
+}
+
+static jsize trace_GetStringUTFLength(JNIEnv * env, jstring string) {
+    jsize ret = jniTrace_real.GetStringUTFLength(env, string);
+    EVENT(JNI_TRACE_GET_STRING_UTF_LENGTH, 0, "T", 'I', i, ret, L(string));
+    return ret;
+}
+
+static const jchar * trace_GetStringChars(JNIEnv * env, jstring string, jboolean * isCopy) {
+    const jchar * ret = jniTrace_real.GetStringChars(env, string, isCopy);
+    EVENT(JNI_TRACE_GET_STRING_CHARS, 0, "T", 'L', l, (jobject)ret, L(string));
+    return ret;
+}
+
+static void trace_ReleaseStringChars(JNIEnv * env, jstring string, const jchar * chars) {
+    EVENT(JNI_TRACE_RELEASE_STRING_CHARS, 0, "TL", 'V', j, 0, L(string), L(chars));
+    jniTrace_real.ReleaseStringChars(env, string, chars);
+}
+
+static const jchar * trace_GetStringCritical(JNIEnv * env, jstring string, jboolean * isCopy) {
+    const jchar * ret = jniTrace_real.GetStringCritical(env, string, isCopy);
+    EVENT(JNI_TRACE_GET_STRING_CHARS, 1, "T", 'L', l, (jobject)ret, L(string));
+    return ret;
+}
+
+static void trace_ReleaseStringCritical(JNIEnv * env, jstring string, const jchar * chars) {
+    EVENT(JNI_TRACE_RELEASE_STRING_CHARS, 1, "TL", 'V', j, 0, L(string), L(chars));
+    jniTrace_real.ReleaseStringCritical(env, string, chars);
+}
+
+static const char * trace_GetStringUTFChars(JNIEnv * env, jstring string, jboolean * isCopy) {
+    const char * ret = jniTrace_real.GetStringUTFChars(env, string, isCopy);
+    EVENT(JNI_TRACE_GET_STRING_UTF_CHARS, 0, "T", 'L', l, (jobject)ret, L(string));
+    return ret;
+}
+
+static void trace_ReleaseStringUTFChars(JNIEnv * env, jstring string, char * utf) {
+    EVENT(JNI_TRACE_RELEASE_STRING_UTF_CHARS, 0, "TL", 'V', j, 0, L(string), L(utf));
+    jniTrace_real.ReleaseStringUTFChars(env, string, utf);
+}
+
+static void trace_GetStringRegion(JNIEnv * env, jstring string, jsize start, jsize len, jchar * buf) {
+    jniTrace_real.GetStringRegion(env, string, start, len, buf);
+    EVENT(JNI_TRACE_GET_STRING_REGION, 0, "TII", 'V', j, 0, L(string), I(start), I(len));
+}
+
+static void trace_GetStringUTFRegion(JNIEnv * env, jstring string, jsize start, jsize len, char * buf) {
+    jniTrace_real.GetStringUTFRegion(env, string, start, len, buf);
+    EVENT(JNI_TRACE_GET_STRING_UTF_REGION, 0, "TII", 'V', j, 0, L(string), I(start), I(len));
+}
+
+static jbyteArray trace_NewByteArray(JNIEnv * env, jsize length) {
+    jbyteArray ret = jniTrace_real.NewByteArray(env, length);
+    EVENT(JNI_TRACE_NEW_ARRAY, 'B', "I", 'L', l, ret, I(length));
+    return ret;
+}
+
+static jshortArray trace_NewShortArray(JNIEnv * env, jsize length) {
+    jshortArray ret = jniTrace_real.NewShortArray(env, length);
+    EVENT(JNI_TRACE_NEW_ARRAY, 'S', "I", 'L', l, ret, I(length));
+    return ret;
+}
+
+static jsize trace_GetArrayLength(JNIEnv * env, jarray array) {
+    jsize ret = jniTrace_real.GetArrayLength(env, array);
+    EVENT(JNI_TRACE_GET_ARRAY_LENGTH, 0, "L", 'I', i, ret, L(array));
+    return ret;
+}
+
+static jobject trace_GetObjectArrayElement(JNIEnv * env, jobjectArray array, jsize index) {
+    jobject ret = jniTrace_real.GetObjectArrayElement(env, array, index);
+    EVENT(JNI_TRACE_GET_OBJECT_ARRAY_ELEMENT, 0, "LI", 'L', l, ret, L(array), I(index));
+    return ret;
+}
+
+static void trace_GetIntArrayRegion(JNIEnv * env, jintArray array, jsize start, jsize len, jint * buf) {
+    jniTrace_real.GetIntArrayRegion(env, array, start, len, buf);
+    EVENT(JNI_TRACE_GET_ARRAY_REGION, 'I', "LII", 'V', j, 0, L(array), I(start), I(len));
+}
+
+static void trace_GetFloatArrayRegion(JNIEnv * env, jfloatArray array, jsize start, jsize len, jfloat * buf) {
+    jniTrace_real.GetFloatArrayRegion(env, array, start, len, buf);
+    EVENT(JNI_TRACE_GET_ARRAY_REGION, 'F', "LII", 'V', j, 0, L(array), I(start), I(len));
+}
+
+static void trace_GetByteArrayRegion(JNIEnv * env, jbyteArray array, jsize start, jsize len, jbyte * buf) {
+    jniTrace_real.GetByteArrayRegion(env, array, start, len, buf);
+    EVENT(JNI_TRACE_GET_ARRAY_REGION, 'B', "LII", 'V', j, 0, L(array), I(start), I(len));
+}
+
+static void trace_SetShortArrayRegion(JNIEnv * env, jshortArray array, jsize start, jsize len,
+                                      const jshort * buf) {
+    jniTrace_real.SetShortArrayRegion(env, array, start, len, buf);
+    EVENT(JNI_TRACE_SET_ARRAY_REGION, 'S', "LII", 'V', j, 0, L(array), I(start), I(len));
+}
+
+static jint trace_Throw(JNIEnv * env, jthrowable obj) {
+    jint ret = jniTrace_real.Throw(env, obj);
+    EVENT(JNI_TRACE_THROW, 0, "L", 'I', i, ret, L(obj));
+    return ret;
+}
+
+static jint trace_ThrowNew(JNIEnv * env, jclass clazz, const char * message) {
+    jint ret = jniTrace_real.ThrowNew(env, clazz, message);
+    EVENT(JNI_TRACE_THROW_NEW, 0, "LT", 'I', i, ret, L(clazz), L(message));
+    return ret;
+}
+
+static jthrowable trace_ExceptionOccurred(JNIEnv * env) {
+    jthrowable ret = jniTrace_real.ExceptionOccurred(env);
+    EVENT(JNI_TRACE_EXCEPTION_OCCURRED, 0, "", 'L', l, ret, NONE);
+    return ret;
+}
+
+static void trace_ExceptionDescribe(JNIEnv * env) {
+    jniTrace_real.ExceptionDescribe(env);
+    EVENT(JNI_TRACE_EXCEPTION_DESCRIBE, 0, "", 'V', j, 0, NONE);
+}
+
+static void trace_ExceptionClear(JNIEnv * env) {
+    jniTrace_real.ExceptionClear(env);
+    EVENT(JNI_TRACE_EXCEPTION_CLEAR, 0, "", 'V', j, 0, NONE);
+}
+
+static jboolean trace_ExceptionCheck(JNIEnv * env) {
+    jboolean ret = jniTrace_real.ExceptionCheck(env);
+    EVENT(JNI_TRACE_EXCEPTION_CHECK, 0, "", 'Z', z, ret, NONE);
+    return ret;
+}
+
+static jint trace_MonitorEnter(JNIEnv * env, jobject obj) {
+    jint ret = jniTrace_real.MonitorEnter(env, obj);
+    EVENT(JNI_TRACE_MONITOR_ENTER, 0, "L", 'I', i, ret, L(obj));
+    return ret;
+}
+
+static jint trace_MonitorExit(JNIEnv * env, jobject obj) {
+    jint ret = jniTrace_real.MonitorExit(env, obj);
+    EVENT(JNI_TRACE_MONITOR_EXIT, 0, "L", 'I', i, ret, L(obj));
+    return ret;
+}
+
+static jint trace_GetVersion(JNIEnv * env) {
+    jint ret = jniTrace_real.GetVersion(env);
+    EVENT(JNI_TRACE_GET_VERSION, 0, "", 'I', i, ret, NONE);
+    return ret;
+}
+
+static jint trace_GetJavaVM(JNIEnv * env, JavaVM ** vm) {
+    jint ret = jniTrace_real.GetJavaVM(env, vm);
+    EVENT(JNI_TRACE_GET_JAVA_VM, 0, "", 'I', i, ret, NONE);
+    return ret;
+}
+
+#define WRAP(name) { functions->name = trace_##name; }
+
+// Puts the wrappers above in place of the entry points jni_fake.c doesn't
+// trace itself.
+static void wrap(struct JNINativeInterface * functions) {
+    jniTrace_real = *functions;
+
+    WRAP(SetObjectField)
+    WRAP(SetStaticObjectField)
+    WRAP(SetIntField)
+    WRAP(SetStaticIntField)
+    WRAP(SetBooleanField)
+    WRAP(SetStaticBooleanField)
+    WRAP(FindClass)
+    WRAP(GetObjectClass)
+    WRAP(PushLocalFrame)
+    WRAP(PopLocalFrame)
+    WRAP(NewGlobalRef)
+    WRAP(DeleteGlobalRef)
+    WRAP(DeleteLocalRef)
+    WRAP(NewStringUTF)
+    WRAP(NewString)
+    WRAP(GetStringLength)
+    WRAP(GetStringUTFLength)
+    WRAP(GetStringChars)
+    WRAP(ReleaseStringChars)
+    WRAP(GetStringCritical)
+    WRAP(ReleaseStringCritical)
+    WRAP(GetStringUTFChars)
+    WRAP(ReleaseStringUTFChars)
+    WRAP(GetStringRegion)
+    WRAP(GetStringUTFRegion)
+    WRAP(NewByteArray)
+    WRAP(NewShortArray)
+    WRAP(GetArrayLength)
+    WRAP(GetObjectArrayElement)
+    WRAP(GetIntArrayRegion)
+    WRAP(GetFloatArrayRegion)
+    WRAP(GetByteArrayRegion)
+    WRAP(SetShortArrayRegion)
+    WRAP(Throw)
+    WRAP(ThrowNew)
+    WRAP(ExceptionOccurred)
+    WRAP(ExceptionDescribe)
+    WRAP(ExceptionClear)
+    WRAP(ExceptionCheck)
+    WRAP(MonitorEnter)
+    WRAP(MonitorExit)
+    WRAP(GetVersion)
+    WRAP(GetJavaVM)
+}
+
+void jni_trace_init(struct JNINativeInterface * functions) {
+    if (pthread_mutex_init(&jniTrace_mutex, NULL) != 0) {
+        fprintf(stderr, "[ERROR] jniTrace_mutex init failed!!!\n");
+    }
+
+    jniTrace_file = fopen(JNI_TRACE_PATH, "wb");
+    if (!jniTrace_file) {
+        fprintf(stderr, "[JNI][Trace] Can't open %s for writing.\n", JNI_TRACE_PATH);
+        return;
+    }
+
+    JniTraceFileHeader h = { JNI_TRACE_MAGIC, JNI_TRACE_VERSION, 0 };
+    fwrite(&h, sizeof(h), 1, jniTrace_file);
+    jniTrace_lastFlush = sceKernelGetProcessTimeLow();
+
+    wrap(functions);
+    atexit(jni_trace_flush);
+}
+
+void jni_trace_lookup(JniTraceFunc func, int id, const char * name, const char * sig) {
+    if (!jniTrace_file) return;
+
+    pthread_mutex_lock(&jniTrace_mutex);
+    put_header(func, 0, id);
+    put_string(name);
+    put_string(sig);
+    end_record_locked();
+    pthread_mutex_unlock(&jniTrace_mutex);
+}
+
+void jni_trace_call(JniTraceFunc func, jmethodID methodID, const jvalue * args, const jvalue * ret) {
+    if (!jniTrace_file) return;
+
+    const FakeJavaMethod * m = (const FakeJavaMethod *)methodID;
+    const jvalue none = { 0 };
+
+    pthread_mutex_lock(&jniTrace_mutex);
+
+    if (!m) {
+        put_header(func, 0, -1);
+        put_value('V', 0, &none);
+    } else {
+        put_header(func, m->argc, (int32_t)(m - jniMethods));
+        for (int i = 0; i < m->argc; i++) {
+            put_value(m->args[i], m->strings & (1u << i), &args[i]);
+        }
+        put_value(m->ret, m->strings & JNI_METHOD_RET_STRING, ret ? ret : &none);
+    }
+
+    end_record_locked();
+    pthread_mutex_unlock(&jniTrace_mutex);
+}
+
+void jni_trace_field(JniTraceFunc func, int id, char type, const jvalue * ret) {
+    if (!jniTrace_file) return;
+
+    pthread_mutex_lock(&jniTrace_mutex);
+    put_header(func, 0, id);
+    put_value(type, 0, ret);
+    end_record_locked();
+    pthread_mutex_unlock(&jniTrace_mutex);
+}
+
+void jni_trace_flush() {
+    if (!jniTrace_file) return;
+
+    pthread_mutex_lock(&jniTrace_mutex);
+    flush_locked();
+    pthread_mutex_unlock(&jniTrace_mutex);
+}
+
+#endif // JNI_TRACE
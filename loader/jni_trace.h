@@ -0,0 +1,171 @@
+/*
+ * jni_trace.h
+ *
+ * Optional binary trace of the JNI calls made by the game, meant to be
+ * replayed on the host with tools/jni_replay. Enabled with the JNI_TRACE
+ * CMake option; compiles to nothing otherwise.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_JNI_TRACE_H
+#define SOLOADER_JNI_TRACE_H
+
+#include <stdint.h>
+
+#include "android/jni.h"
+
+#define JNI_TRACE_PATH DATA_PATH "jni_trace.bin"
+#define JNI_TRACE_BUFFER_SIZE (64 * 1024)
+
+// The buffer is written out every frame, and at least this often while no
+// frames are drawn, so a crash or a kill loses little of the trace.
+#define JNI_TRACE_FLUSH_MS 250
+
+#define JNI_TRACE_MAGIC 0x544E494A // "JINT"
+#define JNI_TRACE_VERSION 2
+
+// Longer strings are cut when recorded.
+#define JNI_TRACE_MAX_STRING 1024
+
+typedef enum JniTraceFunc {
+    JNI_TRACE_GET_METHOD_ID = 1,
+    JNI_TRACE_GET_STATIC_METHOD_ID,
+    JNI_TRACE_GET_FIELD_ID,
+    JNI_TRACE_GET_STATIC_FIELD_ID,
+    JNI_TRACE_CALL_METHOD,
+    JNI_TRACE_CALL_STATIC_METHOD,
+    JNI_TRACE_NEW_OBJECT,
+    JNI_TRACE_GET_OBJECT_FIELD,
+    JNI_TRACE_GET_STATIC_OBJECT_FIELD,
+    JNI_TRACE_GET_INT_FIELD,
+    JNI_TRACE_GET_BOOLEAN_FIELD,
+
+    // Since version 2. The rest of the entry points, recorded by wrappers
+    // in the function table rather than in jni_fake.c.
+    JNI_TRACE_SET_OBJECT_FIELD,
+    JNI_TRACE_SET_INT_FIELD,
+    JNI_TRACE_SET_BOOLEAN_FIELD,
+    JNI_TRACE_FIND_CLASS,
+    JNI_TRACE_GET_OBJECT_CLASS,
+    JNI_TRACE_PUSH_LOCAL_FRAME,
+    JNI_TRACE_POP_LOCAL_FRAME,
+    JNI_TRACE_NEW_GLOBAL_REF,
+    JNI_TRACE_DELETE_GLOBAL_REF,
+    JNI_TRACE_DELETE_LOCAL_REF,
+    JNI_TRACE_NEW_STRING_UTF,
+    JNI_TRACE_NEW_STRING,
+    JNI_TRACE_GET_STRING_LENGTH,
+    JNI_TRACE_GET_STRING_UTF_LENGTH,
+    JNI_TRACE_GET_STRING_CHARS,      // `id` is 1 for GetStringCritical()
+    JNI_TRACE_RELEASE_STRING_CHARS,  // `id` is 1 for ReleaseStringCritical()
+    JNI_TRACE_GET_STRING_UTF_CHARS,
+    JNI_TRACE_RELEASE_STRING_UTF_CHARS,
+    JNI_TRACE_GET_STRING_REGION,
+    JNI_TRACE_GET_STRING_UTF_REGION,
+    JNI_TRACE_NEW_ARRAY,             // `id` is the element type
+    JNI_TRACE_GET_ARRAY_LENGTH,
+    JNI_TRACE_GET_OBJECT_ARRAY_ELEMENT,
+    JNI_TRACE_GET_ARRAY_REGION,      // `id` is the element type
+    JNI_TRACE_SET_ARRAY_REGION,      // `id` is the element type
+    JNI_TRACE_THROW,
+    JNI_TRACE_THROW_NEW,
+    JNI_TRACE_EXCEPTION_OCCURRED,
+    JNI_TRACE_EXCEPTION_DESCRIBE,
+    JNI_TRACE_EXCEPTION_CLEAR,
+    JNI_TRACE_EXCEPTION_CHECK,
+    JNI_TRACE_MONITOR_ENTER,
+    JNI_TRACE_MONITOR_EXIT,
+    JNI_TRACE_GET_VERSION,
+    JNI_TRACE_GET_JAVA_VM,
+
+    JNI_TRACE_FUNC_COUNT
+} JniTraceFunc;
+
+/*
+ * File layout: JniTraceFileHeader followed by records, each starting with
+ * JniTraceRecordHeader. What follows the header depends on `func`:
+ *
+ *   *_METHOD_ID:  `id` is the index of the method in jniMethods (or -1 if
+ *                 not found); followed by two strings, name and signature.
+ *   *_FIELD_ID:   `id` is the field id; followed by name and signature.
+ *   CALL_*, NEW_OBJECT: `id` is the index in jniMethods; followed by `argc`
+ *                 values and the return value.
+ *   GET_*_FIELD:  `id` is the field id; followed by the return value.
+ *   Everything from SET_OBJECT_FIELD on: laid out like CALL_*, `argc`
+ *                 arguments then the return value ('V' and zeroes if there
+ *                 is none). `id` is the field id for SET_*_FIELD, 0 unless
+ *                 noted otherwise above.
+ *
+ * Every entry point of JNINativeInterface that does something is recorded.
+ * Left out are the ones that only log "not implemented", and the
+ * JNIInvokeInterface (GetEnv, AttachCurrentThread...), which the game only
+ * uses to get hold of an env. Objects other than strings are recorded as
+ * pointers, which mean nothing on the host, so the replayer skips the calls
+ * that need a real array and frees nothing.
+ *
+ * A string is a uint16 length and the bytes, without a terminator.
+ * A value is its type char, then either a string (type 'T') or the 8 raw
+ * bytes of the jvalue. Integers are little-endian.
+ */
+
+typedef struct __attribute__((packed)) JniTraceFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+} JniTraceFileHeader;
+
+typedef struct __attribute__((packed)) JniTraceRecordHeader {
+    uint8_t func;
+    uint8_t argc;
+    uint16_t reserved;
+    uint32_t thread;
+    uint32_t time_us;
+    int32_t id;
+} JniTraceRecordHeader;
+
+#ifdef JNI_TRACE
+
+// Also wraps the entry points in `functions` that jni_fake.c doesn't trace
+// itself, so must run once the table is filled.
+void jni_trace_init(struct JNINativeInterface * functions);
+
+void jni_trace_lookup(JniTraceFunc func, int id, const char * name, const char * sig);
+
+void jni_trace_call(JniTraceFunc func, jmethodID methodID, const jvalue * args, const jvalue * ret);
+
+void jni_trace_field(JniTraceFunc func, int id, char type, const jvalue * ret);
+
+// Writes out everything buffered so far. Called every frame and at exit.
+void jni_trace_flush();
+
+#define JNI_TRACE_FRAME() jni_trace_flush()
+#define JNI_TRACE_LOOKUP(func, id, name, sig) jni_trace_lookup(func, id, name, sig)
+#define JNI_TRACE_CALL(func, methodID, args, member, ret) { \
+    jvalue _rv;                                             \
+    _rv.j = 0;                                              \
+    _rv.member = (ret);                                     \
+    jni_trace_call(func, methodID, args, &_rv);             \
+}
+#define JNI_TRACE_CALL_VOID(func, methodID, args) jni_trace_call(func, methodID, args, NULL)
+#define JNI_TRACE_FIELD(func, id, type, member, ret) { \
+    jvalue _rv;                                        \
+    _rv.j = 0;                                         \
+    _rv.member = (ret);                                \
+    jni_trace_field(func, id, type, &_rv);             \
+}
+
+#else
+
+#define JNI_TRACE_FRAME()
+#define JNI_TRACE_LOOKUP(func, id, name, sig)
+#define JNI_TRACE_CALL(func, methodID, args, member, ret)
+#define JNI_TRACE_CALL_VOID(func, methodID, args)
+#define JNI_TRACE_FIELD(func, id, type, member, ret)
+
+#endif // JNI_TRACE
+
+#endif // SOLOADER_JNI_TRACE_H
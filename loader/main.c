@@ -29,6 +29,11 @@
 #include "default_dynlib.h"
 #include "utils/glutil.h"
 #include "jni_fake.h"
+#include "jni_profiler.h"
+#include "jni_trace.h"
+#include "io/io_trace.h"
+#include "io/preload.h"
+#include "io/save_writer.h"
 #include "patch.h"
 #include "utils/dialog.h"
 #include "utils/settings.h"
@@ -45,6 +50,23 @@ int _newlib_heap_size_user = MEMORY_NEWLIB_MB * 1024 * 1024;
 
 so_module so_mod;
 
+static int power_callback(int notifyId, int notifyCount, int powerInfo, void* common) {
+    // Whether the Vita is suspending or shutting down, the saves written
+    // behind the game's back have to reach the card first.
+    save_writer_flush_all();
+#ifdef IO_TRACE
+    io_trace_flush();
+#endif
+    return 0;
+}
+
+// Callbacks only run on the thread that registered them, while it waits.
+_Noreturn static void* power_thread(__attribute__((unused)) void* arg) {
+    SceUID cb = sceKernelCreateCallback("power_cb", 0, power_callback, NULL);
+    scePowerRegisterCallback(cb);
+    while (1) sceKernelDelayThreadCB(1000000);
+}
+
 int main() {
     check_kubridge();
     debugPrintf("check_kubridge() passed.\n");
@@ -118,6 +140,10 @@ int main() {
     gl_preload();
     debugPrintf("gl_preload() passed.\n");
 
+#ifdef IO_TRACE
+    io_trace_init();
+#endif
+
     so_initialize(&so_mod);
     debugPrintf("so_initialize() passed.\n");
 
@@ -126,6 +152,14 @@ int main() {
 
     loadSettings();
 
+    save_writer_init();
+    debugPrintf("save_writer_init() passed.\n");
+
+    pthread_t power_t;
+    pthread_create(&power_t, NULL, power_thread, NULL);
+
+    preload_start();
+
     // Running the .so in a thread with enlarged stack size.
     pthread_t t;
     pthread_attr_t attr;
@@ -175,7 +209,7 @@ _Noreturn void *deadspace_main() {
     NativeOnSurfaceCreated();
     debugPrintf("Java_com_ea_blast_AndroidRenderer_NativeOnSurfaceCreated() passed.\n");
 
-    NativeOnVisibilityChanged(&jni, (void*)0x42424242, 600, 1);
+    NativeOnVisibilityChanged(jni_get_env(), (void*)0x42424242, 600, 1);
     debugPrintf("Java_com_ea_blast_KeyboardAndroid_NativeOnVisibilityChanged() passed.\n");
 
     if (fpsLock > 0) {
@@ -187,6 +221,7 @@ _Noreturn void *deadspace_main() {
             if (frameNum == 2) {
                 // Delay gl_init() to second frame so that we can avoid
                 // the long black screen and keep showing pic0.png
+                preload_hide_screen();
                 gl_init();
                 debugPrintf("gl_init() passed.\n");
                 controls_init();
@@ -200,6 +235,8 @@ _Noreturn void *deadspace_main() {
             }
 
             NativeOnDrawFrame();
+            JNI_PROFILER_FRAME();
+            JNI_TRACE_FRAME();
 
             while (sceKernelGetProcessTimeLow() - last_render_time < delta) {
                 sched_yield();
@@ -215,6 +252,7 @@ _Noreturn void *deadspace_main() {
             if (frameNum == 2) {
                 // Delay gl_init() to second frame so that we can avoid
                 // the long black screen and keep showing pic0.png
+                preload_hide_screen();
                 gl_init();
                 debugPrintf("gl_init() passed.\n");
                 controls_init();
@@ -228,6 +266,8 @@ _Noreturn void *deadspace_main() {
             }
 
             NativeOnDrawFrame();
+            JNI_PROFILER_FRAME();
+            JNI_TRACE_FRAME();
 
             if (frameNum < 3) frameNum++; else gl_swap();
         }
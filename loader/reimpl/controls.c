@@ -3,6 +3,7 @@
 #include "main.h"
 #include "controls.h"
 #include "utils/settings.h"
+#include "jni_profiler.h"
 
 int lastX[SCE_TOUCH_MAX_REPORT] = {-1, -1, -1, -1, -1, -1, -1, -1};
 int lastY[SCE_TOUCH_MAX_REPORT] = {-1, -1, -1, -1, -1, -1, -1, -1};
@@ -124,10 +125,11 @@ int fakeAccelThread(SceSize args, void* argp) {
     printf("sizeof fakeAccel %i\n", count);
     for (int i = 0; i < count; ++i) {
         sceKernelDelayThread(fakeAccel[i].time * 100);
-        NativeOnAcceleration(&jni, (void*)0x42424242, fakeAccel[i].x, fakeAccel[i].y, fakeAccel[i].z);
+        NativeOnAcceleration(jni_get_env(), (void*)0x42424242, fakeAccel[i].x, fakeAccel[i].y, fakeAccel[i].z);
     }
     fakeAccelRunning = 0;
     printf("1=>0\n");
+    jni_release_env();
     return sceKernelExitDeleteThread(0);
 }
 
@@ -141,17 +143,17 @@ void pollTouch() {
             y = (int)((float)touch.report[i].y * 544.f / 1088.0f);
 
             if (lastX[i] == -1 || lastY[i] == -1) {
-                NativeOnPointerEvent(&jni, (void*)0x42424242, kIdRawPointerDown, kModuleTypeIdTouchScreen, i, (float)x, (float)y);
+                NativeOnPointerEvent(jni_get_env(), (void*)0x42424242, kIdRawPointerDown, kModuleTypeIdTouchScreen, i, (float)x, (float)y);
             }
             else if (lastX[i] != x || lastY[i] != y) {
-                NativeOnPointerEvent(&jni, (void*)0x42424242, kIdRawPointerMove, kModuleTypeIdTouchScreen, i, (float)x, (float)y);
+                NativeOnPointerEvent(jni_get_env(), (void*)0x42424242, kIdRawPointerMove, kModuleTypeIdTouchScreen, i, (float)x, (float)y);
             }
 
             lastX[i] = x;
             lastY[i] = y;
         } else {
             if (lastX[i] != -1 || lastY[i] != -1) {
-                NativeOnPointerEvent(&jni, (void*)0x42424242, kIdRawPointerUp, kModuleTypeIdTouchScreen, i, (float)lastX[i], (float)lastY[i]);
+                NativeOnPointerEvent(jni_get_env(), (void*)0x42424242, kIdRawPointerUp, kModuleTypeIdTouchScreen, i, (float)lastX[i], (float)lastY[i]);
                 lastX[i] = -1;
                 lastY[i] = -1;
             }
@@ -188,7 +190,7 @@ float touchRx_last, touchRy_last, touchLx_last, touchLy_last;
 
 int pollPad() {
     if (rDown == 1) {
-        NativeOnPointerEvent(&jni, (void *) 0x42424242, kIdRawPointerUp, kModuleTypeIdTouchPad, fingerIdR+1, touchRx_last, touchRy_last);
+        NativeOnPointerEvent(jni_get_env(), (void *) 0x42424242, kIdRawPointerUp, kModuleTypeIdTouchPad, fingerIdR+1, touchRx_last, touchRy_last);
         rDown = 0;
     }
 
@@ -201,6 +203,13 @@ int pollPad() {
         pressed_buttons = current_buttons & ~old_buttons;
         released_buttons = ~current_buttons & old_buttons;
 
+#ifdef JNI_PROFILER
+        if ((pressed_buttons & SCE_CTRL_SELECT) &&
+            (current_buttons & (SCE_CTRL_L1 | SCE_CTRL_R1)) == (SCE_CTRL_L1 | SCE_CTRL_R1)) {
+            jni_profiler_report();
+        }
+#endif
+
         for (int i = 0; i < sizeof(mapping) / sizeof(ButtonMapping); i++) {
             if (pressed_buttons & mapping[i].sce_button) {
                 //debugPrintf("NativeOnKeyDown %i\n", mapping[i].android_button);
@@ -211,14 +220,14 @@ int pollPad() {
                         sceKernelStartThread(fake_accel_thread, 0, NULL);
                     }
                 } else {
-                    NativeOnKeyDown(&jni, (void *) 0x42424242, 600, mapping[i].android_button, 1);
+                    NativeOnKeyDown(jni_get_env(), (void *) 0x42424242, 600, mapping[i].android_button, 1);
                 }
 
             }
             if (released_buttons & mapping[i].sce_button) {
                 //debugPrintf("NativeOnKeyUp %i\n", mapping[i].android_button);
                 if (mapping[i].sce_button != SCE_CTRL_UP || !fakeAccel_enabled) {
-                    NativeOnKeyUp(&jni, (void *) 0x42424242, 600, mapping[i].android_button, 1);
+                    NativeOnKeyUp(jni_get_env(), (void *) 0x42424242, 600, mapping[i].android_button, 1);
                 }
 
             }
@@ -255,22 +264,22 @@ int pollPad() {
     if (fabsf(lx) > 0.f || fabsf(ly) > 0.f) {
         lActive = 1;
     } else if (lActive) {
-        NativeOnPointerEvent(&jni, (void*)0x42424242, kIdRawPointerUp, kModuleTypeIdTouchScreen, fingerIdL+1, touchLx_last, touchLy_last);
+        NativeOnPointerEvent(jni_get_env(), (void*)0x42424242, kIdRawPointerUp, kModuleTypeIdTouchScreen, fingerIdL+1, touchLx_last, touchLy_last);
         lActive = 0;
     }
 
     if ((fabsf(rx) > 0.f || fabsf(ry) > 0.f) && !rDown) {
-        NativeOnPointerEvent(&jni, (void *) 0x42424242, kIdRawPointerDown, kModuleTypeIdTouchPad, fingerIdR+1, touchRx_base, touchRy_base);
-        NativeOnPointerEvent(&jni, (void *) 0x42424242, kIdRawPointerMove, kModuleTypeIdTouchPad, fingerIdR+1, touchRx, touchRy);
+        NativeOnPointerEvent(jni_get_env(), (void *) 0x42424242, kIdRawPointerDown, kModuleTypeIdTouchPad, fingerIdR+1, touchRx_base, touchRy_base);
+        NativeOnPointerEvent(jni_get_env(), (void *) 0x42424242, kIdRawPointerMove, kModuleTypeIdTouchPad, fingerIdR+1, touchRx, touchRy);
         rDown = 1;
     }
 
     if (fabsf(lx) > 0.f || fabsf(ly) > 0.f) {
         if (!lastLActive) {
-            NativeOnPointerEvent(&jni, (void *) 0x42424242, kIdRawPointerDown, kModuleTypeIdTouchScreen, fingerIdL+1, touchLx_base, touchLy_base);
+            NativeOnPointerEvent(jni_get_env(), (void *) 0x42424242, kIdRawPointerDown, kModuleTypeIdTouchScreen, fingerIdL+1, touchLx_base, touchLy_base);
         }
 
-        NativeOnPointerEvent(&jni, (void *) 0x42424242, kIdRawPointerMove, kModuleTypeIdTouchScreen, fingerIdL+1, touchLx, touchLy);
+        NativeOnPointerEvent(jni_get_env(), (void *) 0x42424242, kIdRawPointerMove, kModuleTypeIdTouchScreen, fingerIdL+1, touchLx, touchLy);
     }
 
     lastLActive = lActive;
@@ -326,9 +335,9 @@ void pollAccel() {
         float speed = fabsf(x + y + z - accel_last_x - accel_last_y - accel_last_z) / diffTime * 10000;
 
         if (speed > SHAKE_THRESHOLD) {
-            NativeOnAcceleration(&jni, (void*)0x42424242, x, y, z);
+            NativeOnAcceleration(jni_get_env(), (void*)0x42424242, x, y, z);
         } else {
-            NativeOnAcceleration(&jni, (void*)0x42424242, accel_last_x, accel_last_y, accel_last_z);
+            NativeOnAcceleration(jni_get_env(), (void*)0x42424242, accel_last_x, accel_last_y, accel_last_z);
         }
 
         accel_last_x = x;
@@ -23,24 +23,71 @@
 #include <errno.h>
 #include <dirent.h>
 #include <pthread.h>
+#include <time.h>
 #include <psp2/kernel/threadmgr.h>
 
+#include "io/asset_pack.h"
+#include "io/block_cache.h"
+#include "io/coaccess.h"
+#include "io/io_pool.h"
+#include "io/io_trace.h"
+#include "io/meta_cache.h"
+#include "io/preload.h"
+#include "io/readahead.h"
+#include "io/save_writer.h"
 #include "utils/utils.h"
 #include "utils/dialog.h"
 
-char* fix_path(const char * orig_path) {
-    char* path_temp = malloc(PATH_MAX * sizeof(char));
-    strcpy(path_temp, orig_path);
+typedef struct {
+    const char* from;
+    size_t from_len;
+    const char* to;
+    size_t to_len;
+} PathRewriteRule;
+
+#define PATH_RULE(from, to) { from, sizeof(from) - 1, to, sizeof(to) - 1 }
+
+// Where the game looks for files vs. where they are. The first rule whose
+// `from` is a prefix of the path wins, so longer prefixes go first. Paths
+// that match no rule are used as is.
+static const PathRewriteRule pathRewriteRules[] = {
+    PATH_RULE(DATA_PATH "Android/data/com.ea.deadspace/files/published", DATA_PATH_INT "published"),
+    PATH_RULE(DATA_PATH "Android/data/com.ea.deadspace/files/", DATA_PATH),
+    PATH_RULE(DATA_PATH "published", DATA_PATH_INT "published"),
+    PATH_RULE("appbundle:/", DATA_PATH_INT),
+};
 
-    if (strstr(path_temp, "appbundle:/")) {
-        path_temp = strremove(path_temp, "appbundle:/");
-        strprepend(path_temp, DATA_PATH_INT);
-        return path_temp;
+/*
+ * Translates `orig_path` into `out`, which has room for `size` bytes.
+ * Returns 0, or -1 with errno set to ENAMETOOLONG if the result doesn't fit.
+ */
+int fix_path(const char * orig_path, char * out, size_t size) {
+    const PathRewriteRule * rule = NULL;
+
+    for (size_t i = 0; i < sizeof(pathRewriteRules) / sizeof(pathRewriteRules[0]); i++) {
+        const PathRewriteRule * r = &pathRewriteRules[i];
+        if (orig_path[0] == r->from[0] && strncmp(orig_path, r->from, r->from_len) == 0) {
+            rule = r;
+            break;
+        }
+    }
+
+    const char * rest = orig_path;
+    size_t len = 0;
+    if (rule) {
+        rest += rule->from_len;
+        len = rule->to_len;
+    }
+
+    size_t rest_len = strlen(rest);
+    if (len + rest_len + 1 > size) {
+        errno = ENAMETOOLONG;
+        return -1;
     }
 
-    path_temp = strremove(path_temp, "Android/data/com.ea.deadspace/files/");
-    path_temp = strreplace(path_temp, "deadspace/published", "deadspace/assets/published");
-    return path_temp;
+    if (rule) memcpy(out, rule->to, rule->to_len);
+    memcpy(out + len, rest, rest_len + 1);
+    return 0;
 }
 
 dirent64_bionic * dirent_newlib_to_dirent_bionic(struct dirent* dirent_newlib) {
@@ -75,56 +122,219 @@ int readdir_r_soloader(DIR *dirp, dirent64_bionic *entry, dirent64_bionic **resu
     return ret;
 }
 
-FILE *fopen_soloader(char *fname, char *mode) {
+static int pack_cookie_read(void* cookie, char* buf, int n) {
+    return asset_pack_read((int)(intptr_t)cookie, buf, n);
+}
+
+static fpos_t pack_cookie_seek(void* cookie, fpos_t offset, int whence) {
+    return (fpos_t)asset_pack_lseek((int)(intptr_t)cookie, offset, whence);
+}
+
+static int pack_cookie_close(void* cookie) {
+    return asset_pack_close((int)(intptr_t)cookie);
+}
+
+static FILE* fopen_untraced(char *fname, char *mode) {
+    // Don't get ahead of a commit of the same save.
+    save_writer_flush(fname);
+
+    if (!strpbrk(mode, "wa+")) {
+        int vfd = asset_pack_open(fname);
+        if (vfd >= 0) {
+            FILE* ret = funopen((void*)(intptr_t)vfd, pack_cookie_read, NULL, pack_cookie_seek, pack_cookie_close);
+            if (ret) {
+                debugPrintf("[io] fopen(%s): 0x%x (packed)\n", fname, ret);
+                return ret;
+            }
+            asset_pack_close(vfd);
+        }
+    }
+
     FILE* ret =  fopen(fname, mode);
     debugPrintf("[io] fopen(%s): 0x%x\n", fname, ret);
+
+    if (ret && strpbrk(mode, "wa+")) {
+        // Writes through the FILE can't be seen, so the size is refreshed
+        // on fclose().
+        meta_cache_invalidate(fname);
+        block_cache_invalidate(fname);
+        meta_cache_track_fd(fileno(ret), fname);
+    } else if (ret) {
+        preload_note_open(fname);
+        coaccess_note_open(fname);
+    }
     return ret;
 }
 
-int open_soloader(char *_fname, int flags) {
-    char* fname = fix_path(_fname);
+FILE *fopen_soloader(char *fname, char *mode) {
+    IO_TRACE_BEGIN(t);
+    FILE* ret = fopen_untraced(fname, mode);
+    IO_TRACE_PATH(t, IO_TRACE_FOPEN, 0, fname, ret ? (int)(intptr_t)ret : -1, ret ? 0 : -1);
+    return ret;
+}
+
+int fclose_soloader(FILE * f) {
+    IO_TRACE_BEGIN(t);
+
+    // Files opened for writing are tracked by the stat cache. Their blocks
+    // cached while they were open are stale once the FILE's buffer is out.
+    char written[PATH_MAX];
+    int was_written = f && meta_cache_fd_path(fileno(f), written, sizeof(written));
+    if (f) meta_cache_untrack_fd(fileno(f));
+
+    int ret = fclose(f);
+    if (was_written) block_cache_invalidate(written);
+
+    IO_TRACE_FD(t, IO_TRACE_FCLOSE, 0, (int)(intptr_t)f, 0, ret);
+    return ret;
+}
+
+static int open_untraced(const char *fname, int flags) {
+    // bionic's O_ACCMODE is 3, O_RDONLY is 0, O_CREAT is 0x40 and O_TRUNC
+    // is 0x200.
+    int writes = (flags & 3) != 0 || (flags & 0x240) != 0;
+
+    if (save_writer_is_save(fname)) {
+        // Saves are always opened with O_RDWR | O_CREAT | O_TRUNC, written
+        // in memory and committed in the background. Reading one that isn't
+        // committed yet reads the data in memory.
+        int vfd = -1;
+        if (flags == 0x242) vfd = save_writer_open(fname, 1);
+        else if (!writes) vfd = save_writer_open(fname, 0);
+
+        if (vfd >= 0) {
+            debugPrintf("[io] open(%s, %x): %i (save)\n", fname, flags, vfd);
+            return vfd;
+        }
+        if (writes) save_writer_flush(fname);
+    }
+
+    if (!writes) {
+        int vfd = asset_pack_open(fname);
+        if (vfd >= 0) {
+            debugPrintf("[io] open(%s, %x): %i (packed)\n", fname, flags, vfd);
+            return vfd;
+        }
+
+        if (meta_cache_peek(fname, NULL) == 0) {
+            errno = ENOENT;
+            return -1;
+        }
+    }
 
     int ret = open(fname, flags);
     debugPrintf("[io] open(%s, %x): %i\n", fname, flags, ret);
 
-    if (ret > 0 && flags == 0x242 && (strstr(fname, "CheckpointSave") || strstr(fname, "LevelSave")
-                                        || strstr(fname, "settings.sb") || strstr(fname, "AchievementsSave.sb")) ) {
-        close_soloader(ret);
-        fclose(fopen(fname, "w"));
-        debugPrintf("[io] open(): killed the contents of %s.\n", fname);
-        ret = open(fname, flags);
+    if (writes) {
+        meta_cache_invalidate(fname);
+        block_cache_invalidate(fname);
+        if (ret >= 0) meta_cache_track_fd(ret, fname);
+    } else if (ret >= 0) {
+        block_cache_open(ret, fname);
+        readahead_open(ret);
+        preload_note_open(fname);
+        coaccess_note_open(fname);
     }
 
-    free(fname);
+    return ret;
+}
+
+int open_soloader(char *_fname, int flags) {
+    return open_soloader_from(_fname, flags, 0);
+}
+
+int open_soloader_from(const char *_fname, int flags, uint8_t from) {
+    char fname[PATH_MAX];
+    if (fix_path(_fname, fname, sizeof(fname)) != 0) return -1;
+
+    IO_TRACE_BEGIN(t);
+    int ret = open_untraced(fname, flags);
+    IO_TRACE_PATH(t, IO_TRACE_OPEN, from, fname, ret, ret);
     return ret;
 }
 
 int read_soloader(int __fd, void *__buf, size_t __nbyte) {
-    int ret = read(__fd, __buf, __nbyte);
+    return read_soloader_from(__fd, __buf, __nbyte, 0);
+}
+
+int read_soloader_from(int __fd, void *__buf, size_t __nbyte, uint8_t from) {
+    IO_TRACE_BEGIN(t);
+    uint32_t begin = io_pool_foreground_begin();
+    int ret;
+
+    if (asset_pack_is_fd(__fd)) {
+        ret = asset_pack_read(__fd, __buf, (int)__nbyte);
+    } else if (save_writer_is_fd(__fd)) {
+        ret = save_writer_read(__fd, __buf, (int)__nbyte);
+    } else if (readahead_is_tracked(__fd)) {
+        ret = readahead_read(__fd, __buf, (int)__nbyte);
+    } else if (block_cache_is_tracked(__fd)) {
+        ret = block_cache_read(__fd, __buf, (int)__nbyte);
+    } else {
+        ret = read(__fd, __buf, __nbyte);
+    }
+
+    io_pool_foreground_end(begin);
+    IO_TRACE_FD(t, IO_TRACE_READ, from, __fd, (int32_t)__nbyte, ret);
     //debugPrintf("[io] read(fd#%i, %x, %i): %i\n", __fd, (int)__buf, __nbyte, ret);
     return ret;
 }
 
 DIR* opendir_soloader(char* _pathname) {
-    char * pathname = fix_path(_pathname);
-    DIR* ret = opendir(pathname);
+    char pathname[PATH_MAX];
+    if (fix_path(_pathname, pathname, sizeof(pathname)) != 0) return NULL;
+
+    IO_TRACE_BEGIN(t);
+    DIR* ret = NULL;
+    struct stat st;
+    int cached = meta_cache_peek(pathname, &st);
+    if (cached == 0 || (cached == 1 && !S_ISDIR(st.st_mode))) {
+        errno = cached ? ENOTDIR : ENOENT;
+    } else {
+        ret = opendir(pathname);
+        if (!ret && errno == ENOENT) meta_cache_put_missing(pathname);
+    }
+    IO_TRACE_PATH(t, IO_TRACE_OPENDIR, 0, pathname, -1, ret ? 0 : -1);
+
     debugPrintf("[io] opendir(\"%s\"): 0x%x\n", pathname, ret);
-    free(pathname);
     return ret;
 }
 
 int fstat_soloader(int fd, void *statbuf) {
-    struct stat st;
-    int res = fstat(fd, &st);
-    if (res == 0)
-        *(uint64_t *)(statbuf + 0x30) = st.st_size;
+    IO_TRACE_BEGIN(t);
+    int res = 0;
+
+    if (asset_pack_is_fd(fd)) {
+        int64_t size = asset_pack_fsize(fd);
+        if (size < 0) res = -1;
+        else *(uint64_t *)(statbuf + 0x30) = size;
+    } else if (save_writer_is_fd(fd)) {
+        *(uint64_t *)(statbuf + 0x30) = save_writer_fsize(fd);
+    } else {
+        struct stat st;
+        res = fstat(fd, &st);
+        if (res == 0)
+            *(uint64_t *)(statbuf + 0x30) = st.st_size;
+
+        debugPrintf("[io] fstat(fd#%i): %i\n", fd, res);
+    }
 
-    debugPrintf("[io] fstat(fd#%i): %i\n", fd, res);
+    IO_TRACE_FD(t, IO_TRACE_FSTAT, 0, fd, 0, res);
     return res;
 }
 
 int write_soloader(int fd, const void *buf, int count) {
-    int ret = write(fd, buf, count);
+    IO_TRACE_BEGIN(t);
+    int ret;
+
+    if (save_writer_is_fd(fd)) {
+        ret = save_writer_write(fd, buf, count);
+    } else {
+        ret = write(fd, buf, count);
+        meta_cache_fd_written(fd);
+    }
+
+    IO_TRACE_FD(t, IO_TRACE_WRITE, 0, fd, count, ret);
     //debugPrintf("[io] write(fd#%i, 0x%x, %i): %i\n", fd, buf, count, ret);
     return ret;
 }
@@ -135,19 +345,64 @@ int fcntl_soloader(int fd, int cmd, ... /* arg */ ) {
 }
 
 int fsync_soloader(int fd) {
-    int ret = fsync(fd);
-    debugPrintf("[io] fsync(fd#%i): %i\n", fd, ret);
-    return fsync(fd);
+    IO_TRACE_BEGIN(t);
+    int ret = 0;
+
+    // Saves are synced when they're committed.
+    if (!save_writer_is_fd(fd)) {
+        ret = fsync(fd);
+        debugPrintf("[io] fsync(fd#%i): %i\n", fd, ret);
+    }
+
+    IO_TRACE_FD(t, IO_TRACE_FSYNC, 0, fd, 0, ret);
+    return ret;
 }
 
 off_t lseek_soloader(int fildes, off_t offset, int whence) {
-    off_t ret = lseek(fildes, offset, whence);
+    return lseek_soloader_from(fildes, offset, whence, 0);
+}
+
+off_t lseek_soloader_from(int fildes, off_t offset, int whence, uint8_t from) {
+    IO_TRACE_BEGIN(t);
+    off_t ret;
+
+    if (asset_pack_is_fd(fildes)) {
+        ret = (off_t)asset_pack_lseek(fildes, offset, whence);
+    } else if (save_writer_is_fd(fildes)) {
+        ret = (off_t)save_writer_lseek(fildes, offset, whence);
+    } else if (readahead_is_tracked(fildes)) {
+        ret = (off_t)readahead_lseek(fildes, offset, whence);
+    } else if (block_cache_is_tracked(fildes)) {
+        ret = (off_t)block_cache_lseek(fildes, offset, whence);
+    } else {
+        ret = lseek(fildes, offset, whence);
+    }
+
+    IO_TRACE_FD(t, IO_TRACE_LSEEK, from, fildes, whence, ret);
     //debugPrintf("[io] lseek(fd#i, %i, %i): %i\n", fildes, offset, whence, ret);
     return ret;
 }
 
 int close_soloader(int fd) {
-    int ret = close(fd);
+    return close_soloader_from(fd, 0);
+}
+
+int close_soloader_from(int fd, uint8_t from) {
+    IO_TRACE_BEGIN(t);
+    int ret;
+
+    if (asset_pack_is_fd(fd)) {
+        ret = asset_pack_close(fd);
+    } else if (save_writer_is_fd(fd)) {
+        ret = save_writer_close(fd);
+    } else {
+        meta_cache_untrack_fd(fd);
+        readahead_close(fd);
+        block_cache_close(fd);
+        ret = close(fd);
+    }
+
+    IO_TRACE_FD(t, IO_TRACE_CLOSE, from, fd, 0, ret);
     //debugPrintf("[io] close(fd#%i): %i\n", fd, ret);
     return ret;
 }
@@ -158,11 +413,124 @@ int closedir_soloader(DIR* dir) {
     return ret;
 }
 
+int ftruncate_soloader(int fd, off_t length) {
+    IO_TRACE_BEGIN(t);
+    int ret;
+
+    if (save_writer_is_fd(fd)) {
+        ret = save_writer_ftruncate(fd, length);
+    } else {
+        ret = ftruncate(fd, length);
+        meta_cache_fd_written(fd);
+    }
+
+    IO_TRACE_FD(t, IO_TRACE_FTRUNCATE, 0, fd, (int32_t)length, ret);
+    return ret;
+}
+
+int unlink_soloader(char *_pathname) {
+    char pathname[PATH_MAX];
+    if (fix_path(_pathname, pathname, sizeof(pathname)) != 0) return -1;
+
+    IO_TRACE_BEGIN(t);
+    save_writer_drop(pathname);
+    int ret = unlink(pathname);
+    meta_cache_invalidate(pathname);
+    block_cache_invalidate(pathname);
+    IO_TRACE_PATH(t, IO_TRACE_UNLINK, 0, pathname, -1, ret);
+    debugPrintf("[io] unlink(%s): %i\n", pathname, ret);
+    return ret;
+}
+
+int remove_soloader(char *_pathname) {
+    char pathname[PATH_MAX];
+    if (fix_path(_pathname, pathname, sizeof(pathname)) != 0) return -1;
+
+    IO_TRACE_BEGIN(t);
+    save_writer_drop(pathname);
+    int ret = remove(pathname);
+    meta_cache_invalidate(pathname);
+    block_cache_invalidate(pathname);
+    IO_TRACE_PATH(t, IO_TRACE_REMOVE, 0, pathname, -1, ret);
+    debugPrintf("[io] remove(%s): %i\n", pathname, ret);
+    return ret;
+}
+
+int rename_soloader(char *_oldpath, char *_newpath) {
+    char oldpath[PATH_MAX], newpath[PATH_MAX];
+    if (fix_path(_oldpath, oldpath, sizeof(oldpath)) != 0) return -1;
+    if (fix_path(_newpath, newpath, sizeof(newpath)) != 0) return -1;
+
+    IO_TRACE_BEGIN(t);
+    save_writer_flush(oldpath);
+    save_writer_drop(newpath);
+    int ret = rename(oldpath, newpath);
+    meta_cache_invalidate(oldpath);
+    block_cache_invalidate(oldpath);
+    meta_cache_invalidate(newpath);
+    block_cache_invalidate(newpath);
+    IO_TRACE_RENAME(t, oldpath, newpath, ret);
+    debugPrintf("[io] rename(%s, %s): %i\n", oldpath, newpath, ret);
+    return ret;
+}
+
+int mkdir_soloader(char *_pathname, mode_t mode) {
+    char pathname[PATH_MAX];
+    if (fix_path(_pathname, pathname, sizeof(pathname)) != 0) return -1;
+
+    IO_TRACE_BEGIN(t);
+    int ret = mkdir(pathname, mode);
+    meta_cache_invalidate(pathname);
+    IO_TRACE_PATH(t, IO_TRACE_MKDIR, 0, pathname, -1, ret);
+    debugPrintf("[io] mkdir(%s): %i\n", pathname, ret);
+    return ret;
+}
+
+int rmdir_soloader(char *_pathname) {
+    char pathname[PATH_MAX];
+    if (fix_path(_pathname, pathname, sizeof(pathname)) != 0) return -1;
+
+    IO_TRACE_BEGIN(t);
+    int ret = rmdir(pathname);
+    meta_cache_invalidate(pathname);
+    IO_TRACE_PATH(t, IO_TRACE_RMDIR, 0, pathname, -1, ret);
+    debugPrintf("[io] rmdir(%s): %i\n", pathname, ret);
+    return ret;
+}
+
 int stat_soloader(char *_pathname, stat64_bionic *statbuf) {
-    char* pathname = fix_path(_pathname);
+    char pathname[PATH_MAX];
+    if (fix_path(_pathname, pathname, sizeof(pathname)) != 0) return -1;
 
+    IO_TRACE_BEGIN(t);
     struct stat st;
-    int res = stat(pathname, &st);
+    int64_t packed_size, save_size;
+    int packed = asset_pack_stat(pathname, &packed_size);
+    int res;
+
+    if (save_writer_stat(pathname, &save_size)) {
+        // Not committed yet, the card still has the previous save.
+        memset(&st, 0, sizeof(st));
+        st.st_mode = S_IFREG | 0666;
+        st.st_nlink = 1;
+        st.st_size = (off_t)save_size;
+        st.st_blksize = 512;
+        st.st_blocks = (save_size + 511) / 512;
+        st.st_mtime = time(NULL);
+        res = 0;
+    } else if (packed) {
+        // Packed files never hit the memory card.
+        memset(&st, 0, sizeof(st));
+        st.st_mode = (packed == 2) ? (S_IFDIR | 0555) : (S_IFREG | 0444);
+        st.st_nlink = 1;
+        st.st_size = (off_t)packed_size;
+        st.st_blksize = 512;
+        st.st_blocks = (packed_size + 511) / 512;
+        res = 0;
+    } else {
+        res = meta_cache_stat(pathname, &st);
+    }
+    IO_TRACE_PATH(t, IO_TRACE_STAT, 0, pathname, -1, res);
 
     if (res == 0) {
         if (!statbuf) {
@@ -187,7 +555,6 @@ int stat_soloader(char *_pathname, stat64_bionic *statbuf) {
     }
 
     //debugPrintf("[io] stat(%s): %i", pathname, res);
-    free(pathname);
     return res;
 }
 
@@ -203,11 +570,17 @@ off_t ftello_soloader(FILE * a) {
     return ret;
 }
 
-int ffullread(FILE *f, void **dataptr, size_t *sizeptr, size_t chunk) {
-    char *data = NULL, *temp;
-    size_t size = 0;
-    size_t used = 0;
-    size_t n;
+/*
+ * Reads the rest of `f` into one buffer. What fits in `chunk` bytes is read
+ * in one go. Past that, the remaining size is taken from the stream's end
+ * position, so regular files take one more allocation and, normally, one
+ * more read; the spare byte for the terminating NUL also catches a file
+ * that grew meanwhile. Streams that can't seek double from there.
+ */
+static int ffullread_untraced(FILE *f, void **dataptr, size_t *sizeptr, size_t chunk) {
+    char *data, *temp;
+    size_t size;
+    size_t used;
 
     if (f == NULL || dataptr == NULL || sizeptr == NULL)
         return FFULLREAD_INVALID;
@@ -215,15 +588,54 @@ int ffullread(FILE *f, void **dataptr, size_t *sizeptr, size_t chunk) {
     if (sceLibcBridge_ferror(f))
         return FFULLREAD_ERROR;
 
-    while (1) {
-        if (used + chunk + 1 > size) {
-            size = used + chunk + 1;
+    // Most files fit in the first chunk, and finding out the size costs two
+    // seeks, more than the chunk-sized read. So only files that don't fit
+    // have it looked up.
+    size = chunk + 1;
+    if (size == 0)
+        return FFULLREAD_TOOMUCH;
+
+    data = malloc(size);
+    if (data == NULL)
+        return FFULLREAD_NOMEM;
+
+    used = sceLibcBridge_fread(data, 1, size, f);
+    int more = used == size;
+
+    if (more) {
+        // There's no fileno() for SceLibc streams to fstat(), so the size
+        // comes from seeking to the end and back.
+        long pos = sceLibcBridge_ftell(f);
+        long end = -1;
+        if (pos >= 0 && sceLibcBridge_fseek(f, 0, SEEK_END) == 0) {
+            end = sceLibcBridge_ftell(f);
+            if (sceLibcBridge_fseek(f, pos, SEEK_SET) != 0) {
+                free(data);
+                return FFULLREAD_ERROR;
+            }
+        }
 
+        if (end >= pos && pos >= 0 && used + (size_t)(end - pos) + 1 > used) {
+            size = used + (size_t)(end - pos) + 1;
+            temp = realloc(data, size);
+            if (temp == NULL) {
+                free(data);
+                return FFULLREAD_NOMEM;
+            }
+            data = temp;
+        }
+    }
+
+    // Every read asks for all the room left, so a short one means the end
+    // of the stream, or an error.
+    while (more) {
+        if (used == size) {
             // Overflow check
-            if (size <= used) {
+            if (size * 2 <= size) {
                 free(data);
                 return FFULLREAD_TOOMUCH;
             }
+            size *= 2;
 
             temp = realloc(data, size);
             if (temp == NULL) {
@@ -233,10 +645,8 @@ int ffullread(FILE *f, void **dataptr, size_t *sizeptr, size_t chunk) {
             data = temp;
         }
 
-        n = sceLibcBridge_fread(data + used, 1, chunk, f);
-        if (n == 0)
-            break;
-
+        size_t n = sceLibcBridge_fread(data + used, 1, size - used, f);
+        more = n == size - used;
         used += n;
     }
 
@@ -245,12 +655,20 @@ int ffullread(FILE *f, void **dataptr, size_t *sizeptr, size_t chunk) {
         return FFULLREAD_ERROR;
     }
 
-    temp = realloc(data, used + 1);
-    if (temp == NULL) {
-        free(data);
-        return FFULLREAD_NOMEM;
+    // Only inputs shorter than a chunk and streams of unknown size leave
+    // slack behind, or no room for the NUL.
+    if (size != used + 1) {
+        if (used + 1 == 0) {
+            free(data);
+            return FFULLREAD_TOOMUCH;
+        }
+        temp = realloc(data, used + 1);
+        if (temp == NULL) {
+            free(data);
+            return FFULLREAD_NOMEM;
+        }
+        data = temp;
     }
-    data = temp;
     data[used] = '\0';
 
     *dataptr = data;
@@ -258,3 +676,10 @@ int ffullread(FILE *f, void **dataptr, size_t *sizeptr, size_t chunk) {
 
     return FFULLREAD_OK;
 }
+
+int ffullread(FILE *f, void **dataptr, size_t *sizeptr, size_t chunk) {
+    IO_TRACE_BEGIN(t);
+    int ret = ffullread_untraced(f, dataptr, sizeptr, chunk);
+    IO_TRACE_FD(t, IO_TRACE_FFULLREAD, 0, (int)(intptr_t)f, (ret == FFULLREAD_OK) ? (int32_t)*sizeptr : 0, ret);
+    return ret;
+}
@@ -15,7 +15,9 @@
 #ifndef SOLOADER_IO_H
 #define SOLOADER_IO_H
 
+#include <stdint.h>
 #include <stdio.h>
+#include <sys/types.h>
 #include <sys/dirent.h>
 #include <sys/syslimits.h>
 
@@ -94,6 +96,20 @@ int close_soloader(int fd);
 
 int stat_soloader(char *pathname, stat64_bionic *statbuf);
 
+int fclose_soloader(FILE * f);
+
+int ftruncate_soloader(int fd, off_t length);
+
+int unlink_soloader(char *pathname);
+
+int remove_soloader(char *pathname);
+
+int rename_soloader(char *oldpath, char *newpath);
+
+int mkdir_soloader(char *pathname, mode_t mode);
+
+int rmdir_soloader(char *pathname);
+
 int fseeko_soloader(FILE * a, off_t b, int c);
 
 off_t ftello_soloader(FILE * a);
@@ -104,6 +120,13 @@ int fsync_soloader(int fd);
 
 off_t lseek_soloader(int fildes, off_t offset, int whence);
 
+// The same as the above, with `from` set as the flags of the I/O trace
+// records (IO_TRACE_FROM_STREAM for java.io.InputStream).
+int open_soloader_from(const char *fname, int flags, uint8_t from);
+int read_soloader_from(int fd, void *buf, size_t nbyte, uint8_t from);
+off_t lseek_soloader_from(int fildes, off_t offset, int whence, uint8_t from);
+int close_soloader_from(int fd, uint8_t from);
+
 /*
  * Stuff related to in-memory assets preloading.
  */
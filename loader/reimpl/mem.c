@@ -11,25 +11,345 @@
  * of the MIT license. See the LICENSE file for details.
  */
 
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <psp2/kernel/processmgr.h>
 #include "mem.h"
+#include "io.h"
+#include "io/asset_pack.h"
+#include "io/io_pool.h"
+#include "utils/utils.h"
+
+/*
+ * There are no page faults to hook here, so mappings are plain heap blocks:
+ * file-backed ones are filled with one bulk read at mmap() time, and
+ * anonymous ones come zeroed from zeroPool when it has a fitting block.
+ * Read-only mappings of the same packed file range share one copy.
+ */
+
+typedef struct {
+    int entry;     // packed file index
+    off_t offs;
+    size_t length;
+    void* addr;
+    int refs;
+} SharedMapping;
+
+typedef struct {
+    void* addr;
+    size_t length;
+    SharedMapping* shared; // NULL if the mapping owns addr
+} Mapping;
+
+static Mapping* mappings = NULL;
+static int mappings_count = 0;
+static int mappings_size = 0;
+
+static SharedMapping* sharedMappings[MEM_SHARED_MAPPINGS_MAX];
+
+static pthread_mutex_t mappings_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+    void* addr;  // NULL if the slot is free
+    size_t size;
+    uint32_t pooled_at; // us
+} ZeroBlock;
+
+// Blocks zeroed in advance by idle jobs, sized after recent anonymous
+// mappings; the game tends to map the same sizes over and over.
+static ZeroBlock zeroPool[MEM_ZERO_POOL_SLOTS];
+static size_t zeroPool_bytes = 0; // pooled or being zeroed
+
+static pthread_mutex_t zeroPool_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 void *sceClibMemclr(void *dst, SceSize len) {
     return sceClibMemset(dst, 0, len);
 }
 
+static void zero_pool_fill(void* arg) {
+    size_t size = (size_t)(uintptr_t)arg;
+    void* p = memalign(MEM_PAGE_SIZE, size);
+    if (p) memset(p, 0, size);
+
+    pthread_mutex_lock(&zeroPool_mutex);
+    int i = 0;
+    while (p && i < MEM_ZERO_POOL_SLOTS && zeroPool[i].addr) i++;
+    if (p && i < MEM_ZERO_POOL_SLOTS) {
+        zeroPool[i].addr = p;
+        zeroPool[i].size = size;
+        zeroPool[i].pooled_at = sceKernelGetProcessTimeLow();
+        p = NULL;
+    } else {
+        zeroPool_bytes -= size;
+    }
+    pthread_mutex_unlock(&zeroPool_mutex);
+
+    free(p);
+}
+
+// Frees the pooled blocks idle for longer than `idle_ms`, all of them with 0.
+// Returns the number of bytes freed.
+static size_t zero_pool_trim(uint32_t idle_ms) {
+    void* to_free[MEM_ZERO_POOL_SLOTS];
+    int count = 0;
+    size_t freed = 0;
+    uint32_t now = sceKernelGetProcessTimeLow();
+
+    pthread_mutex_lock(&zeroPool_mutex);
+    for (int i = 0; i < MEM_ZERO_POOL_SLOTS; i++) {
+        if (zeroPool[i].addr && now - zeroPool[i].pooled_at >= idle_ms * 1000) {
+            to_free[count++] = zeroPool[i].addr;
+            freed += zeroPool[i].size;
+            zeroPool_bytes -= zeroPool[i].size;
+            zeroPool[i].addr = NULL;
+        }
+    }
+    pthread_mutex_unlock(&zeroPool_mutex);
+
+    for (int i = 0; i < count; i++) free(to_free[i]);
+    return freed;
+}
+
+// memalign() that gives the zero pool back and tries again when it fails.
+static void* page_alloc(size_t length) {
+    void* ret = memalign(MEM_PAGE_SIZE, length);
+    if (!ret && zero_pool_trim(0) > 0) ret = memalign(MEM_PAGE_SIZE, length);
+    return ret;
+}
+
+static void* anonymous_alloc(size_t length) {
+    void* ret = NULL;
+
+    zero_pool_trim(MEM_ZERO_POOL_IDLE_MS);
+
+    pthread_mutex_lock(&zeroPool_mutex);
+    for (int i = 0; i < MEM_ZERO_POOL_SLOTS; i++) {
+        // A bit of slack is fine, the rest of the block just goes unused.
+        if (zeroPool[i].addr && zeroPool[i].size >= length && zeroPool[i].size - length <= length / 4) {
+            ret = zeroPool[i].addr;
+            zeroPool_bytes -= zeroPool[i].size;
+            zeroPool[i].addr = NULL;
+            break;
+        }
+    }
+
+    // Have another one of this size ready for next time.
+    int refill = length <= MEM_ZERO_POOL_MAX / 2 && zeroPool_bytes + length <= MEM_ZERO_POOL_MAX;
+    if (refill) zeroPool_bytes += length;
+    pthread_mutex_unlock(&zeroPool_mutex);
+
+    if (refill && io_pool_submit(IO_CLASS_IDLE, zero_pool_fill, (void*)(uintptr_t)length) != 0) {
+        pthread_mutex_lock(&zeroPool_mutex);
+        zeroPool_bytes -= length;
+        pthread_mutex_unlock(&zeroPool_mutex);
+    }
+
+    if (!ret) {
+        ret = page_alloc(length);
+        if (ret) memset(ret, 0, length);
+    }
+    return ret;
+}
+
+// Reads `length` bytes at `offs` of `fd` into `dst` without moving the fd's
+// position; whatever is past the end of the file reads as zeros.
+static int file_read(int fd, void* dst, size_t length, off_t offs) {
+    off_t pos = lseek_soloader(fd, 0, SEEK_CUR);
+    if (pos < 0 || lseek_soloader(fd, offs, SEEK_SET) < 0) return -1;
+
+    size_t total = 0;
+    while (total < length) {
+        int n = read_soloader(fd, (uint8_t*)dst + total, length - total);
+        if (n < 0) {
+            lseek_soloader(fd, pos, SEEK_SET);
+            return -1;
+        }
+        if (n == 0) break;
+        total += n;
+    }
+
+    if (total < length) memset((uint8_t*)dst + total, 0, length - total);
+    lseek_soloader(fd, pos, SEEK_SET);
+    return 0;
+}
+
+// Must be called with mappings_mutex held.
+static int track_locked(void* addr, size_t length, SharedMapping* shared) {
+    if (mappings_count == mappings_size) {
+        int size = mappings_size ? mappings_size * 2 : 64;
+        Mapping* m = realloc(mappings, size * sizeof(Mapping));
+        if (!m) return -1;
+        mappings = m;
+        mappings_size = size;
+    }
+
+    mappings[mappings_count].addr = addr;
+    mappings[mappings_count].length = length;
+    mappings[mappings_count].shared = shared;
+    mappings_count++;
+    return 0;
+}
+
+// Must be called with mappings_mutex held.
+static Mapping* find_locked(const void* addr, size_t length) {
+    for (int i = 0; i < mappings_count; i++) {
+        const uint8_t* start = mappings[i].addr;
+        if ((const uint8_t*)addr >= start && (const uint8_t*)addr + length <= start + mappings[i].length) {
+            return &mappings[i];
+        }
+    }
+    return NULL;
+}
+
+static void* map_shared_packed(int entry, size_t length, int fd, off_t offs) {
+    pthread_mutex_lock(&mappings_mutex);
+    int free_slot = -1;
+    for (int i = 0; i < MEM_SHARED_MAPPINGS_MAX; i++) {
+        SharedMapping* s = sharedMappings[i];
+        if (!s) {
+            if (free_slot < 0) free_slot = i;
+            continue;
+        }
+        if (s->entry == entry && s->offs == offs && s->length >= length) {
+            if (track_locked(s->addr, length, s) != 0) break;
+            s->refs++;
+            pthread_mutex_unlock(&mappings_mutex);
+            return s->addr;
+        }
+    }
+    pthread_mutex_unlock(&mappings_mutex);
+
+    SharedMapping* s = malloc(sizeof(SharedMapping));
+    void* addr = page_alloc(length);
+    if (!s || !addr || file_read(fd, addr, length, offs) != 0) {
+        free(s);
+        free(addr);
+        return NULL;
+    }
+    s->entry = entry;
+    s->offs = offs;
+    s->length = length;
+    s->addr = addr;
+    s->refs = 1;
+
+    pthread_mutex_lock(&mappings_mutex);
+    if (track_locked(addr, length, s) != 0) {
+        pthread_mutex_unlock(&mappings_mutex);
+        free(s);
+        free(addr);
+        return NULL;
+    }
+    // Without a free slot it's just not shared with later mappings.
+    if (free_slot >= 0 && !sharedMappings[free_slot]) sharedMappings[free_slot] = s;
+    pthread_mutex_unlock(&mappings_mutex);
+    return addr;
+}
+
 void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offs) {
-    //fprintf(stderr, "mmap(addr: 0x%x, length: %i, prot: %i, flags: %i, fd %i, offs: %i: ", (int)addr, length, prot, flags, fd, offs);
-    void* ret= malloc(length);
-    //fprintf(stderr, "ret 0x%x\n", (int)ret);
-    memset(ret, 0, length);
+    if (length == 0 || offs < 0 || (offs & (MEM_PAGE_SIZE - 1))) {
+        errno = EINVAL;
+        return MAP_FAILED_BIONIC;
+    }
+
+    int anonymous = (flags & MAP_ANONYMOUS_BIONIC) || fd < 0;
+
+    if (flags & MAP_FIXED_BIONIC) {
+        // Only remapping a part of one of our own mappings can be done,
+        // e.g. allocators zeroing memory they've released.
+        pthread_mutex_lock(&mappings_mutex);
+        Mapping* m = find_locked(addr, length);
+        int ok = m && !m->shared;
+        pthread_mutex_unlock(&mappings_mutex);
+
+        if (!ok) {
+            debugPrintf("[mem] mmap(0x%x, %i, MAP_FIXED) outside of a mapping.\n", addr, length);
+            errno = ENOMEM;
+            return MAP_FAILED_BIONIC;
+        }
+        if (anonymous) {
+            memset(addr, 0, length);
+        } else if (file_read(fd, addr, length, offs) != 0) {
+            return MAP_FAILED_BIONIC;
+        }
+        return addr;
+    }
+
+    void* ret;
+    if (anonymous) {
+        ret = anonymous_alloc(length);
+    } else {
+        if ((flags & MAP_SHARED_BIONIC) && (prot & PROT_WRITE_BIONIC)) {
+            debugPrintf("[mem] mmap(fd#%i): writes won't reach the file.\n", fd);
+        }
+
+        int entry = asset_pack_entry(fd);
+        if (entry >= 0 && !(prot & PROT_WRITE_BIONIC)) {
+            ret = map_shared_packed(entry, length, fd, offs);
+            if (!ret) {
+                errno = ENOMEM;
+                return MAP_FAILED_BIONIC;
+            }
+            return ret;
+        }
+
+        ret = page_alloc(length);
+        if (ret && file_read(fd, ret, length, offs) != 0) {
+            free(ret);
+            return MAP_FAILED_BIONIC;
+        }
+    }
+
+    if (!ret) {
+        errno = ENOMEM;
+        return MAP_FAILED_BIONIC;
+    }
+
+    pthread_mutex_lock(&mappings_mutex);
+    int tracked = track_locked(ret, length, NULL);
+    pthread_mutex_unlock(&mappings_mutex);
+
+    if (tracked != 0) {
+        free(ret);
+        errno = ENOMEM;
+        return MAP_FAILED_BIONIC;
+    }
     return ret;
 }
 
 int munmap(void *addr, size_t length) {
-    //fprintf(stderr, "munmap 0x%x, length %i: ", (int)addr, length);
-    free(addr);
-    //fprintf(stderr, "success\n");
+    pthread_mutex_lock(&mappings_mutex);
+    Mapping* m = find_locked(addr, 1);
+    if (!m) {
+        pthread_mutex_unlock(&mappings_mutex);
+        errno = EINVAL;
+        return -1;
+    }
+
+    // The memory can only go back as a whole, once its start is unmapped;
+    // unmapping other parts of it is a no-op.
+    if (m->addr != addr) {
+        pthread_mutex_unlock(&mappings_mutex);
+        return 0;
+    }
+
+    void* to_free = m->addr;
+    SharedMapping* s = m->shared;
+    *m = mappings[--mappings_count];
+
+    if (s) {
+        to_free = NULL;
+        if (--s->refs == 0) {
+            for (int i = 0; i < MEM_SHARED_MAPPINGS_MAX; i++) {
+                if (sharedMappings[i] == s) sharedMappings[i] = NULL;
+            }
+            to_free = s->addr;
+            free(s);
+        }
+    }
+    pthread_mutex_unlock(&mappings_mutex);
+
+    free(to_free);
     return 0;
 }
@@ -18,6 +18,25 @@
 #include <malloc.h>
 #include <sys/types.h>
 
+// bionic's values.
+#define PROT_WRITE_BIONIC 0x2
+#define MAP_SHARED_BIONIC 0x01
+#define MAP_FIXED_BIONIC 0x10
+#define MAP_ANONYMOUS_BIONIC 0x20
+#define MAP_FAILED_BIONIC ((void *)-1)
+
+#define MEM_PAGE_SIZE 4096
+
+// Read-only mappings of packed files that can be shared at a time.
+#define MEM_SHARED_MAPPINGS_MAX 64
+
+// Anonymous mappings zeroed in advance: at most this many blocks, and this
+// many bytes in total. Blocks nobody took for MEM_ZERO_POOL_IDLE_MS are
+// freed, and so is the whole pool when an allocation here fails.
+#define MEM_ZERO_POOL_SLOTS 8
+#define MEM_ZERO_POOL_MAX (1024 * 1024)
+#define MEM_ZERO_POOL_IDLE_MS 2000
+
 void *sceClibMemclr(void *dst, SceSize len);
 
 void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offs);
@@ -0,0 +1,117 @@
+/*
+ * utils/arena.c
+ *
+ * Bump-pointer arena allocator with save/restore marks, used for short-lived
+ * allocations that can be released in bulk.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "arena.h"
+
+#include <stdlib.h>
+
+#define ALIGN_UP(x) (((x) + (ARENA_ALIGN - 1)) & ~((size_t)ARENA_ALIGN - 1))
+
+void arena_init(arena * a, size_t block_size) {
+    a->head = NULL;
+    a->spare = NULL;
+    a->block_size = ALIGN_UP(block_size);
+    a->used = 0;
+}
+
+void arena_destroy(arena * a) {
+    arena_block * b = a->head;
+    while (b) {
+        arena_block * next = b->next;
+        free(b);
+        b = next;
+    }
+    free(a->spare);
+
+    a->head = NULL;
+    a->spare = NULL;
+    a->used = 0;
+}
+
+void * arena_alloc(arena * a, size_t size) {
+    size = ALIGN_UP(size ? size : 1);
+
+    arena_block * b = a->head;
+    if (!b || b->size - b->used < size) {
+        if (a->spare && a->spare->size >= size) {
+            b = a->spare;
+            a->spare = NULL;
+        } else {
+            size_t sz = (size > a->block_size) ? size : a->block_size;
+            b = malloc(sizeof(arena_block) + sz);
+            if (!b) return NULL;
+            b->size = sz;
+        }
+        b->used = 0;
+        b->next = a->head;
+        a->head = b;
+    }
+
+    void * ret = b->data + b->used;
+    b->used += size;
+    a->used += size;
+    return ret;
+}
+
+int arena_pop(arena * a, void * p, size_t size) {
+    arena_block * b = a->head;
+    size = ALIGN_UP(size ? size : 1);
+
+    if (!b || (uint8_t *)p + size != b->data + b->used) {
+        return 0;
+    }
+
+    b->used -= size;
+    a->used -= size;
+    return 1;
+}
+
+arena_mark arena_save(const arena * a) {
+    arena_mark m;
+    m.block = a->head;
+    m.block_used = a->head ? a->head->used : 0;
+    m.used = a->used;
+    return m;
+}
+
+void arena_restore(arena * a, arena_mark m) {
+    while (a->head && a->head != m.block) {
+        arena_block * b = a->head;
+        a->head = b->next;
+
+        if (!a->spare && b->size == a->block_size) {
+            a->spare = b;
+        } else {
+            free(b);
+        }
+    }
+
+    if (a->head) {
+        a->head->used = m.block_used;
+    }
+    a->used = m.used;
+}
+
+void arena_reset(arena * a) {
+    arena_mark empty = { NULL, 0, 0 };
+    arena_restore(a, empty);
+}
+
+int arena_owns(const arena * a, const void * p) {
+    const uint8_t * ptr = p;
+    for (const arena_block * b = a->head; b; b = b->next) {
+        if (ptr >= b->data && ptr < b->data + b->used) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * utils/arena.h
+ *
+ * Bump-pointer arena allocator with save/restore marks, used for short-lived
+ * allocations that can be released in bulk.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_ARENA_H
+#define SOLOADER_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_ALIGN 8
+
+typedef struct arena_block {
+    struct arena_block * next;
+    size_t size;
+    size_t used;
+    uint8_t data[] __attribute__((aligned(ARENA_ALIGN)));
+} arena_block;
+
+typedef struct arena {
+    arena_block * head;  // block currently being filled, newest first
+    arena_block * spare; // emptied block kept around for reuse
+    size_t block_size;   // default size for new blocks
+    size_t used;         // bytes handed out across all blocks
+} arena;
+
+// Position in the arena that can be rolled back to with arena_restore().
+typedef struct arena_mark {
+    arena_block * block;
+    size_t block_used;
+    size_t used;
+} arena_mark;
+
+void arena_init(arena * a, size_t block_size);
+
+// Frees all blocks. The arena can be reused after another arena_init().
+void arena_destroy(arena * a);
+
+// Returns ARENA_ALIGN-aligned memory or NULL if out of memory.
+void * arena_alloc(arena * a, size_t size);
+
+// Gives back `size` bytes at `p` if they are the most recent allocation;
+// otherwise does nothing. Returns 1 if the memory was released.
+int arena_pop(arena * a, void * p, size_t size);
+
+arena_mark arena_save(const arena * a);
+
+// Releases everything allocated after `m`. Blocks that become empty are kept
+// for reuse, except the oversized ones.
+void arena_restore(arena * a, arena_mark m);
+
+// Releases everything, keeping at most one block around for reuse.
+void arena_reset(arena * a);
+
+int arena_owns(const arena * a, const void * p);
+
+#endif // SOLOADER_ARENA_H
@@ -31,7 +31,7 @@ static uint16_t ime_initial_text_utf16[SCE_IME_DIALOG_MAX_TEXT_LENGTH];
 static uint16_t ime_input_text_utf16[SCE_IME_DIALOG_MAX_TEXT_LENGTH + 1];
 static uint8_t ime_input_text_utf8[SCE_IME_DIALOG_MAX_TEXT_LENGTH + 1];
 
-void utf16_to_utf8(const uint16_t *src, uint8_t *dst) {
+static void utf16_to_utf8(const uint16_t *src, uint8_t *dst) {
   for (int i = 0; src[i]; i++) {
     if ((src[i] & 0xFF80) == 0) {
       *(dst++) = src[i] & 0xFF;
@@ -54,7 +54,7 @@ void utf16_to_utf8(const uint16_t *src, uint8_t *dst) {
   *dst = '\0';
 }
 
-void utf8_to_utf16(const uint8_t *src, uint16_t *dst) {
+static void utf8_to_utf16(const uint8_t *src, uint16_t *dst) {
   for (int i = 0; src[i];) {
     if ((src[i] & 0xE0) == 0xE0) {
       *(dst++) = ((src[i]&0x0F) <<12) | ((src[i+1]&0x3F) <<6) | (src[i+2]&0x3F);
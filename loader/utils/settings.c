@@ -13,6 +13,8 @@
 #include <stdio.h>
 #include <string.h>
 #include "settings.h"
+#include "io/block_cache.h"
+#include "io/readahead.h"
 
 #define CONFIG_FILE_PATH DATA_PATH"config.txt"
 
@@ -20,12 +22,18 @@ float leftStickDeadZone;
 float rightStickDeadZone;
 int fpsLock;
 bool fakeAccel_enabled;
+int readAheadWindow;
+int blockCacheSize;
+bool preloadAssets;
 
 void resetSettings() {
     leftStickDeadZone = 0.11f;
     rightStickDeadZone = 0.11f;
     fpsLock = 0;
     fakeAccel_enabled = false;
+    readAheadWindow = READAHEAD_WINDOW_DEFAULT_KB;
+    blockCacheSize = BLOCK_CACHE_SIZE_DEFAULT_MB;
+    preloadAssets = true;
 }
 
 void loadSettings(void) {
@@ -42,6 +50,9 @@ void loadSettings(void) {
             else if (strcmp("rightStickDeadZone", buffer) == 0) rightStickDeadZone = ((float)value / 100.f);
             else if (strcmp("fpsLock", buffer) == 0) fpsLock = value;
             else if (strcmp("fakeAccel_enabled", buffer) == 0) fakeAccel_enabled = (bool)value;
+            else if (strcmp("readAheadWindow", buffer) == 0) readAheadWindow = value;
+            else if (strcmp("blockCacheSize", buffer) == 0) blockCacheSize = value;
+            else if (strcmp("preloadAssets", buffer) == 0) preloadAssets = (bool)value;
         }
         fclose(config);
     }
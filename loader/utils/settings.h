@@ -17,6 +17,9 @@ extern float leftStickDeadZone;
 extern float rightStickDeadZone;
 extern int fpsLock;
 extern bool fakeAccel_enabled;
+extern int readAheadWindow; // KiB, 0 to disable
+extern int blockCacheSize; // MiB, 0 to disable
+extern bool preloadAssets;
 
 void loadSettings(void);
 
@@ -0,0 +1,402 @@
+/*
+ * utils/utf.c
+ *
+ * UTF-8 <-> UTF-16 transcoding and validation used by the JNI string
+ * functions. ASCII runs are processed 16 bytes at a time with NEON when
+ * it is available.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "utf.h"
+
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define UTF_USE_NEON 1
+#endif
+
+#define UTF_REPLACEMENT_CHAR 0xFFFD
+
+#ifdef UTF_USE_NEON
+static inline int neon_is_ascii_u8(uint8x16_t v) {
+    uint8x8_t x = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+    return (vget_lane_u64(vreinterpret_u64_u8(x), 0) & 0x8080808080808080ULL) == 0;
+}
+
+// U+0000 doesn't count as ASCII here, it takes two bytes in modified UTF-8.
+static inline int neon_is_ascii_u16(uint16x8_t v) {
+    uint16x8_t bad = vcgeq_u16(vsubq_u16(v, vdupq_n_u16(1)), vdupq_n_u16(0x7F));
+    uint16x4_t x = vorr_u16(vget_low_u16(bad), vget_high_u16(bad));
+    return vget_lane_u64(vreinterpret_u64_u16(x), 0) == 0;
+}
+#endif
+
+// Length of the ASCII run at the start of `s`.
+static inline size_t ascii_prefix(const uint8_t * s, size_t len) {
+    size_t i = 0;
+
+    // Runs between non-ASCII characters are mostly a few characters long,
+    // too short for checking them a block at a time to pay off.
+    while (i < len && i < 8 && s[i] < 0x80) i++;
+    if (i < 8) return i;
+
+#ifdef UTF_USE_NEON
+    for (; i + 16 <= len; i += 16) {
+        if (!neon_is_ascii_u8(vld1q_u8(s + i))) break;
+    }
+#else
+    for (; i + 4 <= len; i += 4) {
+        uint32_t w;
+        memcpy(&w, s + i, 4);
+        if (w & 0x80808080) break;
+    }
+#endif
+    while (i < len && s[i] < 0x80) i++;
+    return i;
+}
+
+// Length of the run at the start of UTF-16 `s` that is ASCII, other than
+// U+0000, and so is narrowed as is.
+static inline size_t ascii_prefix_u16(const uint16_t * s, size_t len) {
+    size_t i = 0;
+
+    while (i < len && i < 8 && (uint16_t)(s[i] - 1) < 0x7F) i++;
+    if (i < 8) return i;
+
+#ifdef UTF_USE_NEON
+    for (; i + 8 <= len; i += 8) {
+        if (!neon_is_ascii_u16(vld1q_u16(s + i))) break;
+    }
+#else
+    for (; i + 2 <= len; i += 2) {
+        uint32_t w;
+        memcpy(&w, s + i, 4);
+        if ((w & 0xFF80FF80) || ((w - 0x00010001) & ~w & 0x80008000)) break;
+    }
+#endif
+    while (i < len && (uint16_t)(s[i] - 1) < 0x7F) i++;
+    return i;
+}
+
+// Copies the ASCII run at the start of `s` into `d`, widened, up to `len`
+// characters. Returns the length of the run.
+static inline size_t widen_ascii(const uint8_t * s, uint16_t * d, size_t len) {
+    size_t i = 0;
+#ifdef UTF_USE_NEON
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(s + i);
+        if (!neon_is_ascii_u8(v)) break;
+        vst1q_u16(d + i, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(d + i + 8, vmovl_u8(vget_high_u8(v)));
+    }
+#endif
+    for (; i < len && s[i] < 0x80; i++) d[i] = s[i];
+    return i;
+}
+
+// Copies the run at the start of `s` that ascii_prefix_u16() would measure
+// into `d`, narrowed. Returns the length of the run.
+static inline size_t narrow_ascii(const uint16_t * s, uint8_t * d, size_t len) {
+    size_t i = 0;
+#ifdef UTF_USE_NEON
+    for (; i + 8 <= len; i += 8) {
+        uint16x8_t v = vld1q_u16(s + i);
+        if (!neon_is_ascii_u16(v)) break;
+        vst1_u8(d + i, vmovn_u16(v));
+    }
+#endif
+    for (; i < len && (uint16_t)(s[i] - 1) < 0x7F; i++) d[i] = (uint8_t)s[i];
+    return i;
+}
+
+// Decodes one code point and advances `*ps` past it. Returns -1 on a
+// malformed sequence, leaving `*ps` untouched.
+//
+// In non-strict mode, Java's modified UTF-8 is accepted as well: U+0000
+// encoded as C0 80, and supplementary characters encoded as two separate
+// surrogates (which then come out as a proper UTF-16 pair).
+static inline int32_t utf8_decode(const uint8_t ** ps, const uint8_t * end, int strict) {
+    const uint8_t * s = *ps;
+    uint32_t c = s[0];
+    uint32_t cp, min;
+    int n;
+
+    if (c < 0x80) {
+        *ps = s + 1;
+        return (int32_t)c;
+    } else if ((c & 0xE0) == 0xC0) {
+        n = 1; cp = c & 0x1F; min = 0x80;
+    } else if ((c & 0xF0) == 0xE0) {
+        n = 2; cp = c & 0x0F; min = 0x800;
+    } else if ((c & 0xF8) == 0xF0) {
+        n = 3; cp = c & 0x07; min = 0x10000;
+    } else {
+        return -1;
+    }
+
+    if (end - s <= n) return -1;
+
+    for (int i = 1; i <= n; i++) {
+        if ((s[i] & 0xC0) != 0x80) return -1;
+        cp = (cp << 6) | (s[i] & 0x3F);
+    }
+
+    if (cp < min) {
+        if (strict || !(n == 1 && cp == 0)) return -1;
+    }
+    if (cp > 0x10FFFF) return -1;
+    if (strict && cp >= 0xD800 && cp <= 0xDFFF) return -1;
+
+    *ps = s + n + 1;
+    return (int32_t)cp;
+}
+
+// Same as utf8_decode() but never fails: malformed bytes are consumed one
+// at a time and decoded as U+FFFD.
+static inline uint32_t utf8_decode_lenient(const uint8_t ** ps, const uint8_t * end) {
+    int32_t cp = utf8_decode(ps, end, 0);
+    if (cp < 0) {
+        (*ps)++;
+        return UTF_REPLACEMENT_CHAR;
+    }
+    return (uint32_t)cp;
+}
+
+// Same as utf8_decode_lenient(), with well-formed 2- and 3-byte sequences,
+// which is most of what isn't ASCII, decoded inline.
+static inline uint32_t utf8_next(const uint8_t ** ps, const uint8_t * end) {
+    const uint8_t * s = *ps;
+    uint32_t c = s[0];
+
+    if (c >= 0xC2 && c < 0xE0 && end - s >= 2 && (s[1] & 0xC0) == 0x80) {
+        *ps = s + 2;
+        return ((c & 0x1F) << 6) | (s[1] & 0x3F);
+    }
+    if ((c & 0xF0) == 0xE0 && end - s >= 3 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80) {
+        uint32_t cp = ((c & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+        if (cp >= 0x800) {
+            *ps = s + 3;
+            return cp;
+        }
+    }
+
+    return utf8_decode_lenient(ps, end);
+}
+
+int utf8_validate(const char * src, size_t src_len) {
+    const uint8_t * s = (const uint8_t *)src;
+    const uint8_t * end = s + src_len;
+
+    while (s < end) {
+        s += ascii_prefix(s, end - s);
+        if (s >= end) break;
+        if (utf8_decode(&s, end, 1) < 0) return 0;
+    }
+
+    return 1;
+}
+
+// Number of UTF-16 units in the 8 bytes at `s`, if they're ASCII and
+// complete 2-byte sequences only, which is what Latin-1 text is made of.
+// Returns -1 otherwise, or if the last byte starts a sequence.
+static inline int utf8_units_in_8(const uint8_t * s) {
+    uint64_t x;
+    memcpy(&x, s, 8);
+
+    const uint64_t hi = 0x8080808080808080ULL;
+    uint64_t lead = x & (x << 1) & hi;
+    uint64_t cont = x & ~(x << 1) & hi;
+
+    // 3- and 4-byte sequences, and C0/C1 (overlong, or modified UTF-8's
+    // U+0000), take the slow path.
+    if (lead & (x << 2)) return -1;
+    if (lead & ~((x & 0x3E3E3E3E3E3E3E3EULL) + 0x7F7F7F7F7F7F7F7FULL)) return -1;
+
+    // Little-endian: each lead's continuation is in the byte above it.
+    if (cont != (lead << 8) || (lead >> 56)) return -1;
+    return 8 - (int)((((cont >> 7) * 0x0101010101010101ULL) >> 56));
+}
+
+size_t utf8_utf16_length(const char * src, size_t src_len) {
+    const uint8_t * s = (const uint8_t *)src;
+    const uint8_t * end = s + src_len;
+    size_t n = 0;
+
+    while (s < end) {
+        if (*s < 0x80) {
+            size_t run = ascii_prefix(s, end - s);
+            s += run;
+            n += run;
+            continue;
+        }
+        if (*s >= 0xC2 && *s < 0xE0 && end - s >= 8) {
+            int units = utf8_units_in_8(s);
+            if (units >= 0) {
+                s += 8;
+                n += units;
+                continue;
+            }
+        }
+        n += (utf8_next(&s, end) >= 0x10000) ? 2 : 1;
+    }
+
+    return n;
+}
+
+size_t utf8_utf16_offset(const char * src, size_t src_len, size_t units) {
+    const uint8_t * s = (const uint8_t *)src;
+    const uint8_t * end = s + src_len;
+    size_t n = 0;
+
+    while (s < end && n < units) {
+        if (*s < 0x80) {
+            size_t run = ascii_prefix(s, end - s);
+            if (run > units - n) run = units - n;
+            s += run;
+            n += run;
+            continue;
+        }
+        n += (utf8_next(&s, end) >= 0x10000) ? 2 : 1;
+    }
+
+    return s - (const uint8_t *)src;
+}
+
+size_t utf8_to_utf16(const char * src, size_t src_len, uint16_t * dst, size_t dst_len) {
+    const uint8_t * s = (const uint8_t *)src;
+    const uint8_t * end = s + src_len;
+    size_t n = 0;
+
+    while (s < end && n < dst_len) {
+        if (*s < 0x80) {
+            size_t max = end - s;
+            if (max > dst_len - n) max = dst_len - n;
+            size_t run = widen_ascii(s, dst + n, max);
+            s += run;
+            n += run;
+            continue;
+        }
+
+        const uint8_t * next = s;
+        uint32_t cp = utf8_next(&next, end);
+        if (cp >= 0x10000) {
+            if (dst_len - n < 2) break;
+            cp -= 0x10000;
+            dst[n++] = (uint16_t)(0xD800 | (cp >> 10));
+            dst[n++] = (uint16_t)(0xDC00 | (cp & 0x3FF));
+        } else {
+            dst[n++] = (uint16_t)cp;
+        }
+        s = next;
+    }
+
+    return n;
+}
+
+// Decodes one code point from UTF-16 and advances `*pi`. Unpaired
+// surrogates are decoded as U+FFFD.
+static inline uint32_t utf16_decode(const uint16_t * src, size_t src_len, size_t * pi) {
+    size_t i = *pi;
+    uint32_t c = src[i++];
+
+    if (c >= 0xD800 && c <= 0xDBFF) {
+        if (i < src_len && src[i] >= 0xDC00 && src[i] <= 0xDFFF) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (src[i++] - 0xDC00);
+        } else {
+            c = UTF_REPLACEMENT_CHAR;
+        }
+    } else if (c >= 0xDC00 && c <= 0xDFFF) {
+        c = UTF_REPLACEMENT_CHAR;
+    }
+
+    *pi = i;
+    return c;
+}
+
+// Number of UTF-8 bytes for the 4 units at `s`, if they're all below
+// U+0800 and none is U+0000, which covers Latin-1 text. Returns -1 otherwise.
+static inline int utf16_bytes_in_4(const uint16_t * s) {
+    uint64_t x;
+    memcpy(&x, s, 8);
+
+    const uint64_t lanes = 0x0001000100010001ULL;
+    const uint64_t hi = 0x8000800080008000ULL;
+    if (x & 0xF800F800F800F800ULL) return -1;
+    if ((x - lanes) & ~x & hi) return -1;
+
+    // One more byte for each unit from U+0080 on.
+    uint64_t wide = ((x & 0x0780078007800780ULL) + 0x7FFF7FFF7FFF7FFFULL) & hi;
+    return 4 + (int)((((wide >> 15) * lanes) >> 48));
+}
+
+size_t utf16_utf8_length(const uint16_t * src, size_t src_len) {
+    size_t i = 0;
+    size_t n = 0;
+
+    while (i < src_len) {
+        if ((uint16_t)(src[i] - 1) < 0x7F) {
+            size_t run = ascii_prefix_u16(src + i, src_len - i);
+            i += run;
+            n += run;
+            continue;
+        }
+        if (src[i] < 0x800 && src_len - i >= 4) {
+            int bytes = utf16_bytes_in_4(src + i);
+            if (bytes >= 0) {
+                i += 4;
+                n += bytes;
+                continue;
+            }
+        }
+
+        uint32_t c = src[i++];
+        if (c < 0x800) {
+            n += 2; // U+0000 included
+        } else if (c >= 0xD800 && c <= 0xDBFF && i < src_len && src[i] >= 0xDC00 && src[i] <= 0xDFFF) {
+            n += 4;
+            i++;
+        } else {
+            n += 3; // unpaired surrogates as well, as U+FFFD
+        }
+    }
+
+    return n;
+}
+
+size_t utf16_to_utf8(const uint16_t * src, size_t src_len, char * dst) {
+    uint8_t * d = (uint8_t *)dst;
+    size_t i = 0;
+
+    while (i < src_len) {
+        if ((uint16_t)(src[i] - 1) < 0x7F) {
+            size_t run = narrow_ascii(src + i, d, src_len - i);
+            i += run;
+            d += run;
+            continue;
+        }
+
+        // U+0000 comes out as C0 80, as in Java's modified UTF-8, so the
+        // result is never cut short by a NUL.
+        uint32_t c = utf16_decode(src, src_len, &i);
+        if (c < 0x800) {
+            *d++ = (uint8_t)(0xC0 | (c >> 6));
+            *d++ = (uint8_t)(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            *d++ = (uint8_t)(0xE0 | (c >> 12));
+            *d++ = (uint8_t)(0x80 | ((c >> 6) & 0x3F));
+            *d++ = (uint8_t)(0x80 | (c & 0x3F));
+        } else {
+            *d++ = (uint8_t)(0xF0 | (c >> 18));
+            *d++ = (uint8_t)(0x80 | ((c >> 12) & 0x3F));
+            *d++ = (uint8_t)(0x80 | ((c >> 6) & 0x3F));
+            *d++ = (uint8_t)(0x80 | (c & 0x3F));
+        }
+    }
+
+    return d - (uint8_t *)dst;
+}
@@ -0,0 +1,46 @@
+/*
+ * utils/utf.h
+ *
+ * UTF-8 <-> UTF-16 transcoding and validation used by the JNI string
+ * functions. ASCII runs are processed 16 bytes at a time with NEON when
+ * it is available.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_UTF_H
+#define SOLOADER_UTF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Returns 1 if `src` is well-formed UTF-8, 0 otherwise.
+int utf8_validate(const char * src, size_t src_len);
+
+// Number of UTF-16 code units needed to represent `src`. Malformed
+// sequences count as one unit each (they are decoded as U+FFFD).
+size_t utf8_utf16_length(const char * src, size_t src_len);
+
+// Byte offset in `src` right after the first `units` UTF-16 code units,
+// or `src_len` if the string is shorter.
+size_t utf8_utf16_offset(const char * src, size_t src_len, size_t units);
+
+// Converts up to `dst_len` UTF-16 code units. Returns the number of code
+// units written. A surrogate pair is never split across the end of `dst`.
+// No terminator is written.
+size_t utf8_to_utf16(const char * src, size_t src_len, uint16_t * dst, size_t dst_len);
+
+// Number of UTF-8 bytes needed to represent `src`. Unpaired surrogates are
+// encoded as U+FFFD, and U+0000 as C0 80 like in Java's modified UTF-8, so
+// the result holds no NUL bytes.
+size_t utf16_utf8_length(const uint16_t * src, size_t src_len);
+
+// Converts `src` into `dst`, which must be at least
+// utf16_utf8_length(src, src_len) bytes long. Returns the number of bytes
+// written. No terminator is written.
+size_t utf16_to_utf8(const uint16_t * src, size_t src_len, char * dst);
+
+#endif // SOLOADER_UTF_H
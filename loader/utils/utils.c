@@ -12,12 +12,14 @@
 
 #include "utils.h"
 #include "dialog.h"
+#include "io/meta_cache.h"
 
 #include <psp2/io/stat.h>
 
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <stdlib.h>
 #include <pthread.h>
@@ -51,8 +53,8 @@ void do_nothing(void) {
 }
 
 int file_exists(const char *path) {
-    SceIoStat stat;
-    return sceIoGetstat(path, &stat) >= 0;
+    struct stat st;
+    return meta_cache_stat(path, &st) == 0;
 }
 
 // OpenSLES wants `assert()` and somehow we don't have it?
@@ -231,12 +233,8 @@ void check_init_mutex(pthread_mutex_t* mut) {
 }
 
 inline int8_t is_dir(char* p) {
-    DIR* filetest = opendir(p);
-    if (filetest != NULL) {
-        closedir(filetest);
-        return 1;
-    }
-    return 0;
+    struct stat st;
+    return (meta_cache_stat(p, &st) == 0 && S_ISDIR(st.st_mode)) ? 1 : 0;
 }
 
 uint64_t currenttime_ms() {
@@ -0,0 +1,190 @@
+/*
+ * tools/asset_bench.c
+ *
+ * Host benchmark of the asset pack: reads every packed file through the
+ * loader's asset_pack.c, then again as a loose file, checks that both give
+ * the same bytes and compares the throughput, for whole-file reads and for
+ * small reads at random offsets.
+ *
+ * Build and run from a directory that has assets/ and assets.pak in it:
+ *   cc -O2 -std=gnu11 -include stdint.h -I$REPO/tools/jni_replay/shim -I$REPO/loader \
+ *      -DDATA_PATH='"./"' -DDATA_PATH_INT='"./assets/"' -DSO_PATH='"x"' \
+ *      $REPO/tools/asset_bench.c $REPO/loader/io/asset_pack.c $REPO/loader/io/lz4.c \
+ *      -lpthread -o asset_bench
+ *   ./asset_bench [chunk_size] [random_reads]
+ *
+ * Loose files are likely in the host's page cache, so the numbers show the
+ * cost of decompression rather than the memory card bandwidth saved; the
+ * size ratio printed at the end is what that saving is proportional to.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "io/asset_pack.h"
+
+int debugPrintf(char *text, ...) {
+    return 0;
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t fnv1a(uint64_t h, const uint8_t* p, int n) {
+    for (int i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static void loose_path(char* out, size_t size, uint32_t i) {
+    snprintf(out, size, "%s%s", DATA_PATH_INT, asset_pack_name(i));
+}
+
+// Whole-file reads; returns a hash of everything read.
+static uint64_t read_all(int packed, uint8_t* buf, int chunk, uint32_t count, uint64_t* bytes, int* errors) {
+    uint64_t h = 1469598103934665603ull;
+    char path[1024];
+
+    for (uint32_t i = 0; i < count; i++) {
+        loose_path(path, sizeof(path), i);
+        int fd = packed ? asset_pack_open(path) : open(path, O_RDONLY);
+        if (fd < 0) {
+            (*errors)++;
+            continue;
+        }
+
+        int n;
+        while ((n = packed ? asset_pack_read(fd, buf, chunk) : (int)read(fd, buf, chunk)) > 0) {
+            h = fnv1a(h, buf, n);
+            *bytes += n;
+        }
+        if (n < 0) (*errors)++;
+
+        if (packed) asset_pack_close(fd);
+        else close(fd);
+    }
+
+    return h;
+}
+
+// Small reads at random offsets, the same sequence for both sides.
+static uint64_t read_random(int packed, uint8_t* buf, uint32_t count, int reads, uint64_t* bytes) {
+    uint64_t h = 1469598103934665603ull;
+    char path[1024];
+    srand(1);
+
+    for (int r = 0; r < reads; r++) {
+        uint32_t i = (uint32_t)rand() % count;
+        loose_path(path, sizeof(path), i);
+
+        int fd = packed ? asset_pack_open(path) : open(path, O_RDONLY);
+        if (fd < 0) continue;
+
+        int64_t size = packed ? asset_pack_lseek(fd, 0, SEEK_END) : lseek(fd, 0, SEEK_END);
+        int64_t off = size > 4096 ? (int64_t)(((uint64_t)rand() << 16 ^ rand()) % (size - 4096)) : 0;
+
+        int n;
+        if (packed) {
+            asset_pack_lseek(fd, off, SEEK_SET);
+            n = asset_pack_read(fd, buf, 4096);
+            asset_pack_close(fd);
+        } else {
+            lseek(fd, off, SEEK_SET);
+            n = (int)read(fd, buf, 4096);
+            close(fd);
+        }
+
+        if (n > 0) {
+            h = fnv1a(h, buf, n);
+            *bytes += n;
+        }
+    }
+
+    return h;
+}
+
+static void report(const char* what, uint64_t bytes, double t) {
+    printf("  %-6s %10.1f MiB in %7.3f s, %8.1f MiB/s\n", what, bytes / 1048576.0, t,
+           t > 0 ? bytes / 1048576.0 / t : 0.0);
+}
+
+int main(int argc, char* argv[]) {
+    int chunk = argc > 1 ? atoi(argv[1]) : 65536;
+    int reads = argc > 2 ? atoi(argv[2]) : 10000;
+    if (chunk <= 0) chunk = 65536;
+
+    uint32_t count = asset_pack_count();
+    if (count == 0) {
+        fprintf(stderr, "No usable %s here.\n", ASSET_PACK_PATH);
+        return 1;
+    }
+
+    uint8_t* buf = malloc(chunk > 4096 ? chunk : 4096);
+    int loose_errors = 0, packed_errors = 0;
+    uint64_t loose_bytes = 0, packed_bytes = 0;
+
+    printf("%u files, reads of %d bytes:\n", count, chunk);
+
+    double t0 = now();
+    uint64_t loose_hash = read_all(0, buf, chunk, count, &loose_bytes, &loose_errors);
+    double t1 = now();
+    uint64_t packed_hash = read_all(1, buf, chunk, count, &packed_bytes, &packed_errors);
+    double t2 = now();
+
+    report("loose", loose_bytes, t1 - t0);
+    report("packed", packed_bytes, t2 - t1);
+
+    int failed = 0;
+    if (loose_errors || packed_errors || loose_hash != packed_hash || loose_bytes != packed_bytes) {
+        printf("  MISMATCH: %d loose errors, %d packed errors, contents %s\n", loose_errors, packed_errors,
+               loose_hash == packed_hash ? "match" : "differ");
+        failed = 1;
+    }
+
+    printf("%d random reads of 4096 bytes:\n", reads);
+    loose_bytes = packed_bytes = 0;
+    t0 = now();
+    loose_hash = read_random(0, buf, count, reads, &loose_bytes);
+    t1 = now();
+    packed_hash = read_random(1, buf, count, reads, &packed_bytes);
+    t2 = now();
+
+    report("loose", loose_bytes, t1 - t0);
+    report("packed", packed_bytes, t2 - t1);
+
+    if (loose_hash != packed_hash) {
+        printf("  MISMATCH: contents differ\n");
+        failed = 1;
+    }
+
+    struct stat st;
+    uint64_t raw = 0;
+    char path[1024];
+    for (uint32_t i = 0; i < count; i++) {
+        loose_path(path, sizeof(path), i);
+        if (stat(path, &st) == 0) raw += st.st_size;
+    }
+    if (stat(ASSET_PACK_PATH, &st) == 0 && raw) {
+        printf("Pack is %.1f%% of the loose files (%llu / %llu bytes).\n", 100.0 * st.st_size / raw,
+               (unsigned long long)st.st_size, (unsigned long long)raw);
+    }
+
+    free(buf);
+    return failed;
+}
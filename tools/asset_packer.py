@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+#
+# tools/asset_packer.py
+#
+# Packs the game's assets into a single file that the loader serves opens,
+# reads and stats from (see loader/io/asset_pack.h). Put the result next to
+# the assets directory, as DATA_PATH "assets.pak". Files that are packed may
+# be deleted from the assets directory; anything not packed keeps working as
+# a loose file.
+#
+# Usage:
+#   python3 tools/asset_packer.py [--lz4] [--block-size N] ASSETS_DIR OUTPUT [SUBDIR...]
+#
+# ASSETS_DIR is the local copy of DATA_PATH_INT. With SUBDIRs, only those
+# parts of the tree are packed, e.g. `published`. With --lz4, files that
+# compress well are stored LZ4-compressed in independent blocks of N bytes
+# (64 KiB by default). The `lz4` Python module is used when installed; the
+# built-in encoder gives the same format, only slower.
+#
+# Copyright (C) 2022 Volodymyr Atamanenko
+#
+# This software may be modified and distributed under the terms
+# of the MIT license. See the LICENSE file for details.
+
+import argparse
+import os
+import struct
+import sys
+
+try:
+    import lz4.block as lz4_block
+except ImportError:
+    lz4_block = None
+
+MAGIC = 0x4B415041  # "APAK"
+VERSION = 2
+ALIGN = 512
+ENTRY_LZ4 = 1
+
+HEADER = struct.Struct('<8I')
+ENTRY = struct.Struct('<IIQQ')
+
+# Files are compressed only if that saves at least this much.
+MIN_SAVING = 0.1
+
+
+def align_up(x, a):
+    return (x + a - 1) // a * a
+
+
+def lz4_compress_block(src):
+    """Greedy LZ4 block encoder, see lz4_decompress() in loader/io/lz4.c."""
+    if lz4_block is not None:
+        return lz4_block.compress(src, store_size=False)
+
+    n = len(src)
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    # The format wants the last match to start 12 bytes before the end and
+    # the last 5 bytes to be literals.
+    limit = n - 12
+
+    def emit(lit_end, match_len, offset):
+        lit = lit_end - anchor
+        ml = match_len - 4 if match_len else 0
+        out.append((min(lit, 15) << 4) | min(ml, 15))
+        if lit >= 15:
+            rest = lit - 15
+            while rest >= 255:
+                out.append(255)
+                rest -= 255
+            out.append(rest)
+        out.extend(src[anchor:lit_end])
+        if match_len:
+            out.extend(struct.pack('<H', offset))
+            if ml >= 15:
+                rest = ml - 15
+                while rest >= 255:
+                    out.append(255)
+                    rest -= 255
+                out.append(rest)
+
+    while i < limit:
+        key = src[i:i + 4]
+        cand = table.get(key)
+        table[key] = i
+        if cand is None or i - cand > 65535:
+            # Skip faster through data that doesn't compress.
+            i += 1 + ((i - anchor) >> 6)
+            continue
+
+        ml = 4
+        max_ml = n - 5 - i
+        while ml < max_ml and src[cand + ml] == src[i + ml]:
+            ml += 1
+
+        emit(i, ml, i - cand)
+        i += ml
+        anchor = i
+
+    emit(n, 0, 0)
+    return bytes(out)
+
+
+def lz4_compress_file(data, block_size):
+    """Returns the entry's data (block table + blocks), or None if it's not
+    worth it."""
+    blocks = []
+    for start in range(0, len(data), block_size):
+        raw = data[start:start + block_size]
+        packed = lz4_compress_block(raw)
+        blocks.append(packed if len(packed) < len(raw) else raw)
+
+    table_size = 4 * (len(blocks) + 1)
+    offsets = [table_size]
+    for b in blocks:
+        offsets.append(offsets[-1] + len(b))
+
+    if offsets[-1] > len(data) * (1 - MIN_SAVING):
+        return None
+    return struct.pack('<%dI' % len(offsets), *offsets) + b''.join(blocks)
+
+
+def collect(root, subdirs):
+    names = []
+    for sub in subdirs or ['']:
+        top = os.path.join(root, sub)
+        if not os.path.isdir(top):
+            sys.stderr.write('error: %s is not a directory\n' % top)
+            sys.exit(1)
+        for dirpath, _, filenames in os.walk(top):
+            for f in filenames:
+                rel = os.path.relpath(os.path.join(dirpath, f), root)
+                names.append(rel.replace(os.sep, '/'))
+
+    # The loader binary-searches the names with strcmp().
+    return sorted(set(names), key=lambda n: n.encode('utf-8'))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Packs the game assets into a single file.')
+    parser.add_argument('--lz4', action='store_true', help='compress files that compress well')
+    parser.add_argument('--block-size', type=int, default=65536, help='compression block size')
+    parser.add_argument('assets_dir')
+    parser.add_argument('output')
+    parser.add_argument('subdirs', nargs='*')
+    args = parser.parse_args()
+
+    if args.block_size <= 0 or args.block_size > (1 << 20):
+        sys.stderr.write('error: block size must be 1..1048576\n')
+        sys.exit(1)
+
+    root = args.assets_dir
+    names = collect(root, args.subdirs)
+    if not names:
+        sys.stderr.write('error: nothing to pack\n')
+        sys.exit(1)
+
+    name_blob = bytearray()
+    name_offsets = []
+    for n in names:
+        name_offsets.append(len(name_blob))
+        name_blob += n.encode('utf-8') + b'\0'
+
+    index_size = HEADER.size + ENTRY.size * len(names) + len(name_blob)
+    data_offset = align_up(index_size, ALIGN)
+    raw_total = 0
+    compressed = 0
+
+    with open(args.output, 'wb') as out:
+        # The index is written last, once the offsets are known.
+        out.write(b'\0' * data_offset)
+
+        entries = []
+        for n in names:
+            with open(os.path.join(root, n), 'rb') as f:
+                data = f.read()
+            raw_total += len(data)
+
+            flags = 0
+            stored = data
+            if args.lz4 and data:
+                packed = lz4_compress_file(data, args.block_size)
+                if packed is not None:
+                    flags = ENTRY_LZ4
+                    stored = packed
+                    compressed += 1
+
+            offset = align_up(out.tell(), ALIGN)
+            out.write(b'\0' * (offset - out.tell()))
+            out.write(stored)
+            entries.append((offset, len(data), flags))
+
+        total = out.tell()
+
+        out.seek(0)
+        out.write(HEADER.pack(MAGIC, VERSION, len(names), len(name_blob), data_offset, ALIGN,
+                              args.block_size, 0))
+        for name_off, (off, size, flags) in zip(name_offsets, entries):
+            out.write(ENTRY.pack(name_off, flags, off, size))
+        out.write(name_blob)
+
+    print('%s: %d files (%d compressed), %d bytes of assets in %d bytes' % (
+        args.output, len(names), compressed, raw_total, total))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,313 @@
+/*
+ * tools/ffullread_bench.c
+ *
+ * Host benchmark of ffullread() from loader/reimpl/io.c: the size-hinted
+ * version against the old one that grew its buffer by one chunk at a time,
+ * over small, medium and huge files, read both as seekable files and as
+ * pipes of unknown size. Checks that both give the same bytes.
+ *
+ * io.c needs the Vita SDK, so the two versions are copied here with the
+ * SceLibc calls replaced by libc's; keep hinted_read() in step with
+ * ffullread_untraced().
+ *
+ * Build and run from the repository root:
+ *   cc -O2 tools/ffullread_bench.c -o ffullread_bench
+ *   ./ffullread_bench [chunk_size] [tmp_dir]
+ *
+ * glibc moves large blocks with mremap(), so the old version looks better
+ * here than on the Vita, where every realloc() that can't grow in place
+ * copies the whole buffer.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FFULLREAD_OK      (0)
+#define FFULLREAD_INVALID (-1) // Invalid params
+#define FFULLREAD_ERROR   (-2) // File stream error
+#define FFULLREAD_TOOMUCH (-3) // Too much input
+#define FFULLREAD_NOMEM   (-4)
+
+typedef struct {
+    const char * name;
+    size_t size;
+    int iterations;
+} BenchFile;
+
+static const BenchFile files[] = {
+    { "small",  4 * 1024,          2000 },
+    { "medium", 1024 * 1024,       100 },
+    { "huge",   64 * 1024 * 1024,  3 },
+};
+
+static long reallocs = 0;
+
+static void * counted_realloc(void * ptr, size_t size) {
+    reallocs++;
+    return realloc(ptr, size);
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// The previous ffullread(): one chunk more per read, then a final shrink.
+static int chunked_read(FILE *f, void **dataptr, size_t *sizeptr, size_t chunk) {
+    char *data = NULL, *temp;
+    size_t size = 0;
+    size_t used = 0;
+    size_t n;
+
+    if (f == NULL || dataptr == NULL || sizeptr == NULL)
+        return FFULLREAD_INVALID;
+
+    if (ferror(f))
+        return FFULLREAD_ERROR;
+
+    while (1) {
+        if (used + chunk + 1 > size) {
+            size = used + chunk + 1;
+
+            // Overflow check
+            if (size <= used) {
+                free(data);
+                return FFULLREAD_TOOMUCH;
+            }
+
+            temp = counted_realloc(data, size);
+            if (temp == NULL) {
+                free(data);
+                return FFULLREAD_NOMEM;
+            }
+            data = temp;
+        }
+
+        n = fread(data + used, 1, chunk, f);
+        if (n == 0)
+            break;
+
+        used += n;
+    }
+
+    if (ferror(f)) {
+        free(data);
+        return FFULLREAD_ERROR;
+    }
+
+    temp = counted_realloc(data, used + 1);
+    if (temp == NULL) {
+        free(data);
+        return FFULLREAD_NOMEM;
+    }
+    data = temp;
+    data[used] = '\0';
+
+    *dataptr = data;
+    *sizeptr = used;
+
+    return FFULLREAD_OK;
+}
+
+// ffullread_untraced() from loader/reimpl/io.c.
+static int hinted_read(FILE *f, void **dataptr, size_t *sizeptr, size_t chunk) {
+    char *data, *temp;
+    size_t size;
+    size_t used;
+
+    if (f == NULL || dataptr == NULL || sizeptr == NULL)
+        return FFULLREAD_INVALID;
+
+    if (ferror(f))
+        return FFULLREAD_ERROR;
+
+    // Most files fit in the first chunk, and finding out the size costs two
+    // seeks, more than the chunk-sized read. So only files that don't fit
+    // have it looked up.
+    size = chunk + 1;
+    if (size == 0)
+        return FFULLREAD_TOOMUCH;
+
+    data = malloc(size);
+    if (data == NULL)
+        return FFULLREAD_NOMEM;
+
+    used = fread(data, 1, size, f);
+    int more = used == size;
+
+    if (more) {
+        // There's no fileno() for SceLibc streams to fstat(), so the size
+        // comes from seeking to the end and back.
+        long pos = ftell(f);
+        long end = -1;
+        if (pos >= 0 && fseek(f, 0, SEEK_END) == 0) {
+            end = ftell(f);
+            if (fseek(f, pos, SEEK_SET) != 0) {
+                free(data);
+                return FFULLREAD_ERROR;
+            }
+        }
+
+        if (end >= pos && pos >= 0 && used + (size_t)(end - pos) + 1 > used) {
+            size = used + (size_t)(end - pos) + 1;
+            temp = counted_realloc(data, size);
+            if (temp == NULL) {
+                free(data);
+                return FFULLREAD_NOMEM;
+            }
+            data = temp;
+        }
+    }
+
+    // Every read asks for all the room left, so a short one means the end
+    // of the stream, or an error.
+    while (more) {
+        if (used == size) {
+            // Overflow check
+            if (size * 2 <= size) {
+                free(data);
+                return FFULLREAD_TOOMUCH;
+            }
+            size *= 2;
+
+            temp = counted_realloc(data, size);
+            if (temp == NULL) {
+                free(data);
+                return FFULLREAD_NOMEM;
+            }
+            data = temp;
+        }
+
+        size_t n = fread(data + used, 1, size - used, f);
+        more = n == size - used;
+        used += n;
+    }
+
+    if (ferror(f)) {
+        free(data);
+        return FFULLREAD_ERROR;
+    }
+
+    // Only inputs shorter than a chunk and streams of unknown size leave
+    // slack behind, or no room for the NUL.
+    if (size != used + 1) {
+        if (used + 1 == 0) {
+            free(data);
+            return FFULLREAD_TOOMUCH;
+        }
+        temp = counted_realloc(data, used + 1);
+        if (temp == NULL) {
+            free(data);
+            return FFULLREAD_NOMEM;
+        }
+        data = temp;
+    }
+    data[used] = '\0';
+
+    *dataptr = data;
+    *sizeptr = used;
+
+    return FFULLREAD_OK;
+}
+
+typedef int (*ReadFn)(FILE *, void **, size_t *, size_t);
+
+static FILE * open_input(const char * path, int piped) {
+    if (!piped) return fopen(path, "rb");
+
+    char cmd[1024];
+    snprintf(cmd, sizeof(cmd), "cat '%s'", path);
+    return popen(cmd, "r");
+}
+
+static void close_input(FILE * f, int piped) {
+    if (piped) pclose(f); else fclose(f);
+}
+
+// Returns the time per read in ms, or a negative value on a mismatch.
+static double run(ReadFn fn, const char * path, const char * expected, size_t expected_size,
+                  int iterations, size_t chunk, int piped, long * reallocs_per_read) {
+    reallocs = 0;
+    double total = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        FILE * f = open_input(path, piped);
+        if (!f) return -1;
+
+        void * data;
+        size_t size;
+        double t = now_ms();
+        int ret = fn(f, &data, &size, chunk);
+        total += now_ms() - t;
+        close_input(f, piped);
+
+        if (ret != FFULLREAD_OK) return -1;
+        int ok = size == expected_size && memcmp(data, expected, size) == 0
+                 && ((char *)data)[size] == '\0';
+        free(data);
+        if (!ok) return -1;
+    }
+
+    *reallocs_per_read = reallocs / iterations;
+    return total / iterations;
+}
+
+int main(int argc, char * argv[]) {
+    size_t chunk = (argc > 1) ? strtoul(argv[1], NULL, 10) : 4096;
+    const char * dir = (argc > 2) ? argv[2] : "/tmp";
+    int failed = 0;
+
+    printf("chunk %zu bytes\n\n", chunk);
+    printf("%-8s %-6s %12s %9s %12s %9s %8s\n", "file", "input", "chunked ms", "reallocs",
+           "hinted ms", "reallocs", "speedup");
+
+    srand(1);
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        const BenchFile * b = &files[i];
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/ffullread_bench_%s.bin", dir, b->name);
+
+        char * expected = malloc(b->size);
+        if (!expected) return 1;
+        for (size_t j = 0; j < b->size; j++) expected[j] = (char)rand();
+
+        FILE * f = fopen(path, "wb");
+        if (!f || fwrite(expected, 1, b->size, f) != b->size) {
+            fprintf(stderr, "can't write %s\n", path);
+            return 1;
+        }
+        fclose(f);
+
+        for (int piped = 0; piped <= 1; piped++) {
+            long chunked_reallocs, hinted_reallocs;
+            double chunked = run(chunked_read, path, expected, b->size, b->iterations, chunk, piped,
+                                 &chunked_reallocs);
+            double hinted = run(hinted_read, path, expected, b->size, b->iterations, chunk, piped,
+                                &hinted_reallocs);
+
+            if (chunked < 0 || hinted < 0) {
+                printf("%-8s %-6s MISMATCH\n", b->name, piped ? "pipe" : "file");
+                failed = 1;
+                continue;
+            }
+
+            printf("%-8s %-6s %12.3f %9li %12.3f %9li %7.1fx\n", b->name, piped ? "pipe" : "file",
+                   chunked, chunked_reallocs, hinted, hinted_reallocs,
+                   hinted > 0 ? chunked / hinted : 0.0);
+        }
+
+        remove(path);
+        free(expected);
+    }
+
+    return failed;
+}
@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+#
+# tools/io_trace_report.py
+#
+# Summarizes a trace recorded by a build with the IO_TRACE CMake option (see
+# loader/io/io_trace.h): bytes and operations per file, how much of the
+# reading is sequential, the time game threads spent blocked on I/O over the
+# whole boot and per load, and the worst files and calls.
+#
+# Usage:
+#   python3 tools/io_trace_report.py [--gap MS] [--top N] io_trace.bin
+#
+# The trace has no notion of levels, so loads are told apart by the idle
+# time between them: I/O separated by less than MS milliseconds (1000 by
+# default) counts as one load. The first load is the boot.
+#
+# Copyright (C) 2022 Volodymyr Atamanenko
+#
+# This software may be modified and distributed under the terms
+# of the MIT license. See the LICENSE file for details.
+
+import argparse
+import collections
+import struct
+import sys
+
+MAGIC = 0x52544F49  # "IOTR"
+VERSION = 1
+
+FILE_HEADER = struct.Struct('<IHH')
+RECORD = struct.Struct('<BBHIIIIiqii')
+PATH_LEN = struct.Struct('<H')
+
+FROM_STREAM = 1
+
+OPS = [None, 'path', 'open', 'fopen', 'opendir', 'read', 'write', 'lseek', 'fstat', 'fsync',
+       'ftruncate', 'close', 'fclose', 'ffullread', 'stat', 'unlink', 'remove', 'rename',
+       'mkdir', 'rmdir']
+OP_PATH_NAME = 1
+
+READS = ('read', 'ffullread')
+WRITES = ('write',)
+
+
+class Op:
+    __slots__ = ('op', 'flags', 'thread', 'time', 'latency', 'path', 'fd', 'offset', 'size',
+                 'result')
+
+
+class FileStats:
+    def __init__(self):
+        self.ops = collections.Counter()
+        self.bytes_read = 0
+        self.bytes_written = 0
+        self.seq_reads = 0
+        self.random_reads = 0
+        self.blocked_us = 0
+        self.stream = False
+
+
+def load(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    if len(data) < FILE_HEADER.size:
+        sys.exit('error: %s is too short' % path)
+    magic, version, _ = FILE_HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION:
+        sys.exit('error: %s is not an I/O trace (or a different version)' % path)
+
+    paths = {0: '<unknown>'}
+    ops = []
+    pos = FILE_HEADER.size
+    last = None
+    wraps = 0
+    while pos + RECORD.size <= len(data):
+        fields = RECORD.unpack_from(data, pos)
+        pos += RECORD.size
+
+        if fields[0] == OP_PATH_NAME:
+            if pos + PATH_LEN.size > len(data):
+                break
+            (n,) = PATH_LEN.unpack_from(data, pos)
+            pos += PATH_LEN.size
+            paths[fields[6]] = data[pos:pos + n].decode('utf-8', 'replace')
+            pos += n
+            continue
+
+        if fields[0] >= len(OPS):
+            sys.exit('error: unknown operation %d at offset %d' % (fields[0], pos - RECORD.size))
+
+        o = Op()
+        o.op = OPS[fields[0]]
+        o.flags, _, o.thread, t, o.latency, o.path, o.fd, o.offset, o.size, o.result = fields[1:]
+
+        # The process clock wraps every ~71 minutes.
+        if last is not None and t + wraps < last - (1 << 31):
+            wraps += 1 << 32
+        o.time = t + wraps
+        last = o.time
+        ops.append(o)
+
+    ops.sort(key=lambda o: o.time)
+    return paths, ops
+
+
+def file_stats(paths, ops):
+    files = collections.defaultdict(FileStats)
+    next_offset = {}  # (fd, path) -> where a sequential read would start
+
+    for o in ops:
+        name = paths.get(o.path, '<unknown>')
+        s = files[name]
+        s.ops[o.op] += 1
+        s.blocked_us += o.latency
+        if o.flags & FROM_STREAM:
+            s.stream = True
+
+        key = (o.fd, o.path)
+        if o.op in ('open', 'fopen', 'close', 'fclose'):
+            next_offset.pop(key, None)
+        elif o.op in READS:
+            n = o.size if o.op == 'ffullread' else max(o.result, 0)
+            s.bytes_read += n
+            if o.offset >= 0:
+                if o.offset == next_offset.get(key, 0):
+                    s.seq_reads += 1
+                else:
+                    s.random_reads += 1
+                next_offset[key] = o.offset + n
+        elif o.op in WRITES:
+            s.bytes_written += max(o.result, 0)
+
+    return files
+
+
+def loads(ops, gap_us):
+    """Splits the trace where nothing was going on for more than gap_us."""
+    out = []
+    cur = []
+    end = 0
+    for o in ops:
+        if cur and o.time > end + gap_us:
+            out.append(cur)
+            cur = []
+        end = max(end, o.time + o.latency)
+        cur.append(o)
+    if cur:
+        out.append(cur)
+    return out
+
+
+def fmt_bytes(n):
+    for unit in ('B', 'KiB', 'MiB'):
+        if n < 1024:
+            return '%d %s' % (n, unit) if unit == 'B' else '%.1f %s' % (n, unit)
+        n /= 1024.0
+    return '%.1f GiB' % n
+
+
+def fmt_ms(us):
+    return '%.1f ms' % (us / 1000.0)
+
+
+def report(paths, ops, gap_ms, top):
+    if not ops:
+        print('The trace is empty.')
+        return
+
+    total_blocked = sum(o.latency for o in ops)
+    span = ops[-1].time + ops[-1].latency - ops[0].time
+    threads = collections.Counter()
+    for o in ops:
+        threads[o.thread] += o.latency
+
+    print('%d operations on %d paths over %s; %s blocked on I/O.' % (
+        len(ops), len(paths) - 1, fmt_ms(span), fmt_ms(total_blocked)))
+    for tid, us in threads.most_common():
+        print('  thread 0x%08x: %s' % (tid, fmt_ms(us)))
+
+    print('\nLoads (I/O separated by more than %d ms of idle time):' % gap_ms)
+    print('  %-6s %12s %12s %12s %10s %6s' % ('', 'start', 'length', 'blocked', 'read', 'files'))
+    for i, l in enumerate(loads(ops, gap_ms * 1000)):
+        start = l[0].time - ops[0].time
+        length = max(o.time + o.latency for o in l) - l[0].time
+        read = sum(o.size if o.op == 'ffullread' else max(o.result, 0) for o in l if o.op in READS)
+        print('  %-6s %12s %12s %12s %10s %6d' % (
+            'boot' if i == 0 else '#%d' % i, fmt_ms(start), fmt_ms(length),
+            fmt_ms(sum(o.latency for o in l)), fmt_bytes(read), len(set(o.path for o in l))))
+
+    files = file_stats(paths, ops)
+    ordered = sorted(files.items(), key=lambda kv: kv[1].blocked_us, reverse=True)
+
+    seq = sum(s.seq_reads for s in files.values())
+    rnd = sum(s.random_reads for s in files.values())
+    if seq + rnd:
+        print('\nReads: %d sequential, %d random (%.0f%% sequential).' % (
+            seq, rnd, 100.0 * seq / (seq + rnd)))
+
+    print('\nTop %d files by time blocked:' % top)
+    print('  %10s %10s %10s %7s %7s  %s' % ('blocked', 'read', 'written', 'ops', 'seq%', 'path'))
+    for name, s in ordered[:top]:
+        reads = s.seq_reads + s.random_reads
+        seq_pct = '%.0f' % (100.0 * s.seq_reads / reads) if reads else '-'
+        print('  %10s %10s %10s %7d %7s  %s%s' % (
+            fmt_ms(s.blocked_us), fmt_bytes(s.bytes_read), fmt_bytes(s.bytes_written),
+            sum(s.ops.values()), seq_pct, name, ' (stream)' if s.stream else ''))
+
+    print('\nTime blocked per operation:')
+    per_op = collections.defaultdict(lambda: [0, 0])
+    for o in ops:
+        per_op[o.op][0] += 1
+        per_op[o.op][1] += o.latency
+    for op, (count, us) in sorted(per_op.items(), key=lambda kv: kv[1][1], reverse=True):
+        print('  %-10s %8d calls %12s' % (op, count, fmt_ms(us)))
+
+    print('\nTop %d slowest calls:' % top)
+    for o in sorted(ops, key=lambda o: o.latency, reverse=True)[:top]:
+        what = o.op
+        if o.op in READS or o.op in WRITES:
+            what += ' %d @ %d' % (o.size, o.offset)
+        print('  %10s at %10s  %-24s %s' % (
+            fmt_ms(o.latency), fmt_ms(o.time - ops[0].time), what, paths.get(o.path, '<unknown>')))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Summarizes an I/O trace recorded with IO_TRACE.')
+    parser.add_argument('--gap', type=int, default=1000, help='idle milliseconds that separate loads')
+    parser.add_argument('--top', type=int, default=20, help='how many files and calls to list')
+    parser.add_argument('trace')
+    args = parser.parse_args()
+
+    paths, ops = load(args.trace)
+    report(paths, ops, args.gap, args.top)
+
+
+if __name__ == '__main__':
+    main()
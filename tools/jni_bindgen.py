@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+#
+# tools/jni_bindgen.py
+#
+# Generates jni_bindings.h from loader/jni_bindings.spec: a dense table of
+# bindings indexed by method ID and an open-addressing hash table mapping
+# method names to IDs. Run by CMake at build time; fails the build on
+# duplicate IDs, duplicate names and malformed entries.
+#
+# Usage:
+#   python3 tools/jni_bindgen.py loader/jni_bindings.spec jni_bindings.h
+#
+# Copyright (C) 2022 Volodymyr Atamanenko
+#
+# This software may be modified and distributed under the terms
+# of the MIT license. See the LICENSE file for details.
+
+import sys
+
+MAX_ID = 4095
+
+TYPES = {
+    'void':    ('METHOD_TYPE_VOID',    'v', 'V'),
+    'int':     ('METHOD_TYPE_INT',     'i', 'I'),
+    'long':    ('METHOD_TYPE_LONG',    'j', 'J'),
+    'float':   ('METHOD_TYPE_FLOAT',   'f', 'F'),
+    'double':  ('METHOD_TYPE_DOUBLE',  'd', 'D'),
+    'boolean': ('METHOD_TYPE_BOOLEAN', 'z', 'Z'),
+    'object':  ('METHOD_TYPE_OBJECT',  'l', 'L'),
+}
+
+
+def fail(path, lineno, msg):
+    sys.stderr.write('%s:%d: error: %s\n' % (path, lineno, msg))
+    sys.exit(1)
+
+
+# Must match jni_binding_hash() in jni_specific.h.
+def fnv1a(s):
+    h = 2166136261
+    for b in s.encode('utf-8'):
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def signature_return(sig):
+    ret = sig[sig.index(')') + 1:]
+    if ret.startswith('['):
+        return 'L'
+    return ret[0]
+
+
+def parse(path):
+    bindings = []
+    ids = {}
+    keys = {}
+
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+
+            cols = line.split()
+            if len(cols) != 6:
+                fail(path, lineno, 'expected 6 columns, got %d' % len(cols))
+
+            id_str, classes, name, sig, rtype, handler = cols
+
+            try:
+                mid = int(id_str)
+            except ValueError:
+                fail(path, lineno, 'bad id "%s"' % id_str)
+            if mid < 1 or mid > MAX_ID:
+                fail(path, lineno, 'id %d is out of range 1..%d' % (mid, MAX_ID))
+            if mid in ids:
+                fail(path, lineno, 'id %d is already used on line %d' % (mid, ids[mid]))
+            ids[mid] = lineno
+
+            if rtype not in TYPES:
+                fail(path, lineno, 'unknown return type "%s"' % rtype)
+
+            if sig != '*':
+                if not sig.startswith('(') or ')' not in sig:
+                    fail(path, lineno, 'malformed signature "%s"' % sig)
+                if signature_return(sig) != TYPES[rtype][2]:
+                    fail(path, lineno, 'signature "%s" does not return %s' % (sig, rtype))
+
+            classes = classes.split(',')
+            if name == '<init>':
+                lookup = ['%s/<init>' % c for c in classes]
+            else:
+                lookup = [name]
+
+            for key in lookup:
+                if key in keys:
+                    fail(path, lineno, '"%s" is already bound on line %d' % (key, keys[key]))
+                keys[key] = lineno
+
+            bindings.append({
+                'id': mid,
+                'class': ','.join(classes),
+                'name': name,
+                'sig': sig,
+                'type': rtype,
+                'handler': handler,
+                'keys': lookup,
+            })
+
+    return bindings
+
+
+def hash_table(bindings):
+    keys = [(k, b['id']) for b in bindings for k in b['keys']]
+
+    size = 16
+    while size < len(keys) * 2:
+        size *= 2
+
+    table = [None] * size
+    for key, mid in keys:
+        slot = fnv1a(key) & (size - 1)
+        while table[slot] is not None:
+            slot = (slot + 1) & (size - 1)
+        table[slot] = (key, mid)
+
+    return table
+
+
+def generate(spec_path, bindings):
+    max_id = max(b['id'] for b in bindings)
+    table = hash_table(bindings)
+
+    out = []
+    out.append('// Generated by tools/jni_bindgen.py from %s. Do not edit.' % spec_path)
+    out.append('')
+    out.append('#ifndef SOLOADER_JNI_BINDINGS_H')
+    out.append('#define SOLOADER_JNI_BINDINGS_H')
+    out.append('')
+    out.append('#define JNI_BINDINGS_COUNT %d' % len(bindings))
+    out.append('#define JNI_BINDINGS_MAX_ID %d' % max_id)
+    out.append('#define JNI_BINDINGS_HASH_SIZE %d' % len(table))
+    out.append('')
+
+    out.append('const JniBinding jniBindings[JNI_BINDINGS_MAX_ID + 1] = {')
+    for b in sorted(bindings, key=lambda b: b['id']):
+        enum, member, _ = TYPES[b['type']]
+        out.append('    [%d] = { "%s", "%s", "%s", %s, { .%s = %s } },' % (
+            b['id'], b['class'], b['name'], b['sig'], enum, member, b['handler']))
+    out.append('};')
+    out.append('')
+
+    out.append('const JniBindingName jniBindingNames[JNI_BINDINGS_HASH_SIZE] = {')
+    for slot, entry in enumerate(table):
+        if entry is not None:
+            out.append('    [%d] = { "%s", %d },' % (slot, entry[0], entry[1]))
+    out.append('};')
+    out.append('')
+    out.append('#endif // SOLOADER_JNI_BINDINGS_H')
+    out.append('')
+
+    return '\n'.join(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write('Usage: %s jni_bindings.spec jni_bindings.h\n' % sys.argv[0])
+        sys.exit(2)
+
+    spec_path, out_path = sys.argv[1], sys.argv[2]
+    bindings = parse(spec_path)
+    if not bindings:
+        fail(spec_path, 0, 'no bindings found')
+
+    text = generate(spec_path.replace('\\', '/').split('/')[-1], bindings)
+
+    # Don't touch the output if nothing changed, to avoid needless rebuilds.
+    try:
+        with open(out_path) as f:
+            if f.read() == text:
+                return
+    except IOError:
+        pass
+
+    with open(out_path, 'w') as f:
+        f.write(text)
+
+
+if __name__ == '__main__':
+    main()
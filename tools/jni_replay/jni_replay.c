@@ -0,0 +1,562 @@
+/*
+ * tools/jni_replay/jni_replay.c
+ *
+ * Replays a JNI trace recorded on the device (see loader/jni_trace.h) against
+ * the fake JNI built for the host. Every lookup, call and field access is
+ * done again in order, return values of primitive types and strings are
+ * compared with the recorded ones, and the whole run is timed. Calls that
+ * need a real array, and releases of what was handed out, are skipped: the
+ * trace only has pointers for those. Handy for checking changes to
+ * the JNI layer without a Vita, and for measuring them.
+ *
+ * Build and run from the repository root:
+ *   mkdir -p build && python3 tools/jni_bindgen.py loader/jni_bindings.spec build/jni_bindings.h
+ *   cc -O2 -std=gnu11 -include stdint.h -Itools/jni_replay/shim -Iloader -Ibuild \
+ *      -DDATA_PATH='"./"' -DDATA_PATH_INT='"./assets/"' -DSO_PATH='"x"' \
+ *      tools/jni_replay/jni_replay.c tools/jni_replay/replay_stubs.c \
+ *      loader/jni_fake.c loader/jni_trace.c loader/utils/arena.c \
+ *      loader/utils/utf.c loader/utils/settings.c \
+ *      loader/android/java.io.InputStream.c loader/android/EAAudioCore.c \
+ *      loader/io/asset_index.c loader/io/asset_pack.c loader/io/block_cache.c \
+ *      loader/io/io_pool.c loader/io/lz4.c loader/io/meta_cache.c \
+ *      loader/io/readahead.c -lpthread -o jni_replay
+ *   ./jni_replay [-v] jni_trace.bin [iterations]
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "jni_fake.h"
+#include "jni_trace.h"
+#include "utils/utf.h"
+
+#define MAX_FIELDS 1024
+#define MAX_REPORTED_MISMATCHES 20
+
+extern int replay_verbose;
+
+typedef struct {
+    JniTraceRecordHeader h;
+    char * name;
+    char * sig;
+    char types[JNI_METHOD_MAX_ARGS];
+    jvalue args[JNI_METHOD_MAX_ARGS];
+    char ret_type;
+    jvalue ret;
+} Record;
+
+typedef struct {
+    const uint8_t * p;
+    const uint8_t * end;
+} Reader;
+
+// Stands in for every non-string object the game passed in or got back.
+static uint8_t scratch[4096];
+
+static jmethodID methodMap[JNI_METHODS_MAX];
+static const char * methodNames[JNI_METHODS_MAX];
+
+static int fieldMapFrom[MAX_FIELDS];
+static int fieldMapTo[MAX_FIELDS];
+static int fieldMapCount = 0;
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int read_bytes(Reader * r, void * dst, size_t size) {
+    if ((size_t)(r->end - r->p) < size) return 0;
+    memcpy(dst, r->p, size);
+    r->p += size;
+    return 1;
+}
+
+static int read_string(Reader * r, char ** out) {
+    uint16_t len;
+    if (!read_bytes(r, &len, sizeof(len))) return 0;
+    if ((size_t)(r->end - r->p) < len) return 0;
+
+    *out = malloc(len + 1);
+    memcpy(*out, r->p, len);
+    (*out)[len] = '\0';
+    r->p += len;
+    return 1;
+}
+
+static int read_value(Reader * r, char * type, jvalue * v) {
+    if (!read_bytes(r, type, 1)) return 0;
+
+    if (*type == 'T') {
+        char * str;
+        if (!read_string(r, &str)) return 0;
+        v->l = (jobject)str;
+        return 1;
+    }
+
+    if (!read_bytes(r, v, sizeof(jvalue))) return 0;
+    if (*type == 'L') v->l = (jobject)scratch;
+    return 1;
+}
+
+static Record * load_trace(const char * path, size_t * count) {
+    FILE * f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size_t size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t * data = malloc(size);
+    if (fread(data, 1, size, f) != size) {
+        fprintf(stderr, "Can't read %s\n", path);
+        fclose(f);
+        free(data);
+        return NULL;
+    }
+    fclose(f);
+
+    Reader r = { data, data + size };
+
+    JniTraceFileHeader fh;
+    if (!read_bytes(&r, &fh, sizeof(fh)) || fh.magic != JNI_TRACE_MAGIC) {
+        fprintf(stderr, "%s is not a JNI trace\n", path);
+        free(data);
+        return NULL;
+    }
+    // Version 1 had only the lookups, calls and field reads; it reads the same.
+    if (fh.version < 1 || fh.version > JNI_TRACE_VERSION) {
+        fprintf(stderr, "Unsupported trace version %u\n", fh.version);
+        free(data);
+        return NULL;
+    }
+
+    size_t cap = 1024;
+    size_t n = 0;
+    Record * records = malloc(cap * sizeof(Record));
+
+    while (r.p < r.end) {
+        if (n == cap) {
+            cap *= 2;
+            records = realloc(records, cap * sizeof(Record));
+        }
+
+        Record * rec = &records[n];
+        memset(rec, 0, sizeof(Record));
+        int ok = read_bytes(&r, &rec->h, sizeof(rec->h));
+
+        switch (rec->h.func) {
+            case JNI_TRACE_GET_METHOD_ID:
+            case JNI_TRACE_GET_STATIC_METHOD_ID:
+            case JNI_TRACE_GET_FIELD_ID:
+            case JNI_TRACE_GET_STATIC_FIELD_ID:
+                ok = ok && read_string(&r, &rec->name) && read_string(&r, &rec->sig);
+                break;
+            case JNI_TRACE_CALL_METHOD:
+            case JNI_TRACE_CALL_STATIC_METHOD:
+            case JNI_TRACE_NEW_OBJECT:
+                if (rec->h.argc > JNI_METHOD_MAX_ARGS) ok = 0;
+                for (int i = 0; ok && i < rec->h.argc; i++) {
+                    ok = read_value(&r, &rec->types[i], &rec->args[i]);
+                }
+                ok = ok && read_value(&r, &rec->ret_type, &rec->ret);
+                break;
+            case JNI_TRACE_GET_OBJECT_FIELD:
+            case JNI_TRACE_GET_STATIC_OBJECT_FIELD:
+            case JNI_TRACE_GET_INT_FIELD:
+            case JNI_TRACE_GET_BOOLEAN_FIELD:
+                ok = ok && read_value(&r, &rec->ret_type, &rec->ret);
+                break;
+            default:
+                // Everything after the field reads is laid out like a call.
+                if (rec->h.func < JNI_TRACE_SET_OBJECT_FIELD || rec->h.func >= JNI_TRACE_FUNC_COUNT
+                    || rec->h.argc > JNI_METHOD_MAX_ARGS) {
+                    ok = 0;
+                }
+                for (int i = 0; ok && i < rec->h.argc; i++) {
+                    ok = read_value(&r, &rec->types[i], &rec->args[i]);
+                }
+                ok = ok && read_value(&r, &rec->ret_type, &rec->ret);
+        }
+
+        if (!ok) {
+            // Most likely the game was killed while the buffer was being
+            // written out; replay what we have.
+            fprintf(stderr, "Trace is truncated or corrupt after %zu records\n", n);
+            break;
+        }
+        n++;
+    }
+
+    free(data);
+    *count = n;
+    return records;
+}
+
+static int map_field(int from) {
+    for (int i = 0; i < fieldMapCount; i++) {
+        if (fieldMapFrom[i] == from) return fieldMapTo[i];
+    }
+    return from;
+}
+
+static void add_field(int from, int to) {
+    for (int i = 0; i < fieldMapCount; i++) {
+        if (fieldMapFrom[i] == from) {
+            fieldMapTo[i] = to;
+            return;
+        }
+    }
+    if (fieldMapCount < MAX_FIELDS) {
+        fieldMapFrom[fieldMapCount] = from;
+        fieldMapTo[fieldMapCount] = to;
+        fieldMapCount++;
+    }
+}
+
+static jmethodID replay_method_lookup(JNIEnv * env, const Record * rec) {
+    if (rec->h.func == JNI_TRACE_GET_STATIC_METHOD_ID) {
+        return (*env)->GetStaticMethodID(env, NULL, rec->name, rec->sig);
+    }
+
+    // Constructors were recorded as "class/<init>", see GetMethodID().
+    const char * init = strstr(rec->name, "/<init>");
+    if (init) {
+        char class_name[256];
+        snprintf(class_name, sizeof(class_name), "%.*s", (int)(init - rec->name), rec->name);
+        jclass clazz = (*env)->FindClass(env, class_name);
+        return (*env)->GetMethodID(env, clazz, "<init>", rec->sig);
+    }
+
+    return (*env)->GetMethodID(env, NULL, rec->name, rec->sig);
+}
+
+static jvalue replay_call(JNIEnv * env, const Record * rec, jmethodID m) {
+    jobject thiz = (jobject)scratch;
+    const FakeJavaMethod * fm = (const FakeJavaMethod *)m;
+    jvalue ret;
+    ret.j = 0;
+
+    if (rec->h.func == JNI_TRACE_NEW_OBJECT) {
+        ret.l = (*env)->NewObjectA(env, NULL, m, rec->args);
+        return ret;
+    }
+
+    int is_static = (rec->h.func == JNI_TRACE_CALL_STATIC_METHOD);
+
+#define REPLAY_CALL(Type, member)                                                   \
+    if (is_static) ret.member = (*env)->CallStatic##Type##MethodA(env, NULL, m, rec->args); \
+    else ret.member = (*env)->Call##Type##MethodA(env, thiz, m, rec->args);          \
+    break;
+
+    switch (fm ? fm->ret : 'V') {
+        case 'L': REPLAY_CALL(Object, l)
+        case 'Z': REPLAY_CALL(Boolean, z)
+        case 'B': REPLAY_CALL(Byte, b)
+        case 'C': REPLAY_CALL(Char, c)
+        case 'S': REPLAY_CALL(Short, s)
+        case 'I': REPLAY_CALL(Int, i)
+        case 'J': REPLAY_CALL(Long, j)
+        case 'F': REPLAY_CALL(Float, f)
+        case 'D': REPLAY_CALL(Double, d)
+        default:
+            if (is_static) (*env)->CallStaticVoidMethodA(env, NULL, m, rec->args);
+            else (*env)->CallVoidMethodA(env, thiz, m, rec->args);
+            break;
+    }
+
+#undef REPLAY_CALL
+
+    return ret;
+}
+
+static int same_value(char type, const jvalue * a, const jvalue * b) {
+    switch (type) {
+        case 'Z': return a->z == b->z;
+        case 'B': return a->b == b->b;
+        case 'C': return a->c == b->c;
+        case 'S': return a->s == b->s;
+        case 'I': return a->i == b->i;
+        case 'F': return memcmp(&a->f, &b->f, sizeof(jfloat)) == 0;
+        case 'J':
+        case 'D': return a->j == b->j;
+        case 'T': return b->l && strcmp((const char *)a->l, (const char *)b->l) == 0;
+        default:  return 1; // references and void can't be compared
+    }
+}
+
+static void report_mismatch(const Record * rec, const jvalue * got, int * reported) {
+    if (*reported >= MAX_REPORTED_MISMATCHES) return;
+    (*reported)++;
+
+    const char * name = NULL;
+    if (rec->h.id >= 0 && rec->h.id < JNI_METHODS_MAX) name = methodNames[rec->h.id];
+
+    if (rec->ret_type == 'T') {
+        fprintf(stderr, "Mismatch: func %u id %i (%s): expected \"%s\", got \"%s\"\n",
+                rec->h.func, rec->h.id, name ? name : "?",
+                (const char *)rec->ret.l, got->l ? (const char *)got->l : "(null)");
+    } else {
+        fprintf(stderr, "Mismatch: func %u id %i (%s): expected 0x%llx, got 0x%llx\n",
+                rec->h.func, rec->h.id, name ? name : "?",
+                (unsigned long long)rec->ret.j, (unsigned long long)got->j);
+    }
+}
+
+// A string argument, or NULL if it was recorded as one.
+static const char * string_arg(const Record * rec, int i) {
+    return rec->types[i] == 'T' ? (const char *)rec->args[i].l : NULL;
+}
+
+// Replays one of the records from SET_OBJECT_FIELD on into `got`.
+// Returns 0 if the record has to be skipped.
+static int replay_other(JNIEnv * env, const Record * rec, jvalue * got) {
+    jfieldID field = (jfieldID)map_field(rec->h.id);
+    jstring string = (jstring)string_arg(rec, 0);
+
+    switch (rec->h.func) {
+        case JNI_TRACE_SET_OBJECT_FIELD:
+            (*env)->SetObjectField(env, NULL, field, rec->args[0].l);
+            return 1;
+        case JNI_TRACE_SET_INT_FIELD:
+            (*env)->SetIntField(env, NULL, field, rec->args[0].i);
+            return 1;
+        case JNI_TRACE_SET_BOOLEAN_FIELD:
+            (*env)->SetBooleanField(env, NULL, field, rec->args[0].z);
+            return 1;
+        case JNI_TRACE_FIND_CLASS:
+            if (!string) return 0;
+            got->l = (*env)->FindClass(env, (const char *)string);
+            return 1;
+        case JNI_TRACE_GET_OBJECT_CLASS:
+            got->l = (*env)->GetObjectClass(env, (jobject)scratch);
+            return 1;
+        case JNI_TRACE_PUSH_LOCAL_FRAME:
+            got->i = (*env)->PushLocalFrame(env, rec->args[0].i);
+            return 1;
+        case JNI_TRACE_POP_LOCAL_FRAME:
+            got->l = (*env)->PopLocalFrame(env, NULL);
+            return 1;
+        case JNI_TRACE_NEW_GLOBAL_REF:
+            got->l = (*env)->NewGlobalRef(env, (jobject)scratch);
+            return 1;
+        case JNI_TRACE_DELETE_LOCAL_REF:
+            (*env)->DeleteLocalRef(env, (jobject)scratch);
+            return 1;
+        case JNI_TRACE_NEW_STRING_UTF:
+            got->l = (*env)->NewStringUTF(env, (const char *)string);
+            return 1;
+        case JNI_TRACE_NEW_STRING: {
+            // Only the result was recorded, make the UTF-16 back from it.
+            if (rec->ret_type != 'T') return 0;
+            const char * utf = (const char *)rec->ret.l;
+            size_t len = strlen(utf);
+            jchar * chars = malloc((len + 1) * sizeof(jchar));
+            size_t n = utf8_to_utf16(utf, len, chars, len);
+            got->l = (*env)->NewString(env, chars, (jsize)n);
+            free(chars);
+            return 1;
+        }
+        case JNI_TRACE_GET_STRING_LENGTH:
+            if (!string) return 0;
+            got->i = (*env)->GetStringLength(env, string);
+            return 1;
+        case JNI_TRACE_GET_STRING_UTF_LENGTH:
+            if (!string) return 0;
+            got->i = (*env)->GetStringUTFLength(env, string);
+            return 1;
+        case JNI_TRACE_GET_STRING_CHARS: {
+            // Released right away, the RELEASE_* records are skipped.
+            if (!string) return 0;
+            if (rec->h.id == 1) {
+                const jchar * chars = (*env)->GetStringCritical(env, string, NULL);
+                (*env)->ReleaseStringCritical(env, string, chars);
+            } else {
+                const jchar * chars = (*env)->GetStringChars(env, string, NULL);
+                (*env)->ReleaseStringChars(env, string, chars);
+            }
+            return 1;
+        }
+        case JNI_TRACE_GET_STRING_UTF_CHARS: {
+            if (!string) return 0;
+            const char * utf = (*env)->GetStringUTFChars(env, string, NULL);
+            (*env)->ReleaseStringUTFChars(env, string, (char *)utf);
+            return 1;
+        }
+        case JNI_TRACE_GET_STRING_REGION:
+        case JNI_TRACE_GET_STRING_UTF_REGION: {
+            if (!string || rec->args[1].i < 0 || rec->args[2].i < 0) return 0;
+            // Room for the worst case of either: 3 bytes per UTF-16 unit.
+            void * buf = malloc((size_t)rec->args[2].i * 3 + 1);
+            if (rec->h.func == JNI_TRACE_GET_STRING_REGION) {
+                (*env)->GetStringRegion(env, string, rec->args[1].i, rec->args[2].i, buf);
+            } else {
+                (*env)->GetStringUTFRegion(env, string, rec->args[1].i, rec->args[2].i, buf);
+            }
+            free(buf);
+            return 1;
+        }
+        case JNI_TRACE_NEW_ARRAY:
+            if (rec->h.id == 'B') got->l = (*env)->NewByteArray(env, rec->args[0].i);
+            else if (rec->h.id == 'S') got->l = (*env)->NewShortArray(env, rec->args[0].i);
+            else return 0;
+            return 1;
+        case JNI_TRACE_THROW:
+            got->i = (*env)->Throw(env, (jthrowable)scratch);
+            return 1;
+        case JNI_TRACE_THROW_NEW: {
+            // The class isn't recorded, any will do as the pending exception.
+            static jclass clazz = NULL;
+            if (!clazz) clazz = (*env)->FindClass(env, "java/lang/RuntimeException");
+            got->i = (*env)->ThrowNew(env, clazz, string_arg(rec, 1));
+            return 1;
+        }
+        case JNI_TRACE_EXCEPTION_OCCURRED:
+            got->l = (*env)->ExceptionOccurred(env);
+            return 1;
+        case JNI_TRACE_EXCEPTION_DESCRIBE:
+            (*env)->ExceptionDescribe(env);
+            return 1;
+        case JNI_TRACE_EXCEPTION_CLEAR:
+            (*env)->ExceptionClear(env);
+            return 1;
+        case JNI_TRACE_EXCEPTION_CHECK:
+            got->z = (*env)->ExceptionCheck(env);
+            return 1;
+        case JNI_TRACE_MONITOR_ENTER:
+            got->i = (*env)->MonitorEnter(env, (jobject)scratch);
+            return 1;
+        case JNI_TRACE_MONITOR_EXIT:
+            got->i = (*env)->MonitorExit(env, (jobject)scratch);
+            return 1;
+        case JNI_TRACE_GET_VERSION:
+            got->i = (*env)->GetVersion(env);
+            return 1;
+        case JNI_TRACE_GET_JAVA_VM: {
+            JavaVM * vm;
+            got->i = (*env)->GetJavaVM(env, &vm);
+            return 1;
+        }
+        default:
+            // DELETE_GLOBAL_REF would free `scratch`; the array accesses need
+            // the real array; RELEASE_* were done together with their GET_*.
+            return 0;
+    }
+}
+
+static size_t replay(JNIEnv * env, const Record * records, size_t count, int * reported) {
+    size_t mismatches = 0;
+
+    for (size_t n = 0; n < count; n++) {
+        const Record * rec = &records[n];
+        jvalue got;
+        got.j = 0;
+
+        switch (rec->h.func) {
+            case JNI_TRACE_GET_METHOD_ID:
+            case JNI_TRACE_GET_STATIC_METHOD_ID: {
+                jmethodID m = replay_method_lookup(env, rec);
+                if (rec->h.id >= 0 && rec->h.id < JNI_METHODS_MAX) {
+                    methodMap[rec->h.id] = m;
+                    methodNames[rec->h.id] = rec->name;
+                }
+                continue;
+            }
+            case JNI_TRACE_GET_FIELD_ID:
+                add_field(rec->h.id, (int)(*env)->GetFieldID(env, NULL, rec->name, rec->sig));
+                continue;
+            case JNI_TRACE_GET_STATIC_FIELD_ID:
+                add_field(rec->h.id, (int)(*env)->GetStaticFieldID(env, NULL, rec->name, rec->sig));
+                continue;
+            case JNI_TRACE_CALL_METHOD:
+            case JNI_TRACE_CALL_STATIC_METHOD:
+            case JNI_TRACE_NEW_OBJECT: {
+                jmethodID m = NULL;
+                if (rec->h.id >= 0 && rec->h.id < JNI_METHODS_MAX) m = methodMap[rec->h.id];
+                got = replay_call(env, rec, m);
+                break;
+            }
+            case JNI_TRACE_GET_OBJECT_FIELD:
+                got.l = (*env)->GetObjectField(env, NULL, (jfieldID)map_field(rec->h.id));
+                break;
+            case JNI_TRACE_GET_STATIC_OBJECT_FIELD:
+                got.l = (*env)->GetStaticObjectField(env, NULL, (jfieldID)map_field(rec->h.id));
+                break;
+            case JNI_TRACE_GET_INT_FIELD:
+                got.i = (*env)->GetIntField(env, NULL, (jfieldID)map_field(rec->h.id));
+                break;
+            case JNI_TRACE_GET_BOOLEAN_FIELD:
+                got.z = (*env)->GetBooleanField(env, NULL, (jfieldID)map_field(rec->h.id));
+                break;
+            default:
+                if (!replay_other(env, rec, &got)) continue;
+                break;
+        }
+
+        if (!same_value(rec->ret_type, &rec->ret, &got)) {
+            mismatches++;
+            report_mismatch(rec, &got, reported);
+        }
+    }
+
+    return mismatches;
+}
+
+int main(int argc, char * argv[]) {
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "-v") == 0) {
+        replay_verbose = 1;
+        arg++;
+    }
+
+    if (arg >= argc) {
+        fprintf(stderr, "Usage: %s [-v] jni_trace.bin [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    const char * path = argv[arg++];
+    int iterations = (arg < argc) ? atoi(argv[arg]) : 1;
+    if (iterations < 1) iterations = 1;
+
+    size_t count;
+    Record * records = load_trace(path, &count);
+    if (!records) return 1;
+
+    size_t calls = 0;
+    for (size_t n = 0; n < count; n++) {
+        if (records[n].h.func >= JNI_TRACE_CALL_METHOD) calls++;
+    }
+
+    jni_init();
+    JNIEnv * env = jni_get_env();
+
+    size_t mismatches = 0;
+    int reported = 0;
+
+    double start = now_ms();
+    for (int it = 0; it < iterations; it++) {
+        mismatches += replay(env, records, count, &reported);
+    }
+    double elapsed = now_ms() - start;
+
+    uint32_t span_us = count ? records[count - 1].h.time_us - records[0].h.time_us : 0;
+
+    printf("Records:     %zu (%zu calls and field accesses)\n", count, calls);
+    printf("Recorded in: %.3f ms on device\n", span_us / 1000.0);
+    printf("Replayed:    %i time(s) in %.3f ms, %.0f calls/s\n", iterations, elapsed,
+           elapsed > 0 ? (double)calls * iterations / (elapsed / 1000.0) : 0.0);
+    printf("Mismatches:  %zu\n", mismatches);
+
+    return mismatches ? 2 : 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * tools/jni_replay/replay_stubs.c
+ *
+ * Host implementations of the few loader and VitaSDK functions the fake JNI
+ * depends on, so that jni_fake.c can be linked into jni_replay as is.
+ *
+ * Copyright (C) 2022 Volodymyr Atamanenko
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "android/jni.h"
+
+int replay_verbose = 0;
+
+int debugPrintf(char *text, ...) {
+    if (!replay_verbose) return 0;
+
+    va_list list;
+    va_start(list, text);
+    vfprintf(stderr, text, list);
+    va_end(list);
+    return 0;
+}
+
+int8_t is_dir(char* p) {
+    struct stat st;
+    return (stat(p, &st) == 0 && S_ISDIR(st.st_mode)) ? 1 : 0;
+}
+
+int sceKernelGetThreadId(void) {
+    return (int)syscall(SYS_gettid);
+}
+
+int sceKernelDelayThread(unsigned int delay) {
+    return usleep(delay);
+}
+
+unsigned int sceKernelGetProcessTimeLow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned int)(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+}
+
+// Streams read the files directly, without the asset pack and the caches
+// of loader/reimpl/io.c.
+int open_soloader_from(const char *fname, int flags, uint8_t from) {
+    return open(fname, flags);
+}
+
+int read_soloader_from(int fd, void *buf, size_t nbyte, uint8_t from) {
+    return (int)read(fd, buf, nbyte);
+}
+
+off_t lseek_soloader_from(int fildes, off_t offset, int whence, uint8_t from) {
+    return lseek(fildes, offset, whence);
+}
+
+int close_soloader_from(int fd, uint8_t from) {
+    return close(fd);
+}
+
+// Boot profiles and the co-access graph aren't recorded on the host.
+void preload_note_open(const char* path) { }
+void coaccess_note_open(const char* path) { }
+
+int sceAudioOutOpenPort(int type, int len, int freq, int mode) {
+    return 1;
+}
+
+int sceAudioOutOutput(int port, const void *buf) {
+    return 0;
+}
+
+// On the device, these point into the game's .so.
+
+static void EAIO_Startup(JNIEnv* env, void* obj, jobject assetManager) { }
+static void AndroidEAAudioCore_Init(JNIEnv* env, jobject* obj, void* audioTrack, int i, int i2, int i3) { }
+static void AndroidEAAudioCore_Release(JNIEnv* env) { }
+
+void (*Java_com_ea_EAIO_EAIO_Startup)(JNIEnv*, void*, jobject) = EAIO_Startup;
+void (*Java_com_ea_EAAudioCore_AndroidEAAudioCore_Init)(JNIEnv*, jobject*, void*, int, int, int) = AndroidEAAudioCore_Init;
+void (*Java_com_ea_EAAudioCore_AndroidEAAudioCore_Release)(JNIEnv*) = AndroidEAAudioCore_Release;
@@ -0,0 +1,10 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, used by
+ * tools/jni_replay to build the fake JNI on Linux.
+ */
+
+#ifndef JNI_REPLAY_SHIM_PSP2_APPUTIL_H
+#define JNI_REPLAY_SHIM_PSP2_APPUTIL_H
+
+
+#endif // JNI_REPLAY_SHIM_PSP2_APPUTIL_H
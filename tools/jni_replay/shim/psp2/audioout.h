@@ -0,0 +1,15 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, used by
+ * tools/jni_replay to build the fake JNI on Linux.
+ */
+
+#ifndef JNI_REPLAY_SHIM_PSP2_AUDIOOUT_H
+#define JNI_REPLAY_SHIM_PSP2_AUDIOOUT_H
+
+#define SCE_AUDIO_OUT_PORT_TYPE_BGM 1
+#define SCE_AUDIO_OUT_MODE_STEREO 1
+
+int sceAudioOutOpenPort(int type, int len, int freq, int mode);
+int sceAudioOutOutput(int port, const void *buf);
+
+#endif // JNI_REPLAY_SHIM_PSP2_AUDIOOUT_H
@@ -0,0 +1,39 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, used by
+ * tools/jni_replay to build the fake JNI on Linux.
+ */
+
+#ifndef JNI_REPLAY_SHIM_PSP2_IO_FCNTL_H
+#define JNI_REPLAY_SHIM_PSP2_IO_FCNTL_H
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <psp2/kernel/threadmgr.h>
+
+typedef long long SceOff;
+typedef int SceMode;
+
+#define SCE_O_RDONLY 0x0001
+
+#define SCE_SEEK_SET 0
+#define SCE_SEEK_CUR 1
+#define SCE_SEEK_END 2
+
+static inline SceUID sceIoOpen(const char *file, int flags, SceMode mode) {
+    return open(file, O_RDONLY);
+}
+
+static inline int sceIoPread(SceUID fd, void *data, SceSize size, SceOff offset) {
+    return (int)pread(fd, data, size, offset);
+}
+
+static inline SceOff sceIoLseek(SceUID fd, SceOff offset, int whence) {
+    return lseek(fd, offset, whence);
+}
+
+static inline int sceIoClose(SceUID fd) {
+    return close(fd);
+}
+
+#endif // JNI_REPLAY_SHIM_PSP2_IO_FCNTL_H
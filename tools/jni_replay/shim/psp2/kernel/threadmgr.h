@@ -0,0 +1,15 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, used by
+ * tools/jni_replay to build the fake JNI on Linux.
+ */
+
+#ifndef JNI_REPLAY_SHIM_PSP2_KERNEL_THREADMGR_H
+#define JNI_REPLAY_SHIM_PSP2_KERNEL_THREADMGR_H
+
+typedef unsigned int SceSize;
+typedef int SceUID;
+
+int sceKernelGetThreadId(void);
+int sceKernelDelayThread(unsigned int delay);
+
+#endif // JNI_REPLAY_SHIM_PSP2_KERNEL_THREADMGR_H
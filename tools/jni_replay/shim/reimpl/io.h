@@ -0,0 +1,18 @@
+/*
+ * Host stand-in for loader/reimpl/io.h, used by tools/jni_replay to build
+ * the fake JNI on Linux. Only declares what java.io.InputStream uses; the
+ * functions are in replay_stubs.c.
+ */
+
+#ifndef JNI_REPLAY_SHIM_REIMPL_IO_H
+#define JNI_REPLAY_SHIM_REIMPL_IO_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+int open_soloader_from(const char *fname, int flags, uint8_t from);
+int read_soloader_from(int fd, void *buf, size_t nbyte, uint8_t from);
+off_t lseek_soloader_from(int fildes, off_t offset, int whence, uint8_t from);
+int close_soloader_from(int fd, uint8_t from);
+
+#endif // JNI_REPLAY_SHIM_REIMPL_IO_H
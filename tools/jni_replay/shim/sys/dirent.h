@@ -0,0 +1,11 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, used by
+ * tools/jni_replay to build the fake JNI on Linux.
+ */
+
+#ifndef JNI_REPLAY_SHIM_SYS_DIRENT_H
+#define JNI_REPLAY_SHIM_SYS_DIRENT_H
+
+#include <dirent.h>
+
+#endif // JNI_REPLAY_SHIM_SYS_DIRENT_H